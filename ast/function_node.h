@@ -2,6 +2,7 @@
 #define __TIL_AST_FUNCTION_NODE_H__
 
 #include "block_node.h"
+#include "type_table.h"
 #include <cdk/ast/expression_node.h>
 #include <cdk/ast/sequence_node.h>
 #include <cdk/types/basic_type.h>
@@ -28,7 +29,7 @@ class function_node : public cdk::expression_node {
                 dynamic_cast<cdk::typed_node *>(arguments->node(i))->type());
         }
 
-        type(cdk::functional_type::create(arg_types, func_type));
+        type(til::make_functional_type(arg_types, func_type));
     }
 
   public:
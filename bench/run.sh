@@ -0,0 +1,72 @@
+#!/bin/sh
+# Compile-throughput benchmark: generate synthetic programs of each shape and
+# size with bench/tilgen, compile them with til and report lines/second and
+# peak resident memory. The output is tab-separated, one row per run, in a
+# fixed order, so results from two commits can be compared with diff.
+#
+# usage: bench/run.sh [shape...]   (default: all shapes)
+#   TIL=path/to/til           compiler under test (default ./til)
+#   TILGEN=path/to/tilgen     generator (default bench/tilgen)
+#   TARGET=asm|xml            til target (default asm)
+#   SCALE=n                   multiply every size by n (default 1)
+#   REPEAT=n                  keep the fastest of n runs (default 3)
+
+TIL=${TIL:-./til}
+TILGEN=${TILGEN:-bench/tilgen}
+TARGET=${TARGET:-asm}
+SCALE=${SCALE:-1}
+REPEAT=${REPEAT:-3}
+SHAPES=${*:-"globals nesting instrs functions strings mixed"}
+
+TMP=${TMPDIR:-/tmp}/til-bench.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# nesting is bounded by the parser stack (YYMAXDEPTH), so it grows slower
+sizes() {
+  case $1 in
+    nesting)   echo 250 500 1000 2000 ;;
+    functions) echo 100 1000 10000 ;;
+    mixed)     echo 100 1000 10000 ;;
+    *)         echo 1000 10000 100000 ;;
+  esac
+}
+
+# run the compiler once and print "seconds peak-KiB"
+measure() {
+  if [ -x /usr/bin/time ]; then
+    /usr/bin/time -f "%e %M" -o "$TMP/time" "$TIL" --target "$TARGET" -o "$TMP/out" "$1" > /dev/null 2>&1
+    rc=$?
+    tail -n 1 "$TMP/time"
+  else
+    start=$(date +%s.%N)
+    "$TIL" --target "$TARGET" -o "$TMP/out" "$1" > /dev/null 2>&1
+    rc=$?
+    end=$(date +%s.%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%.2f 0\n", e - s }'
+  fi
+  return $rc
+}
+
+printf "shape\tsize\tlines\tseconds\tlines/s\tpeak-KiB\tstatus\n"
+for shape in $SHAPES; do
+  for size in $(sizes "$shape"); do
+    n=$((size * SCALE))
+    src="$TMP/$shape-$n.til"
+    "$TILGEN" "$shape" "$n" > "$src" || exit 1
+    lines=$(wc -l < "$src")
+
+    best=""
+    status=ok
+    i=0
+    while [ $i -lt "$REPEAT" ]; do
+      result=$(measure "$src") || status=failed
+      best=$(printf "%s\n%s\n" "$best" "$result" | awk 'NF == 2' | sort -n | head -n 1)
+      i=$((i + 1))
+    done
+
+    echo "$best" | awk -v shape="$shape" -v n="$n" -v lines="$lines" -v status="$status" '{
+      printf "%s\t%d\t%d\t%.2f\t%d\t%d\t%s\n", shape, n, lines, $1, ($1 > 0 ? lines / $1 : 0), $2, status
+    }'
+  done
+done
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Parser scaling check: compile programs whose global declaration section and
+# main block grow tenfold at each step. Linear list building shows up as a
+# roughly constant time per statement.
+#
+# usage: bench/scaling.sh [sizes...]   (TIL=path/to/til, default ./til)
+
+TIL=${TIL:-./til}
+SIZES=${*:-"1000 10000 100000"}
+TMP=${TMPDIR:-/tmp}/til-scaling.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+printf "%10s %10s %12s\n" statements seconds us/statement
+for n in $SIZES; do
+  src="$TMP/scaling-$n.til"
+  awk -v n="$n" 'BEGIN {
+    for (i = 0; i < n; i++) printf "(int g%d %d)\n", i, i
+    print "(program"
+    print "(int x 0)"
+    for (i = 0; i < n; i++) printf "(set x (+ x g%d))\n", i
+    print "(return x))"
+  }' > "$src"
+
+  start=$(date +%s.%N)
+  "$TIL" --target asm -o "$TMP/scaling-$n.asm" "$src" > /dev/null 2>&1 || echo "warning: $TIL failed on $n statements" >&2
+  end=$(date +%s.%N)
+
+  awk -v n="$n" -v s="$start" -v e="$end" 'BEGIN {
+    printf "%10d %10.3f %12.3f\n", 2 * n, e - s, (e - s) * 1e6 / (2 * n)
+  }'
+done
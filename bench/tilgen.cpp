@@ -0,0 +1,121 @@
+// Synthetic TIL program generator for the compile-throughput benchmarks.
+//
+// usage: tilgen <shape> <size>
+//
+// Shapes (each scales linearly with <size>):
+//   globals    <size> global variables, summed by the main program
+//   nesting    one expression nested <size> levels deep
+//   instrs     a main block with <size> assignments
+//   functions  <size> function literals, each called once
+//   strings    <size> global string literals, each printed once
+//   mixed      a bit of everything, <size> of each
+//
+// The output is deterministic: the same arguments always produce the same
+// program, so timings can be compared between commits.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+  void globals(std::ostream &os, long n) {
+    for (long i = 0; i < n; i++)
+      os << "(int g" << i << " " << i << ")\n";
+    os << "(program\n(int x 0)\n";
+    for (long i = 0; i < n; i++)
+      os << "(set x (+ x g" << i << "))\n";
+    os << "(println x)\n(return 0))\n";
+  }
+
+  void nesting(std::ostream &os, long n) {
+    os << "(program\n(int x 1)\n(println\n";
+    for (long i = 0; i < n; i++)
+      os << (i % 2 ? "(- " : "(+ ") << "x\n";
+    os << "x";
+    for (long i = 0; i < n; i++)
+      os << ")";
+    os << ")\n(return 0))\n";
+  }
+
+  void instrs(std::ostream &os, long n) {
+    os << "(program\n(int x 0)\n(int y 1)\n";
+    for (long i = 0; i < n; i++) {
+      switch (i % 4) {
+        case 0: os << "(set x (+ x " << i << "))\n"; break;
+        case 1: os << "(set y (* (- y x) 3))\n"; break;
+        case 2: os << "(if (< x y) (set x y) (set y x))\n"; break;
+        case 3: os << "(loop (> x 100) (set x (/ x 2)))\n"; break;
+      }
+    }
+    os << "(println x \" \" y)\n(return 0))\n";
+  }
+
+  void functions(std::ostream &os, long n) {
+    for (long i = 0; i < n; i++)
+      os << "(var f" << i << " (function (int (int a) (int b))\n"
+         << "  (int c (* a b))\n"
+         << "  (if (> c " << i << ") (return (- c a)))\n"
+         << "  (return (+ c b))))\n";
+    os << "(program\n(int x 0)\n";
+    for (long i = 0; i < n; i++)
+      os << "(set x (f" << i << " x " << i << "))\n";
+    os << "(println x)\n(return 0))\n";
+  }
+
+  void strings(std::ostream &os, long n) {
+    for (long i = 0; i < n; i++)
+      os << "(string s" << i << " \"string number " << i << " of the benchmark table\\n\")\n";
+    os << "(program\n";
+    for (long i = 0; i < n; i++)
+      os << "(print s" << i << ")\n";
+    os << "(return 0))\n";
+  }
+
+  void mixed(std::ostream &os, long n) {
+    for (long i = 0; i < n; i++) {
+      os << "(int g" << i << " " << i << ")\n";
+      os << "(string s" << i << " \"mixed " << i << "\")\n";
+      os << "(var f" << i << " (function (int (int a)) (return (+ a g" << i << "))))\n";
+    }
+    os << "(program\n(int x 0)\n";
+    for (long i = 0; i < n; i++) {
+      os << "(set x (f" << i << " (* x 2)))\n";
+      os << "(if (> x " << i << ") (println s" << i << "))\n";
+    }
+    os << "(return 0))\n";
+  }
+
+  struct shape {
+    const char *name;
+    void (*generate)(std::ostream &, long);
+  };
+
+  const shape shapes[] = {
+    { "globals",   globals   },
+    { "nesting",   nesting   },
+    { "instrs",    instrs    },
+    { "functions", functions },
+    { "strings",   strings   },
+    { "mixed",     mixed     },
+  };
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc == 3) {
+    long n = std::atol(argv[2]);
+    for (auto &s : shapes)
+      if (std::strcmp(argv[1], s.name) == 0 && n >= 0) {
+        s.generate(std::cout, n);
+        return 0;
+      }
+  }
+
+  std::cerr << "usage: " << argv[0] << " <shape> <size>\nshapes:";
+  for (auto &s : shapes)
+    std::cerr << " " << s.name;
+  std::cerr << std::endl;
+  return 2;
+}
@@ -0,0 +1,52 @@
+#ifndef __TIL_INTERNED_NODES_H__
+#define __TIL_INTERNED_NODES_H__
+
+#include "string_table.h"
+#include <cdk/ast/string_node.h>
+#include <cdk/ast/variable_node.h>
+#include <string>
+
+namespace til {
+
+  /**
+   * Identifiers and string literals built by the parser keep the handle of
+   * their interned text (see string_table), so that names are compared as
+   * pointers. They are not new node kinds: visitors see the cdk classes
+   * (which hold their own copy of the text).
+   */
+  class interned_variable_node : public cdk::variable_node {
+    const std::string *_handle;
+
+  public:
+    interned_variable_node(int lineno, const std::string *name) :
+        cdk::variable_node(lineno, *name), _handle(name) {
+    }
+
+    const std::string *handle() const {
+      return _handle;
+    }
+  };
+
+  class interned_string_node : public cdk::string_node {
+    const std::string *_handle;
+
+  public:
+    interned_string_node(int lineno, const std::string *value) :
+        cdk::string_node(lineno, *value), _handle(value) {
+    }
+
+    const std::string *handle() const {
+      return _handle;
+    }
+  };
+
+  /** Interned name of a variable (interned here if not built by the parser). */
+  inline const std::string *handle_of(cdk::variable_node *node) {
+    if (auto interned = dynamic_cast<interned_variable_node *>(node))
+      return interned->handle();
+    return string_table::instance().intern(node->name());
+  }
+
+} // til
+
+#endif
@@ -0,0 +1,114 @@
+#include "node_arena.h"
+#include <cdk/ast/sequence_node.h>
+#include <cdk/compiler.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+
+namespace {
+  std::unordered_map<const cdk::compiler *, std::unique_ptr<til::node_arena>> arenas;
+
+  // last lookup (there is usually a single compiler per process)
+  const cdk::compiler *last_compiler = nullptr;
+  til::node_arena *last_arena = nullptr;
+
+  size_t allocated = 0; // by every arena
+}
+
+til::node_arena::~node_arena() {
+  for (auto p = _objects.rbegin(); p != _objects.rend(); ++p) {
+    auto node = static_cast<cdk::basic_node *>(*p);
+    // sequences delete their items (and share them with the sequences they
+    // were built from): every node is destroyed here, exactly once
+    if (auto sequence = dynamic_cast<cdk::sequence_node *>(node))
+      sequence->nodes().clear();
+    if (_enabled)
+      node->~basic_node(); // the memory goes with the chunks
+    else
+      delete node;
+  }
+}
+
+void *til::node_arena::allocate(size_t size, size_t alignment) {
+  _allocations++;
+  if (!_enabled) {
+    _bytes += size;
+    allocated += size;
+    _objects.push_back(::operator new(size));
+    return _objects.back();
+  }
+
+  auto next = reinterpret_cast<uintptr_t>(_next);
+  size_t padding = (alignment - next % alignment) % alignment;
+  if (_next == nullptr || padding + size > static_cast<size_t>(_end - _next)) {
+    // oversized requests get a chunk of their own
+    size_t chunk_size = std::max(CHUNK_SIZE, size + alignment);
+    _chunks.emplace_back(new char[chunk_size]);
+    _next = _chunks.back().get();
+    _end = _next + chunk_size;
+    _reserved += chunk_size;
+
+    next = reinterpret_cast<uintptr_t>(_next);
+    padding = (alignment - next % alignment) % alignment;
+  }
+
+  void *p = _next + padding;
+  _next += padding + size;
+  _bytes += padding + size;
+  allocated += padding + size;
+  _objects.push_back(p);
+  return p;
+}
+
+void til::node_arena::abandon(void *p) {
+  if (!_objects.empty() && _objects.back() == p) {
+    _objects.pop_back();
+    if (!_enabled)
+      ::operator delete(p);
+  }
+}
+
+void til::node_arena::report(std::ostream &os) const {
+  os << "node arena: " << _allocations << " allocations, " << _bytes
+     << " bytes";
+  if (_enabled) {
+    os << " in " << _chunks.size() << " chunks (" << _reserved
+       << " bytes reserved)";
+  } else {
+    os << " (heap)";
+  }
+  os << std::endl;
+}
+
+til::node_arena &til::node_arena::of(const cdk::compiler *compiler) {
+  if (compiler == last_compiler && last_arena != nullptr) {
+    return *last_arena;
+  }
+
+  auto &arena = arenas[compiler];
+  if (!arena) {
+    arena = std::make_unique<node_arena>(std::getenv("TIL_NO_ARENA") == nullptr);
+  }
+  last_compiler = compiler;
+  last_arena = arena.get();
+  return *arena;
+}
+
+size_t til::node_arena::allocated_bytes() {
+  return allocated;
+}
+
+void til::node_arena::release(const cdk::compiler *compiler) {
+  if (compiler == last_compiler) {
+    last_compiler = nullptr;
+    last_arena = nullptr;
+  }
+  arenas.erase(compiler);
+}
+
+til::node_arena::scoped_release::~scoped_release() {
+  _compiler->ast(nullptr); // the nodes are gone
+  release(_compiler.get());
+}
@@ -0,0 +1,107 @@
+#ifndef __TIL_NODE_ARENA_H__
+#define __TIL_NODE_ARENA_H__
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace cdk {
+  class compiler;
+}
+
+namespace til {
+
+  /**
+   * Bump-pointer arena for syntax tree nodes.
+   *
+   * Nodes are carved out of large contiguous chunks and are never deleted one
+   * by one: release() destroys every node (what they own is freed) and then
+   * the chunks, at once. Everything allocated must be a cdk::basic_node. The
+   * arena of a compiler instance is obtained with node_arena::of().
+   */
+  class node_arena {
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> _chunks;
+    std::vector<void *> _objects; // in allocation order (destroyed with the arena)
+    char *_next = nullptr; // first free byte in the current chunk
+    char *_end = nullptr;  // end of the current chunk
+
+    bool _enabled;             // false: fall back to plain operator new
+    size_t _allocations = 0;
+    size_t _bytes = 0;         // bytes handed out (with alignment padding)
+    size_t _reserved = 0;      // bytes held in chunks
+
+  public:
+    /**
+     * @param enabled when false, allocations go to the global heap (they are
+     *        still counted, so both strategies can be compared)
+     */
+    explicit node_arena(bool enabled = true) :
+        _enabled(enabled) {
+    }
+
+    node_arena(const node_arena &) = delete;
+    node_arena &operator=(const node_arena &) = delete;
+
+    ~node_arena();
+
+  public:
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /** Forget the last allocation (its constructor threw). */
+    void abandon(void *p);
+
+    size_t allocations() const {
+      return _allocations;
+    }
+    size_t bytes() const {
+      return _bytes;
+    }
+    size_t reserved() const {
+      return _reserved;
+    }
+    size_t chunks() const {
+      return _chunks.size();
+    }
+
+    void report(std::ostream &os) const;
+
+  public:
+    /**
+     * The arena owned by the given compiler instance (created on first use).
+     * Setting TIL_NO_ARENA in the environment selects the heap fallback.
+     */
+    static node_arena &of(const cdk::compiler *compiler);
+
+    /** Bytes handed out so far by every arena (released ones included). */
+    static size_t allocated_bytes();
+
+    /** Release (in one shot) every node allocated for the given compiler. */
+    static void release(const cdk::compiler *compiler);
+
+    /** Releases the tree of a compiler (and its nodes) when it goes out of scope. */
+    class scoped_release {
+      std::shared_ptr<cdk::compiler> _compiler;
+
+    public:
+      explicit scoped_release(std::shared_ptr<cdk::compiler> compiler) :
+          _compiler(compiler) {
+      }
+      ~scoped_release();
+    };
+  };
+
+} // til
+
+inline void *operator new(size_t size, til::node_arena &arena) {
+  return arena.allocate(size);
+}
+
+// only called if a constructor throws: memory stays in the arena
+inline void operator delete(void *p, til::node_arena &arena) {
+  arena.abandon(p);
+}
+
+#endif
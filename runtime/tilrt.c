@@ -0,0 +1,149 @@
+#include "tilrt.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TILRT_BUFSIZE (1 << 16)
+
+static char out[TILRT_BUFSIZE];
+static size_t outlen;
+
+static char in[TILRT_BUFSIZE];
+static size_t inpos, inlen;
+static int interactive = -1; /* stdin is a terminal: flush before reading */
+
+/*-------------------------------------------------------------------------*/
+
+void tilrt_flush(void) {
+  size_t done = 0;
+  while (done < outlen) {
+    ssize_t n = write(1, out + done, outlen - done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  outlen = 0;
+}
+
+static void put(const char *s, size_t n) {
+  if (outlen + n > TILRT_BUFSIZE) {
+    tilrt_flush();
+    if (n > TILRT_BUFSIZE) { /* too large to buffer */
+      while (n > 0) {
+        ssize_t w = write(1, s, n);
+        if (w <= 0)
+          return;
+        s += w;
+        n -= w;
+      }
+      return;
+    }
+  }
+  memcpy(out + outlen, s, n);
+  outlen += n;
+}
+
+void printi(int value) {
+  char digits[12];
+  char *p = digits + sizeof(digits);
+  unsigned int u = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u != 0);
+  if (value < 0)
+    *--p = '-';
+  put(p, digits + sizeof(digits) - p);
+}
+
+void printd(double value) {
+  char digits[32];
+  int n = snprintf(digits, sizeof(digits), "%g", value);
+  put(digits, n);
+}
+
+void prints(const char *value) {
+  put(value, strlen(value));
+}
+
+void println(void) {
+  put("\n", 1);
+}
+
+void tilprint(const char *kinds, ...) {
+  va_list args;
+  va_start(args, kinds);
+  for (; *kinds; kinds++) {
+    switch (*kinds) {
+      case 'i': printi(va_arg(args, int)); break;
+      case 'd': printd(va_arg(args, double)); break;
+      case 's': prints(va_arg(args, const char *)); break;
+      case 'n': println(); break;
+    }
+  }
+  va_end(args);
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* next input character, or EOF */
+static int next(void) {
+  if (inpos == inlen) {
+    if (interactive < 0)
+      interactive = isatty(0);
+    if (interactive)
+      tilrt_flush();
+    ssize_t n = read(0, in, sizeof(in));
+    if (n <= 0)
+      return EOF;
+    inpos = 0;
+    inlen = n;
+  }
+  return (unsigned char)in[inpos++];
+}
+
+static void unread(void) {
+  inpos--;
+}
+
+/* copy the next whitespace-delimited token (truncated to size - 1) */
+static size_t token(char *buffer, size_t size) {
+  int c;
+  size_t n = 0;
+  while ((c = next()) != EOF && (c == ' ' || c == '\t' || c == '\n' || c == '\r'))
+    ;
+  while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+    if (n + 1 < size)
+      buffer[n++] = c;
+    c = next();
+  }
+  if (c != EOF)
+    unread();
+  buffer[n] = '\0';
+  return n;
+}
+
+int readi(void) {
+  char buffer[64];
+  token(buffer, sizeof(buffer));
+  return (int)strtol(buffer, NULL, 10);
+}
+
+double readd(void) {
+  char buffer[64];
+  token(buffer, sizeof(buffer));
+  return strtod(buffer, NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+
+extern int _main(void);
+
+int main(void) {
+  int status = _main();
+  tilrt_flush();
+  return status;
+}
@@ -0,0 +1,39 @@
+#ifndef __TIL_RUNTIME_TILRT_H__
+#define __TIL_RUNTIME_TILRT_H__
+
+/*
+ * Buffered input/output for TIL programs (i386, cdecl).
+ *
+ * Drop-in replacement for the I/O functions of the course RTS: output is
+ * kept in a large buffer and written in blocks, input is read in blocks and
+ * parsed from memory. The library also defines main, which calls the TIL
+ * program (_main) and flushes the output when it returns.
+ *
+ *   make runtime/libtilrt.a
+ *   gcc -m32 -o prog prog.o runtime/libtilrt.a
+ *
+ * The x64 target uses the native build of the same sources:
+ *
+ *   make runtime/libtilrt64.a
+ *   gcc -o prog prog.s runtime/libtilrt64.a
+ *
+ * Compile with TIL_BUFFERED_RTS set in the environment to have each print
+ * instruction call tilprint once, for all its arguments.
+ */
+
+/* one character per argument: 'i' int, 'd' double, 's' string; a trailing
+ * 'n' prints a newline */
+void tilprint(const char *kinds, ...);
+
+void printi(int value);
+void printd(double value);
+void prints(const char *value);
+void println(void);
+
+int readi(void);
+double readd(void);
+
+/* write the buffered output */
+void tilrt_flush(void);
+
+#endif
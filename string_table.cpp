@@ -0,0 +1,11 @@
+#include "string_table.h"
+
+void til::string_table::report(std::ostream &os) const {
+  os << "string table: " << _strings.size() << " distinct strings (" << _bytes
+     << " bytes) for " << _lookups << " tokens" << std::endl;
+}
+
+til::string_table &til::string_table::instance() {
+  static string_table table;
+  return table;
+}
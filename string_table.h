@@ -0,0 +1,63 @@
+#ifndef __TIL_STRING_TABLE_H__
+#define __TIL_STRING_TABLE_H__
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace til {
+
+  /**
+   * Interning table for identifiers and string literals.
+   *
+   * Each distinct string is stored once: intern() returns a stable handle
+   * (the same pointer for equal contents) that stays valid for the whole
+   * compilation, so handles can be compared instead of strings.
+   */
+  class string_table {
+    struct hash {
+      using is_transparent = void;
+      size_t operator()(std::string_view text) const {
+        return std::hash<std::string_view>()(text);
+      }
+    };
+
+    // node-based container: element addresses survive rehashing
+    std::unordered_set<std::string, hash, std::equal_to<>> _strings;
+    size_t _lookups = 0;
+    size_t _bytes = 0; // characters stored
+
+  public:
+    const std::string *intern(std::string_view text) {
+      _lookups++;
+      auto it = _strings.find(text);
+      if (it == _strings.end()) {
+        it = _strings.emplace(text).first;
+        _bytes += text.size();
+      }
+      return &*it;
+    }
+
+    size_t size() const {
+      return _strings.size();
+    }
+    size_t lookups() const {
+      return _lookups;
+    }
+    size_t bytes() const {
+      return _bytes;
+    }
+
+    void report(std::ostream &os) const;
+
+  public:
+    /** The table used by the scanner. */
+    static string_table &instance();
+  };
+
+} // til
+
+#endif
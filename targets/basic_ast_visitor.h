@@ -5,8 +5,7 @@
 #include <memory>
 #include <iostream>
 #include <cdk/compiler.h>
-#include <cdk/symbol_table.h>
-#include "targets/symbol.h"
+#include "targets/symbol_table.h"
 
 /* do not edit -- include node forward declarations */
 #define __NODE_DECLARATIONS_ONLY__
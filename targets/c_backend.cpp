@@ -0,0 +1,486 @@
+#include "targets/c_backend.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  const char *c_type(til::ir::type type) {
+    switch (type) {
+      case til::ir::type::VOID: return "void";
+      case til::ir::type::INT: return "int";
+      case til::ir::type::DOUBLE: return "double";
+      case til::ir::type::PTR: return "char *";
+    }
+    return "?";
+  }
+
+  std::string declaration(til::ir::type type, const std::string &name) {
+    return std::string(c_type(type)) + (type == til::ir::type::PTR ? "" : " ") + name;
+  }
+
+  // suffix of the memory access helpers
+  const char *access(til::ir::type type) {
+    return type == til::ir::type::INT ? "int" : type == til::ir::type::DOUBLE ? "double" : "ptr";
+  }
+
+  // the exact value (hexadecimal, for finite values)
+  std::string double_constant(double value) {
+    if (std::isnan(value))
+      return "(0.0 / 0.0)";
+    if (std::isinf(value))
+      return value > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+    char text[40];
+    std::snprintf(text, sizeof text, value < 0 ? "(%a)" : "%a", value);
+    return text;
+  }
+
+  std::string string_literal(const std::string &value) {
+    std::string text = "\"";
+    for (unsigned char c : value) {
+      if (c == '"' || c == '\\' || c == '?') {
+        text += '\\';
+        text += c;
+      } else if (c < 32 || c >= 127) {
+        char escape[8];
+        std::snprintf(escape, sizeof escape, "\\%03o", c);
+        text += escape;
+      } else {
+        text += c;
+      }
+    }
+    return text + "\"";
+  }
+
+  std::string label(const til::ir::block *b) {
+    return "b" + std::to_string(b->id);
+  }
+
+  // TIL names are prefixed, so that they clash neither with the locals
+  // (v<n>, p<n>, s<n>) nor with C keywords or library names
+  std::string mangled(const std::string &name) {
+    return "t_" + name;
+  }
+
+  // an asm label keeps the TIL name in the object file (for the linker)
+  std::string linked(const std::string &name) {
+    return " __asm__(\"" + name + "\")";
+  }
+
+  bool rematerialized(const til::ir::instruction *value) {
+    switch (value->op) {
+      case til::ir::opcode::CONST:
+      case til::ir::opcode::DCONST:
+      case til::ir::opcode::STRING:
+      case til::ir::opcode::SYMBOL:
+      case til::ir::opcode::PARAM:
+      case til::ir::opcode::UNDEF:
+      case til::ir::opcode::SLOT:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  const char *comparison(til::ir::opcode op) {
+    switch (op) {
+      case til::ir::opcode::EQ: case til::ir::opcode::DEQ: return "==";
+      case til::ir::opcode::NE: case til::ir::opcode::DNE: return "!=";
+      case til::ir::opcode::LT: case til::ir::opcode::DLT: return "<";
+      case til::ir::opcode::LE: case til::ir::opcode::DLE: return "<=";
+      case til::ir::opcode::GT: case til::ir::opcode::DGT: return ">";
+      default: return ">=";
+    }
+  }
+
+  const char *const prelude =
+    "#include <alloca.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static inline int til_load_int(const char *p) { int v; memcpy(&v, p, sizeof v); return v; }\n"
+    "static inline double til_load_double(const char *p) { double v; memcpy(&v, p, sizeof v); return v; }\n"
+    "static inline char *til_load_ptr(const char *p) { char *v; memcpy(&v, p, sizeof v); return v; }\n"
+    "static inline void til_store_int(char *p, int v) { memcpy(p, &v, sizeof v); }\n"
+    "static inline void til_store_double(char *p, double v) { memcpy(p, &v, sizeof v); }\n"
+    "static inline void til_store_ptr(char *p, char *v) { memcpy(p, &v, sizeof v); }\n";
+
+}
+
+//---------------------------------------------------------------------------
+
+void til::c_backend::emit(const ir::module &m) {
+  for (auto &f : m.functions)
+    _signatures[f->name] = { f->result, f->params };
+  for (auto &e : ir::externals_of(m)) {
+    _externals[e.first] = e.second.memory;
+    _signatures[e.first] = e.second.types;
+  }
+  find_live(m);
+
+  _os << "/* TIL program */" << std::endl << prelude << std::endl;
+  for (auto &e : _externals) {
+    if (e.second)
+      _os << "extern char " << mangled(e.first) << "[]" << linked(e.first) << ";" << std::endl;
+    else
+      _os << prototype(e.first, _signatures.at(e.first), false) << linked(e.first) << ";" << std::endl;
+  }
+  for (auto &f : m.functions)
+    if (_live.count(f->name) > 0)
+      _os << (f->exported ? "" : "static ") << prototype(f->name, _signatures.at(f->name), false)
+          << (f->exported ? linked(f->name) : "") << ";" << std::endl;
+  _os << std::endl;
+
+  for (auto &g : m.globals)
+    if (_live.count(g.name) > 0)
+      emit_global(g);
+  for (auto &f : m.functions)
+    if (_live.count(f->name) > 0)
+      emit_function(*f);
+}
+
+// what the exported definitions refer to, directly or not (C compilers warn
+// of static definitions that are never used)
+void til::c_backend::find_live(const ir::module &m) {
+  std::unordered_map<std::string, const ir::function *> functions;
+  std::unordered_map<std::string, const ir::global *> globals;
+  std::vector<std::string> work;
+  for (auto &f : m.functions) {
+    functions[f->name] = f.get();
+    if (f->exported)
+      work.push_back(f->name);
+  }
+  for (auto &g : m.globals) {
+    globals[g.name] = &g;
+    if (g.exported)
+      work.push_back(g.name);
+  }
+
+  while (!work.empty()) {
+    auto name = work.back();
+    work.pop_back();
+    if (!_live.insert(name).second)
+      continue;
+    auto g = globals.find(name);
+    if (g != globals.end() && g->second->kind == ir::global::init::SYMBOL)
+      work.push_back(g->second->s);
+    auto f = functions.find(name);
+    if (f != functions.end())
+      for (auto &b : f->second->blocks)
+        for (auto &instr : b->code)
+          if (instr->op == ir::opcode::SYMBOL || instr->op == ir::opcode::CALL)
+            work.push_back(instr->s);
+  }
+}
+
+std::string til::c_backend::prototype(const std::string &name, const signature &s, bool named_params) {
+  std::string text = declaration(s.result, mangled(name)) + "(";
+  for (size_t k = 0; k < s.params.size(); k++)
+    text += std::string(k > 0 ? ", " : "")
+            + (named_params ? declaration(s.params[k], "p" + std::to_string(k)) : c_type(s.params[k]));
+  return text + (s.params.empty() ? "void)" : ")");
+}
+
+void til::c_backend::emit_global(const ir::global &g) {
+  _os << (g.exported ? "" : "static ") << declaration(g.type, mangled(g.name)) << (g.exported ? linked(g.name) : "");
+  switch (g.kind) {
+    case ir::global::init::ZERO:
+      break;
+    case ir::global::init::INT:
+      _os << " = " << constant(g.i, g.type);
+      break;
+    case ir::global::init::DOUBLE:
+      _os << " = " << double_constant(g.d);
+      break;
+    case ir::global::init::STRING:
+      _os << " = " << string_literal(g.s);
+      break;
+    case ir::global::init::SYMBOL:
+      _os << " = " << symbol(g.s);
+      break;
+  }
+  _os << ";" << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+void til::c_backend::emit_function(const ir::function &f) {
+  _function = &f;
+  _names.clear();
+  _uses.clear();
+  _targets.clear();
+
+  std::vector<bool> used(f.params.size());
+  for (auto &b : f.blocks)
+    for (auto &instr : b->code)
+      for (auto arg : instr->args) {
+        _uses[arg]++;
+        if (arg->op == ir::opcode::PARAM)
+          used[arg->i] = true;
+      }
+
+  // locals: used values (a PHI also has the copy made on the edges) and slots
+  _os << std::endl << (f.exported ? "" : "static ") << prototype(f.name, _signatures.at(f.name), true) << " {"
+      << std::endl;
+  int values = 0, slots = 0;
+  for (auto &b : f.blocks)
+    for (auto &instr : b->code) {
+      if (instr->op == ir::opcode::SLOT) {
+        _names[instr.get()] = "s" + std::to_string(slots++);
+        _os << "  double " << _names[instr.get()] << "[" << (instr->i + 7) / 8 << "];" << std::endl; // aligned
+      } else if (!rematerialized(instr.get()) && instr->type != ir::type::VOID && _uses[instr.get()] > 0) {
+        auto &name = _names[instr.get()] = "v" + std::to_string(values++);
+        _os << "  " << declaration(instr->type, name);
+        if (instr->op == ir::opcode::PHI)
+          _os << ", " << (instr->type == ir::type::PTR ? "*" : "") << name << "_in";
+        _os << ";" << std::endl;
+      }
+    }
+  for (size_t k = 0; k < f.params.size(); k++)
+    if (!used[k])
+      _os << "  (void)p" << k << ";" << std::endl;
+
+  auto order = f.reverse_postorder();
+  std::vector<std::string> code;
+  for (size_t k = 0; k < order.size(); k++) {
+    auto b = order[k];
+    _next = k + 1 < order.size() ? order[k + 1] : nullptr;
+    for (auto &instr : b->code)
+      if (instr->op == ir::opcode::PHI && _names.count(instr.get()) > 0)
+        _code << "  " << _names[instr.get()] << " = " << _names[instr.get()] << "_in;" << std::endl;
+    for (auto &instr : b->code)
+      if (!rematerialized(instr.get()) && instr->op != ir::opcode::PHI)
+        emit_instruction(instr.get());
+    code.push_back(_code.str());
+    _code.str("");
+  }
+
+  for (size_t k = 0; k < order.size(); k++) {
+    if (_targets.count(order[k]) > 0)
+      _os << label(order[k]) << ":" << std::endl;
+    _os << code[k];
+  }
+  _os << "}" << std::endl;
+  _function = nullptr;
+}
+
+void til::c_backend::emit_edge(const ir::block *from, const ir::block *to, const std::string &indent) {
+  for (auto &instr : to->code) {
+    if (instr->op != ir::opcode::PHI)
+      break;
+    if (_names.count(instr.get()) == 0)
+      continue;
+    for (size_t k = 0; k < instr->blocks.size(); k++)
+      if (instr->blocks[k] == from)
+        _code << indent << _names[instr.get()] << "_in = " << operand(instr->args[k], instr->type) << ";"
+              << std::endl;
+  }
+  if (to != _next) {
+    _code << indent << "goto " << label(to) << ";" << std::endl;
+    _targets.insert(to);
+  }
+}
+
+//---------------------------------------------------------------------------
+
+std::string til::c_backend::constant(int value, ir::type type) {
+  switch (type) {
+    case ir::type::PTR:
+      return value == 0 ? "(char *)0" : "(char *)(intptr_t)" + std::to_string(value);
+    case ir::type::DOUBLE:
+      return double_constant(value);
+    default:
+      if (value == INT_MIN)
+        return "(-2147483647 - 1)";
+      return value < 0 ? "(" + std::to_string(value) + ")" : std::to_string(value);
+  }
+}
+
+std::string til::c_backend::symbol(const std::string &name) {
+  auto external = _externals.find(name);
+  if (external != _externals.end() && external->second)
+    return mangled(name); // a char array
+  if (_signatures.count(name) > 0)
+    return "(char *)(intptr_t)" + mangled(name); // not a direct cast (not allowed in ISO C)
+  return "(char *)&" + mangled(name);
+}
+
+std::string til::c_backend::operand(const ir::instruction *value, ir::type type) {
+  std::string text;
+  switch (value->op) {
+    case ir::opcode::CONST: return constant(value->i, type);
+    case ir::opcode::UNDEF: return type == ir::type::DOUBLE ? "0.0" : constant(0, type);
+    case ir::opcode::DCONST: text = double_constant(value->d); break;
+    case ir::opcode::STRING: text = string_literal(value->s); break;
+    case ir::opcode::SYMBOL: text = symbol(value->s); break;
+    case ir::opcode::PARAM: text = "p" + std::to_string(value->i); break;
+    case ir::opcode::SLOT: text = "(char *)" + _names.at(value); break;
+    default: text = _names.at(value); break;
+  }
+  if (value->type == type)
+    return text;
+  if (value->type == ir::type::INT && type == ir::type::PTR)
+    return "(char *)(intptr_t)" + text;
+  if (value->type == ir::type::PTR && type == ir::type::INT)
+    return "(int)(intptr_t)" + text;
+  if (value->type == ir::type::INT && type == ir::type::DOUBLE)
+    return "(double)" + text;
+  return text;
+}
+
+// the call expression (through a cast, if the types differ from the callee's)
+std::string til::c_backend::call(const ir::instruction *call) {
+  bool indirect = call->op == ir::opcode::CALLI;
+  signature actual { call->type, {} };
+  for (size_t k = indirect ? 1 : 0; k < call->args.size(); k++)
+    actual.params.push_back(call->args[k]->type);
+
+  // a direct call uses the declared types, unless the arity or result differ
+  signature used = actual;
+  std::string callee;
+  auto target = indirect ? call->args[0] : nullptr;
+  if (target != nullptr && target->op == ir::opcode::SYMBOL && _signatures.count(target->s) > 0
+      && _externals.count(target->s) == 0)
+    indirect = false; // the address of a function of this module
+  auto name = indirect ? std::string() : target != nullptr ? target->s : call->s;
+  if (!indirect) {
+    auto &declared = _signatures.at(name);
+    if (declared.result == actual.result && declared.params.size() == actual.params.size()) {
+      used = declared;
+      callee = mangled(name);
+    }
+  }
+  if (callee.empty()) {
+    std::string pointer = "(" + std::string(c_type(actual.result)) + " (*)(";
+    for (size_t k = 0; k < actual.params.size(); k++)
+      pointer += std::string(k > 0 ? ", " : "") + c_type(actual.params[k]);
+    pointer += actual.params.empty() ? "void))" : "))";
+    callee = "(" + pointer + (indirect ? "(intptr_t)" + operand(target, ir::type::PTR) : mangled(name)) + ")";
+  }
+
+  std::string text = callee + "(";
+  for (size_t k = 0; k < used.params.size(); k++)
+    text += std::string(k > 0 ? ", " : "") + operand(call->args[k + (target != nullptr ? 1 : 0)], used.params[k]);
+  return text + ")";
+}
+
+void til::c_backend::emit_instruction(const ir::instruction *instr) {
+  auto a = instr->args.empty() ? nullptr : instr->args[0];
+  auto b = instr->args.size() < 2 ? nullptr : instr->args[1];
+  auto named = _names.find(instr);
+  auto value = named == _names.end() ? std::string() : named->second;
+  if (value.empty() && !ir::has_side_effects(instr->op))
+    return; // unused
+
+  switch (instr->op) {
+    // wrapping, as in the other targets
+    case ir::opcode::ADD: case ir::opcode::SUB: case ir::opcode::MUL: {
+      const char *op = instr->op == ir::opcode::ADD ? "+" : instr->op == ir::opcode::SUB ? "-" : "*";
+      _code << "  " << value << " = (int)((unsigned)" << operand(a, ir::type::INT) << " " << op << " (unsigned)"
+            << operand(b, ir::type::INT) << ");" << std::endl;
+      break;
+    }
+    case ir::opcode::DIV: case ir::opcode::MOD:
+      _code << "  " << value << " = " << operand(a, ir::type::INT) << (instr->op == ir::opcode::DIV ? " / " : " % ")
+            << operand(b, ir::type::INT) << ";" << std::endl;
+      break;
+    case ir::opcode::NEG:
+      _code << "  " << value << " = (int)(0u - (unsigned)" << operand(a, ir::type::INT) << ");" << std::endl;
+      break;
+
+    case ir::opcode::DADD: case ir::opcode::DSUB: case ir::opcode::DMUL: case ir::opcode::DDIV: {
+      const char *op = instr->op == ir::opcode::DADD ? " + " : instr->op == ir::opcode::DSUB ? " - "
+                       : instr->op == ir::opcode::DMUL ? " * " : " / ";
+      _code << "  " << value << " = " << operand(a, ir::type::DOUBLE) << op << operand(b, ir::type::DOUBLE) << ";"
+            << std::endl;
+      break;
+    }
+    case ir::opcode::DNEG:
+      _code << "  " << value << " = -" << operand(a, ir::type::DOUBLE) << ";" << std::endl;
+      break;
+    case ir::opcode::I2D:
+      _code << "  " << value << " = (double)" << operand(a, ir::type::INT) << ";" << std::endl;
+      break;
+
+    case ir::opcode::EQ: case ir::opcode::NE: case ir::opcode::LT:
+    case ir::opcode::LE: case ir::opcode::GT: case ir::opcode::GE: {
+      auto compared = a->type == ir::type::PTR || b->type == ir::type::PTR ? ir::type::PTR : ir::type::INT;
+      _code << "  " << value << " = " << operand(a, compared) << " " << comparison(instr->op) << " "
+            << operand(b, compared) << ";" << std::endl;
+      break;
+    }
+    case ir::opcode::DEQ: case ir::opcode::DNE: case ir::opcode::DLT:
+    case ir::opcode::DLE: case ir::opcode::DGT: case ir::opcode::DGE:
+      _code << "  " << value << " = " << operand(a, ir::type::DOUBLE) << " " << comparison(instr->op) << " "
+            << operand(b, ir::type::DOUBLE) << ";" << std::endl;
+      break;
+
+    case ir::opcode::PTRADD:
+      _code << "  " << value << " = " << operand(a, ir::type::PTR) << " + " << operand(b, ir::type::INT) << ";"
+            << std::endl;
+      break;
+    case ir::opcode::PTRDIFF:
+      _code << "  " << value << " = (int)(" << operand(a, ir::type::PTR) << " - " << operand(b, ir::type::PTR)
+            << ");" << std::endl;
+      break;
+
+    case ir::opcode::ALLOCA:
+      _code << "  " << (value.empty() ? "" : value + " = (char *)") << "alloca(" << operand(a, ir::type::INT)
+            << ");" << std::endl;
+      break;
+    case ir::opcode::LOAD:
+      _code << "  " << value << " = til_load_" << access(instr->type) << "(" << operand(a, ir::type::PTR) << ");"
+            << std::endl;
+      break;
+    case ir::opcode::STORE:
+      _code << "  til_store_" << access(a->type) << "(" << operand(b, ir::type::PTR) << ", "
+            << operand(a, a->type) << ");" << std::endl;
+      break;
+
+    case ir::opcode::CALL: case ir::opcode::CALLI:
+      _code << "  " << (value.empty() ? "" : value + " = ") << call(instr) << ";" << std::endl;
+      break;
+
+    case ir::opcode::JMP:
+      emit_edge(instr->parent, instr->blocks[0], "  ");
+      break;
+    case ir::opcode::BR: {
+      auto condition = operand(a, a->type);
+      auto then = instr->blocks[0], otherwise = instr->blocks[1];
+      auto copies = [](const ir::block *to) {
+        return !to->code.empty() && to->code[0]->op == ir::opcode::PHI;
+      };
+      if (then == _next && !copies(otherwise)) {
+        _code << "  if (!" << condition << ") goto " << label(otherwise) << ";" << std::endl;
+        _targets.insert(otherwise);
+        emit_edge(instr->parent, then, "  ");
+        break;
+      }
+      if (copies(then)) {
+        _code << "  if (" << condition << ") {" << std::endl;
+        auto next = _next;
+        _next = nullptr; // the copies must jump
+        emit_edge(instr->parent, then, "    ");
+        _next = next;
+        _code << "  }" << std::endl;
+      } else {
+        _code << "  if (" << condition << ") goto " << label(then) << ";" << std::endl;
+        _targets.insert(then);
+      }
+      emit_edge(instr->parent, otherwise, "  ");
+      break;
+    }
+    case ir::opcode::RET:
+      if (a == nullptr || _function->result == ir::type::VOID)
+        _code << "  return;" << std::endl;
+      else
+        _code << "  return " << operand(a, _function->result) << ";" << std::endl;
+      break;
+
+    default:
+      break;
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef __TIL_TARGETS_C_BACKEND_H__
+#define __TIL_TARGETS_C_BACKEND_H__
+
+#include "targets/ir.h"
+
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Write an IR module as C (C99), for a C compiler to optimise.
+   *
+   * Each value is a local variable assigned once (a PHI is assigned from a
+   * copy made on each incoming edge) and blocks are labels joined by gotos.
+   * Functions are static, unless exported; function values are pointers,
+   * called through casts. Addresses are char pointers and memory is read and
+   * written with memcpy, so that no access breaks the aliasing rules. Frame
+   * slots are local arrays and objects come from alloca. Integer arithmetic
+   * wraps (it is done unsigned). print and read call the runtime library.
+   *
+   * TIL names get a prefix in C; exported and external ones are linked under
+   * their own names with asm labels (a GCC extension, also in clang).
+   *
+   * Function and data pointers are converted to each other through intptr_t
+   * (as POSIX requires to work). The module must be built with 8-byte
+   * addresses.
+   */
+  class c_backend {
+    using signature = ir::signature;
+
+    std::ostream &_os;
+    std::unordered_map<std::string, signature> _signatures; // functions, defined and external
+    std::map<std::string, bool> _externals;                 // true if used as memory
+    std::unordered_set<std::string> _live;                  // definitions written
+
+    // per function
+    std::unordered_map<const ir::instruction *, std::string> _names;
+    std::unordered_map<const ir::instruction *, int> _uses;
+    const ir::function *_function = nullptr;
+    const ir::block *_next = nullptr; // written after the current block
+    std::unordered_set<const ir::block *> _targets; // of gotos (only they get labels)
+    std::ostringstream _code;                        // of the current block
+
+  public:
+    c_backend(std::ostream &os) :
+        _os(os) {
+    }
+
+  public:
+    void emit(const ir::module &m);
+
+  private:
+    void find_live(const ir::module &m);
+    void emit_global(const ir::global &g);
+    void emit_function(const ir::function &f);
+    void emit_instruction(const ir::instruction *instr);
+    std::string call(const ir::instruction *call);
+
+    /** Assign the PHIs of a block from one of its predecessors, then go there. */
+    void emit_edge(const ir::block *from, const ir::block *to, const std::string &indent);
+
+    /** An operand, as a C expression of the given type. */
+    std::string operand(const ir::instruction *value, ir::type type);
+    std::string constant(int value, ir::type type);
+    std::string symbol(const std::string &name);
+
+    std::string prototype(const std::string &name, const signature &s, bool named_params);
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,7 @@
+#include "targets/c_target.h"
+
+/**
+ * C source.
+ * @var create and register an evaluator for C targets.
+ */
+til::c_target til::c_target::_self;
@@ -0,0 +1,55 @@
+#ifndef __TIL_TARGETS_C_TARGET_H__
+#define __TIL_TARGETS_C_TARGET_H__
+
+#include <cdk/targets/basic_target.h>
+#include <cdk/ast/basic_node.h>
+#include "targets/front_end.h"
+#include "targets/c_backend.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
+
+namespace til {
+
+  /**
+   * C source, through the intermediate representation.
+   *
+   *   til --target c prog.til -o prog.c
+   *   gcc -O2 -o prog prog.c runtime/libtilrt64.a
+   */
+  class c_target: public cdk::basic_target {
+    static c_target _self;
+
+  private:
+    c_target() :
+        cdk::basic_target("c") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
+      front_end front(compiler);
+      auto module = front.analyse() ? front.build_ir(8) : nullptr;
+      if (module == nullptr) {
+        report.print_if_requested(std::cerr);
+        return false;
+      }
+
+      c_backend backend(*compiler->ostream());
+      {
+        til::scoped_pass pass("code generation");
+        backend.emit(*module);
+        compiler->ostream()->flush();
+      }
+
+      report.print_if_requested(std::cerr);
+      return true;
+    }
+
+  };
+
+} // til
+
+#endif
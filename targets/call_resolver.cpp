@@ -0,0 +1,89 @@
+#include "targets/call_resolver.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+#include "til_parser.tab.h"
+
+//---------------------------------------------------------------------------
+
+void til::call_resolver::resolve(cdk::basic_node *root) {
+  root->accept(this, 0);
+
+  for (auto &call : _calls) {
+    auto it = _globals.find(call.second);
+    if (it == _globals.end() || !it->second.fixed)
+      continue;
+    if (it->second.function != nullptr)
+      _targets[call.first].function = it->second.function;
+    else if (it->second.external)
+      _targets[call.first].external = call.second;
+  }
+}
+
+const std::string *til::call_resolver::global_name(cdk::basic_node *node) const {
+  auto rvalue = dynamic_cast<cdk::rvalue_node *>(node);
+  auto variable = dynamic_cast<cdk::variable_node *>(rvalue ? rvalue->lvalue() : node);
+  if (variable == nullptr)
+    return nullptr;
+  for (auto &scope : _scopes)
+    if (scope.count(variable->name()) > 0)
+      return nullptr;
+  return &variable->name();
+}
+
+//---------------------------------------------------------------------------
+
+void til::call_resolver::do_declaration_node(til::declaration_node *const node, int lvl) {
+  tree_walker::do_declaration_node(node, lvl);
+
+  if (!_scopes.empty()) {
+    _scopes.back().insert(node->identifier());
+    return;
+  }
+
+  auto function = dynamic_cast<til::function_node *>(node->initializer());
+  bool external = node->qualifier() == tEXTERNAL;
+  auto inserted = _globals.emplace(node->identifier(), global());
+  auto &g = inserted.first->second;
+  if (!inserted.second && (function != nullptr || external || node->initializer() != nullptr) &&
+      (g.function != nullptr || g.external))
+    g.fixed = false; // two definitions
+  if (function != nullptr)
+    g.function = function;
+  else if (external)
+    g.external = true;
+  else if (node->initializer() != nullptr)
+    g.fixed = false; // initialised with some other function value
+}
+
+void til::call_resolver::do_function_node(til::function_node *const node, int lvl) {
+  _scopes.emplace_back();
+  tree_walker::do_function_node(node, lvl);
+  _scopes.pop_back();
+}
+
+void til::call_resolver::do_block_node(til::block_node *const node, int lvl) {
+  _scopes.emplace_back();
+  tree_walker::do_block_node(node, lvl);
+  _scopes.pop_back();
+}
+
+void til::call_resolver::do_function_call_node(til::function_call_node *const node, int lvl) {
+  if (auto name = global_name(node->func())) {
+    _calls.emplace_back(node, *name);
+    walk(node->arguments(), lvl + 2); // the callee itself is not a use of its value
+  } else {
+    tree_walker::do_function_call_node(node, lvl);
+  }
+}
+
+void til::call_resolver::do_assignment_node(cdk::assignment_node *const node, int lvl) {
+  if (auto name = global_name(node->lvalue()))
+    _globals[*name].fixed = false;
+  tree_walker::do_assignment_node(node, lvl);
+}
+
+void til::call_resolver::do_address_of_node(til::address_of_node *const node, int lvl) {
+  if (auto name = global_name(node->lvalue()))
+    _globals[*name].fixed = false;
+  tree_walker::do_address_of_node(node, lvl);
+}
@@ -0,0 +1,78 @@
+#ifndef __TIL_TARGETS_CALL_RESOLVER_H__
+#define __TIL_TARGETS_CALL_RESOLVER_H__
+
+#include "targets/tree_walker.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Callee of a call known at compile time: a function literal or an
+   * external function.
+   */
+  struct call_target {
+    til::function_node *function = nullptr;
+    std::string external;
+  };
+
+  /**
+   * Find the calls whose callee is known at compile time.
+   *
+   * A call through a global variable is direct if the variable is initialised
+   * with a function literal (or declared external), is not declared again
+   * with another value, and is never assigned or has its address taken. The
+   * variable must not be shadowed by a local or argument at the call site.
+   */
+  class call_resolver: public tree_walker {
+    struct global {
+      til::function_node *function = nullptr;
+      bool external = false;
+      bool fixed = true; // not reassigned, redefined or address-taken
+    };
+
+    std::unordered_map<std::string, global> _globals;
+    std::vector<std::unordered_set<std::string>> _scopes; // locals in scope
+    std::vector<std::pair<til::function_call_node *, std::string>> _calls; // through global names
+
+    std::unordered_map<const til::function_call_node *, call_target> _targets;
+
+  public:
+    call_resolver(std::shared_ptr<cdk::compiler> compiler) :
+        tree_walker(compiler) {
+    }
+
+  public:
+    /** The known callee of the call, or null. */
+    const call_target *target(const til::function_call_node *node) const {
+      auto it = _targets.find(node);
+      return it == _targets.end() ? nullptr : &it->second;
+    }
+
+    size_t resolved() const {
+      return _targets.size();
+    }
+
+    /** Resolve the calls of a whole program. */
+    void resolve(cdk::basic_node *root);
+
+  protected:
+    /** The global variable named by the expression, if any (not shadowed). */
+    const std::string *global_name(cdk::basic_node *node) const;
+
+  public:
+    void do_declaration_node(til::declaration_node *const node, int lvl);
+    void do_function_node(til::function_node *const node, int lvl);
+    void do_block_node(til::block_node *const node, int lvl);
+    void do_function_call_node(til::function_call_node *const node, int lvl);
+    void do_assignment_node(cdk::assignment_node *const node, int lvl);
+    void do_address_of_node(til::address_of_node *const node, int lvl);
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,206 @@
+#include <climits>
+#include <cstdint>
+#include "targets/constant_folder.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  // 32-bit two's complement arithmetic, as performed by the target
+  int wrap(int64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+  }
+
+}
+
+void til::constant_folder::set_int(const cdk::expression_node *node, int value) {
+  _values[node] = { false, value, 0 };
+}
+
+void til::constant_folder::set_double(const cdk::expression_node *node, double value) {
+  _values[node] = { true, 0, value };
+}
+
+//---------------------------------------------------------------------------
+
+void til::constant_folder::do_integer_node(cdk::integer_node *const node, int lvl) {
+  set_int(node, node->value());
+}
+
+void til::constant_folder::do_double_node(cdk::double_node *const node, int lvl) {
+  set_double(node, node->value());
+}
+
+void til::constant_folder::do_sizeof_node(til::sizeof_node *const node, int lvl) {
+  // the argument is never evaluated: only its type matters
+  tree_walker::do_sizeof_node(node, lvl);
+  set_int(node, node->argument()->type()->size());
+  _folded++;
+}
+
+//---------------------------------------------------------------------------
+
+void til::constant_folder::do_not_node(cdk::not_node *const node, int lvl) {
+  tree_walker::do_not_node(node, lvl);
+  auto arg = value(node->argument());
+  if (arg == nullptr || arg->is_double)
+    return;
+  set_int(node, arg->i == 0);
+  _folded++;
+}
+
+void til::constant_folder::do_unary_minus_node(cdk::unary_minus_node *const node, int lvl) {
+  tree_walker::do_unary_minus_node(node, lvl);
+  auto arg = value(node->argument());
+  if (arg == nullptr)
+    return;
+  if (arg->is_double)
+    set_double(node, -arg->d);
+  else
+    set_int(node, wrap(-static_cast<int64_t>(arg->i)));
+  _folded++;
+}
+
+void til::constant_folder::do_unary_plus_node(cdk::unary_plus_node *const node, int lvl) {
+  tree_walker::do_unary_plus_node(node, lvl);
+  auto arg = value(node->argument());
+  if (arg == nullptr)
+    return;
+  _values[node] = *arg;
+  _folded++;
+}
+
+//---------------------------------------------------------------------------
+
+template<typename IntOp, typename DoubleOp>
+void til::constant_folder::fold_arithmetic(cdk::binary_operation_node *const node, int lvl,
+                                           IntOp int_op, DoubleOp double_op) {
+  node->left()->accept(this, lvl + 2);
+  node->right()->accept(this, lvl + 2);
+
+  // pointer arithmetic depends on addresses: never constant
+  if (!node->is_typed(cdk::TYPE_INT) && !node->is_typed(cdk::TYPE_DOUBLE))
+    return;
+
+  auto left = value(node->left()), right = value(node->right());
+  if (left == nullptr || right == nullptr)
+    return;
+
+  if (node->is_typed(cdk::TYPE_DOUBLE)) {
+    double result;
+    if (!double_op(left->as_double(), right->as_double(), result))
+      return;
+    set_double(node, result);
+  } else {
+    int result;
+    if (left->is_double || right->is_double || !int_op(left->i, right->i, result))
+      return;
+    set_int(node, result);
+  }
+  _folded++;
+}
+
+template<typename Compare>
+void til::constant_folder::fold_comparison(cdk::binary_operation_node *const node, int lvl,
+                                           Compare compare) {
+  node->left()->accept(this, lvl + 2);
+  node->right()->accept(this, lvl + 2);
+
+  auto left = value(node->left()), right = value(node->right());
+  if (left == nullptr || right == nullptr)
+    return;
+
+  if (left->is_double || right->is_double)
+    set_int(node, compare(left->as_double(), right->as_double()));
+  else
+    set_int(node, compare(left->i, right->i));
+  _folded++;
+}
+
+//---------------------------------------------------------------------------
+
+void til::constant_folder::do_add_node(cdk::add_node *const node, int lvl) {
+  fold_arithmetic(node, lvl,
+      [](int a, int b, int &r) { r = wrap(int64_t(a) + b); return true; },
+      [](double a, double b, double &r) { r = a + b; return true; });
+}
+
+void til::constant_folder::do_sub_node(cdk::sub_node *const node, int lvl) {
+  fold_arithmetic(node, lvl,
+      [](int a, int b, int &r) { r = wrap(int64_t(a) - b); return true; },
+      [](double a, double b, double &r) { r = a - b; return true; });
+}
+
+void til::constant_folder::do_mul_node(cdk::mul_node *const node, int lvl) {
+  fold_arithmetic(node, lvl,
+      [](int a, int b, int &r) { r = wrap(int64_t(a) * b); return true; },
+      [](double a, double b, double &r) { r = a * b; return true; });
+}
+
+// division by zero (and INT_MIN / -1) is left for the program to perform
+void til::constant_folder::do_div_node(cdk::div_node *const node, int lvl) {
+  fold_arithmetic(node, lvl,
+      [](int a, int b, int &r) { if (b == 0 || (a == INT_MIN && b == -1)) return false; r = a / b; return true; },
+      [](double a, double b, double &r) { if (b == 0) return false; r = a / b; return true; });
+}
+
+void til::constant_folder::do_mod_node(cdk::mod_node *const node, int lvl) {
+  fold_arithmetic(node, lvl,
+      [](int a, int b, int &r) { if (b == 0 || (a == INT_MIN && b == -1)) return false; r = a % b; return true; },
+      [](double a, double b, double &r) { return false; });
+}
+
+//---------------------------------------------------------------------------
+
+void til::constant_folder::do_lt_node(cdk::lt_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a < b; });
+}
+void til::constant_folder::do_le_node(cdk::le_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a <= b; });
+}
+void til::constant_folder::do_ge_node(cdk::ge_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a >= b; });
+}
+void til::constant_folder::do_gt_node(cdk::gt_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a > b; });
+}
+void til::constant_folder::do_ne_node(cdk::ne_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a != b; });
+}
+void til::constant_folder::do_eq_node(cdk::eq_node *const node, int lvl) {
+  fold_comparison(node, lvl, [](auto a, auto b) { return a == b; });
+}
+
+//---------------------------------------------------------------------------
+
+// "and" and "or" are short-circuited and yield 0 or 1: a constant left operand
+// that decides the result makes the node constant, whatever the right operand
+
+void til::constant_folder::do_and_node(cdk::and_node *const node, int lvl) {
+  tree_walker::do_and_node(node, lvl);
+  auto left = value(node->left()), right = value(node->right());
+  if (left == nullptr || left->is_double)
+    return;
+  if (left->i == 0)
+    set_int(node, 0);
+  else if (right != nullptr && !right->is_double)
+    set_int(node, right->i != 0);
+  else
+    return;
+  _folded++;
+}
+
+void til::constant_folder::do_or_node(cdk::or_node *const node, int lvl) {
+  tree_walker::do_or_node(node, lvl);
+  auto left = value(node->left()), right = value(node->right());
+  if (left == nullptr || left->is_double)
+    return;
+  if (left->i != 0)
+    set_int(node, 1);
+  else if (right != nullptr && !right->is_double)
+    set_int(node, right->i != 0);
+  else
+    return;
+  _folded++;
+}
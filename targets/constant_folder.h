@@ -0,0 +1,88 @@
+#ifndef __TIL_TARGETS_CONSTANT_FOLDER_H__
+#define __TIL_TARGETS_CONSTANT_FOLDER_H__
+
+#include "targets/tree_walker.h"
+
+#include <unordered_map>
+
+namespace til {
+
+  /**
+   * Value of a constant expression (int or double, as the node is typed).
+   */
+  struct constant {
+    bool is_double;
+    int i;
+    double d;
+
+    double as_double() const {
+      return is_double ? d : i;
+    }
+  };
+
+  /**
+   * Compute the value of every constant expression in the (typed) tree.
+   *
+   * Integer and double literals, sizeof, and the arithmetic, comparison and
+   * logical operators over them are constant. The tree is not changed: code
+   * generation asks for the value of a node and, if there is one, emits it as
+   * a single literal instead of the whole subtree.
+   */
+  class constant_folder: public tree_walker {
+    std::unordered_map<const cdk::expression_node *, constant> _values;
+    size_t _folded = 0; // operator nodes with a value
+
+  public:
+    constant_folder(std::shared_ptr<cdk::compiler> compiler) :
+        tree_walker(compiler) {
+    }
+
+  public:
+    /** The value of the node, or null if it is not a constant. */
+    const constant *value(const cdk::expression_node *node) const {
+      auto it = _values.find(node);
+      return it == _values.end() ? nullptr : &it->second;
+    }
+
+    size_t folded() const {
+      return _folded;
+    }
+
+  protected:
+    void set_int(const cdk::expression_node *node, int value);
+    void set_double(const cdk::expression_node *node, double value);
+
+    /** Fold an arithmetic operator (int or double, as the node is typed). */
+    template<typename IntOp, typename DoubleOp>
+    void fold_arithmetic(cdk::binary_operation_node *const node, int lvl, IntOp int_op, DoubleOp double_op);
+
+    /** Fold a comparison (as doubles, if either operand is a double). */
+    template<typename Compare>
+    void fold_comparison(cdk::binary_operation_node *const node, int lvl, Compare compare);
+
+  public:
+    void do_integer_node(cdk::integer_node *const node, int lvl);
+    void do_double_node(cdk::double_node *const node, int lvl);
+    void do_sizeof_node(til::sizeof_node *const node, int lvl);
+    void do_not_node(cdk::not_node *const node, int lvl);
+    void do_unary_minus_node(cdk::unary_minus_node *const node, int lvl);
+    void do_unary_plus_node(cdk::unary_plus_node *const node, int lvl);
+    void do_add_node(cdk::add_node *const node, int lvl);
+    void do_sub_node(cdk::sub_node *const node, int lvl);
+    void do_mul_node(cdk::mul_node *const node, int lvl);
+    void do_div_node(cdk::div_node *const node, int lvl);
+    void do_mod_node(cdk::mod_node *const node, int lvl);
+    void do_lt_node(cdk::lt_node *const node, int lvl);
+    void do_le_node(cdk::le_node *const node, int lvl);
+    void do_ge_node(cdk::ge_node *const node, int lvl);
+    void do_gt_node(cdk::gt_node *const node, int lvl);
+    void do_ne_node(cdk::ne_node *const node, int lvl);
+    void do_eq_node(cdk::eq_node *const node, int lvl);
+    void do_and_node(cdk::and_node *const node, int lvl);
+    void do_or_node(cdk::or_node *const node, int lvl);
+
+  };
+
+} // til
+
+#endif
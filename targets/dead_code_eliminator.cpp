@@ -0,0 +1,78 @@
+#include "targets/dead_code_eliminator.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+//---------------------------------------------------------------------------
+
+int til::dead_code_eliminator::condition_value(cdk::expression_node *condition) const {
+  auto value = _folder.value(condition);
+  if (value == nullptr)
+    return -1;
+  return value->i != 0;
+}
+
+cdk::basic_node *til::dead_code_eliminator::simplify(cdk::basic_node *node) {
+  while (node != nullptr) {
+    if (auto if_node = dynamic_cast<til::if_node *>(node)) {
+      int taken = condition_value(if_node->condition());
+      if (taken < 0)
+        return node;
+      _pruned++;
+      node = taken ? if_node->block() : nullptr;
+    } else if (auto if_else_node = dynamic_cast<til::if_else_node *>(node)) {
+      int taken = condition_value(if_else_node->condition());
+      if (taken < 0)
+        return node;
+      _pruned++;
+      node = taken ? if_else_node->thenblock() : if_else_node->elseblock();
+    } else if (auto loop_node = dynamic_cast<til::loop_node *>(node)) {
+      if (condition_value(loop_node->condition()) != 0)
+        return node; // unknown, or an endless loop (left by stop or return)
+      _pruned++;
+      return nullptr;
+    } else {
+      return node;
+    }
+  }
+  return nullptr;
+}
+
+bool til::dead_code_eliminator::always_leaves(cdk::basic_node *node) {
+  if (dynamic_cast<til::return_node *>(node) || dynamic_cast<til::stop_node *>(node) ||
+      dynamic_cast<til::next_node *>(node))
+    return true;
+
+  if (auto block = dynamic_cast<til::block_node *>(node)) {
+    auto instructions = block->instructions();
+    // sequences are already trimmed: only the last instruction may leave
+    return instructions != nullptr && instructions->size() > 0 &&
+           always_leaves(instructions->node(instructions->size() - 1));
+  }
+
+  if (auto if_else = dynamic_cast<til::if_else_node *>(node))
+    return always_leaves(if_else->thenblock()) && always_leaves(if_else->elseblock());
+
+  return false;
+}
+
+//---------------------------------------------------------------------------
+
+void til::dead_code_eliminator::do_sequence_node(cdk::sequence_node *const node, int lvl) {
+  auto &nodes = node->nodes();
+  size_t kept = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    cdk::basic_node *instruction = simplify(nodes[i]);
+    if (instruction == nullptr) {
+      _removed++;
+      continue;
+    }
+
+    instruction->accept(this, lvl + 2);
+    nodes[kept++] = instruction;
+
+    if (always_leaves(instruction)) {
+      _removed += nodes.size() - i - 1; // unreachable
+      break;
+    }
+  }
+  nodes.resize(kept);
+}
@@ -0,0 +1,54 @@
+#ifndef __TIL_TARGETS_DEAD_CODE_ELIMINATOR_H__
+#define __TIL_TARGETS_DEAD_CODE_ELIMINATOR_H__
+
+#include "targets/tree_walker.h"
+#include "targets/constant_folder.h"
+
+namespace til {
+
+  /**
+   * Remove instructions that can never execute.
+   *
+   * In every instruction sequence: whatever follows a return, stop or next
+   * (or an if-else, or block, that always ends in one) is dropped; an if or
+   * if-else with a constant condition is replaced by the arm that is taken;
+   * and a loop whose condition is constantly false is dropped. Conditions
+   * are known through the constant folder.
+   */
+  class dead_code_eliminator: public tree_walker {
+    const til::constant_folder &_folder;
+
+    size_t _removed = 0; // instructions dropped from sequences
+    size_t _pruned = 0;  // if, if-else and loop decided at compile time
+
+  public:
+    dead_code_eliminator(std::shared_ptr<cdk::compiler> compiler, const til::constant_folder &folder) :
+        tree_walker(compiler), _folder(folder) {
+    }
+
+  public:
+    size_t removed() const {
+      return _removed;
+    }
+    size_t pruned() const {
+      return _pruned;
+    }
+
+  protected:
+    /** The instruction to execute instead of the given one (null if none). */
+    cdk::basic_node *simplify(cdk::basic_node *node);
+
+    /** Whether control never reaches the end of the instruction. */
+    bool always_leaves(cdk::basic_node *node);
+
+    /** Constant value of a condition: 1 (true), 0 (false) or -1 (unknown). */
+    int condition_value(cdk::expression_node *condition) const;
+
+  public:
+    void do_sequence_node(cdk::sequence_node *const node, int lvl);
+
+  };
+
+} // til
+
+#endif
@@ -1,14 +1,28 @@
 #include "targets/frame_size_calculator.h"
 #include ".auto/all_nodes.h"
 #include "targets/symbol.h"
-#include "targets/type_checker.h"
+#include <algorithm>
 #include <string>
 
 til::frame_size_calculator::~frame_size_calculator() { os().flush(); }
 
+int til::frame_size_calculator::allocate(size_t size) {
+  _used += size;
+  if (size == 8)
+    _used = (_used + 7) & ~static_cast<size_t>(7);
+  _localsize = std::max(_localsize, _used);
+  return -static_cast<int>(_used); // locals go down from the frame pointer
+}
+
 void til::frame_size_calculator::do_loop_node(til::loop_node *const node,
                                               int lvl) {
+  size_t used = _used;
+  if (_invariants) {
+    for (auto expression : _invariants->hoisted(node))
+      _temporaries[expression] = allocate(til::loop_invariants::temporary_size(expression));
+  }
   node->instruction()->accept(this, lvl + 2);
+  _used = used; // the temporaries die with the loop
 }
 
 void til::frame_size_calculator::do_if_node(til::if_node *const node, int lvl) {
@@ -23,8 +37,7 @@ void til::frame_size_calculator::do_if_else_node(til::if_else_node *const node,
 
 void til::frame_size_calculator::do_declaration_node(
     til::declaration_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-  _localsize += node->type()->size();
+  _offsets[node] = allocate(node->type()->size());
 }
 
 void til::frame_size_calculator::do_sequence_node(
@@ -33,16 +46,19 @@ void til::frame_size_calculator::do_sequence_node(
     cdk::basic_node *n = node->node(i);
     if (n == nullptr)
       break;
+    _visits++;
     n->accept(this, lvl + 2);
   }
 }
 
 void til::frame_size_calculator::do_block_node(til::block_node *const node,
                                                int lvl) {
+  size_t used = _used;
   if (node->declarations())
     node->declarations()->accept(this, lvl + 2);
   if (node->instructions())
     node->instructions()->accept(this, lvl + 2);
+  _used = used; // the block's variables die here: reuse their slots
 }
 
 void til::frame_size_calculator::do_function_node(
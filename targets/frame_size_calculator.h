@@ -2,29 +2,55 @@
 #define __OG_TARGET_FRAME_SIZE_CALCULATOR_H__
 
 #include "targets/basic_ast_visitor.h"
+#include "targets/loop_invariants.h"
 
 #include <sstream>
 #include <stack>
+#include <unordered_map>
 
 namespace til {
 
+/**
+ * Compute the frame of a function and assign a slot to each local variable.
+ *
+ * Slots are allocated like a stack: a block's variables are released when
+ * the block ends, so disjoint scopes (sibling blocks, if/else arms, loop
+ * bodies) share the same stack space. The frame is as large as the deepest
+ * nesting of live variables. Doubles are kept 8-byte aligned.
+ *
+ * The temporaries of the expressions hoisted out of a loop (see
+ * loop_invariants) live while the loop runs.
+ */
 class frame_size_calculator : public basic_ast_visitor {
-  cdk::symbol_table<til::symbol> &_symtab;
+  til::symbol_table &_symtab;
   std::shared_ptr<til::symbol> _function;
 
   size_t _localsize;
+  size_t _used = 0; // bytes of the variables currently in scope
+  std::unordered_map<const til::declaration_node *, int> _offsets;
+  const til::loop_invariants *_invariants;
+  std::unordered_map<const cdk::typed_node *, int> _temporaries;
+  size_t _visits = 0; // sequence items visited
 
 public:
   frame_size_calculator(std::shared_ptr<cdk::compiler> compiler,
-                        cdk::symbol_table<til::symbol> &symtab)
+                        til::symbol_table &symtab,
+                        const til::loop_invariants *invariants = nullptr)
       : basic_ast_visitor(compiler), _symtab(symtab),
-        _localsize(0) {}
+        _localsize(0), _invariants(invariants) {}
 
 public:
   ~frame_size_calculator();
 
 public:
   size_t localsize() const { return _localsize; }
+  const std::unordered_map<const til::declaration_node *, int> &offsets() const { return _offsets; }
+  const std::unordered_map<const cdk::typed_node *, int> &temporaries() const { return _temporaries; }
+  size_t visits() const { return _visits; }
+
+private:
+  /** Take the next slot of the given size (8-byte slots are aligned). */
+  int allocate(size_t size);
 
 public:
   // do not edit these lines
@@ -0,0 +1,84 @@
+#include "targets/front_end.h"
+#include "targets/type_checker.h"
+#include "targets/dead_code_eliminator.h"
+#include "targets/ir_builder.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
+#include "string_table.h"
+
+#include <iostream>
+
+//---------------------------------------------------------------------------
+
+bool til::front_end::analyse() {
+  // annotate the whole tree with types (once) before code generation
+  til::symbol_table symtab;
+  type_checker checker(_compiler, symtab);
+  {
+    til::scoped_pass pass("type check");
+    _compiler->ast()->accept(&checker, 0);
+    pass.visits(checker.visits());
+  }
+  if (_compiler->debug()) {
+    til::node_arena::of(_compiler.get()).report(std::cerr);
+    til::string_table::instance().report(std::cerr);
+    std::cerr << "type checker: " << checker.visits() << " visits, "
+              << checker.checked() << " nodes checked" << std::endl;
+  }
+  if (checker.errors() > 0)
+    return false;
+
+  // compute constant expressions (emitted as literals)
+  {
+    til::scoped_pass pass("constant folding");
+    _compiler->ast()->accept(&_folder, 0);
+  }
+  if (_compiler->debug()) {
+    std::cerr << "constant folder: " << _folder.folded() << " expressions folded" << std::endl;
+  }
+
+  // drop unreachable instructions and branches decided by constants
+  dead_code_eliminator eliminator(_compiler, _folder);
+  {
+    til::scoped_pass pass("dead code");
+    _compiler->ast()->accept(&eliminator, 0);
+  }
+  if (_compiler->debug()) {
+    std::cerr << "dead code: " << eliminator.removed() << " instructions removed, "
+              << eliminator.pruned() << " branches decided" << std::endl;
+  }
+
+  // find the calls that can be direct
+  {
+    til::scoped_pass pass("call resolution");
+    _resolver.resolve(_compiler->ast());
+  }
+  if (_compiler->debug()) {
+    std::cerr << "call resolver: " << _resolver.resolved() << " direct calls" << std::endl;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+std::unique_ptr<til::ir::module> til::front_end::build_ir(size_t pointer_size) {
+  auto module = std::make_unique<ir::module>();
+  module->pointer_size = pointer_size;
+  ir_builder builder(_compiler, *module, _folder, _resolver);
+  try {
+    til::scoped_pass pass("ir construction");
+    builder.build(_compiler->ast());
+    pass.visits(builder.visits());
+  } catch (const std::string &problem) {
+    std::cerr << "error: " << problem << std::endl;
+    return nullptr;
+  }
+
+  auto problems = ir::verify(*module);
+  if (!problems.empty()) {
+    for (auto &problem : problems)
+      std::cerr << "ir: " << problem << std::endl;
+    return nullptr;
+  }
+  return module;
+}
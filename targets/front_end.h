@@ -0,0 +1,47 @@
+#ifndef __TIL_TARGETS_FRONT_END_H__
+#define __TIL_TARGETS_FRONT_END_H__
+
+#include "targets/constant_folder.h"
+#include "targets/call_resolver.h"
+#include "targets/ir.h"
+
+#include <memory>
+#include <cdk/compiler.h>
+
+namespace til {
+
+  /**
+   * The passes shared by the targets, before code generation: type checking,
+   * constant folding, dead code elimination and call resolution over the
+   * syntax tree; then, for the targets that generate code from it, the
+   * construction and verification of the intermediate representation. Each
+   * pass is timed (see pass_report) and, in debug mode, reports its work.
+   */
+  class front_end {
+    std::shared_ptr<cdk::compiler> _compiler;
+    constant_folder _folder;
+    call_resolver _resolver;
+
+  public:
+    front_end(std::shared_ptr<cdk::compiler> compiler) :
+        _compiler(compiler), _folder(compiler), _resolver(compiler) {
+    }
+
+  public:
+    /** Check, fold and prune the tree and resolve its calls (false on type errors). */
+    bool analyse();
+
+    /** The verified IR of the analysed tree (null, the problems printed, if there is none). */
+    std::unique_ptr<ir::module> build_ir(size_t pointer_size);
+
+    const constant_folder &folder() const {
+      return _folder;
+    }
+    const call_resolver &resolver() const {
+      return _resolver;
+    }
+  };
+
+} // til
+
+#endif
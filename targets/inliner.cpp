@@ -0,0 +1,214 @@
+#include "targets/inliner.h"
+#include "targets/frame_size_calculator.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+#include "interned_nodes.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  /** Size the callee, check what it uses and collect its free names. */
+  class callee_scanner: public til::tree_walker {
+    std::vector<std::unordered_set<const std::string *>> _scopes; // interned names
+    std::unordered_set<const std::string *> _free;
+
+  public:
+    size_t size = 0;
+    bool simple = true;
+    std::vector<const std::string *> free_names;
+
+    callee_scanner(std::shared_ptr<cdk::compiler> compiler) :
+        til::tree_walker(compiler) {
+    }
+
+    void scan(til::function_node *const node) {
+      _scopes.emplace_back();
+      walk(node->arguments(), 0);
+      walk(node->block(), 0);
+      _scopes.pop_back();
+    }
+
+  protected:
+    void count() {
+      size++;
+    }
+
+  public:
+    void do_sequence_node(cdk::sequence_node *const node, int lvl) {
+      count();
+      tree_walker::do_sequence_node(node, lvl);
+    }
+    void do_block_node(til::block_node *const node, int lvl) {
+      count();
+      _scopes.emplace_back();
+      tree_walker::do_block_node(node, lvl);
+      _scopes.pop_back();
+    }
+    void do_declaration_node(til::declaration_node *const node, int lvl) {
+      count();
+      tree_walker::do_declaration_node(node, lvl);
+      _scopes.back().insert(node->identifier_handle());
+    }
+    void do_variable_node(cdk::variable_node *const node, int lvl) {
+      count();
+      auto name = til::handle_of(node);
+      for (auto &scope : _scopes)
+        if (scope.count(name) > 0)
+          return;
+      if (_free.insert(name).second)
+        free_names.push_back(name);
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      simple = false; // nested function
+    }
+    void do_stack_alloc_node(til::stack_alloc_node *const node, int lvl) {
+      simple = false; // would grow the caller's frame on every expansion
+    }
+    void do_function_call_node(til::function_call_node *const node, int lvl) {
+      count();
+      if (node->func() == nullptr)
+        simple = false; // "@"
+      tree_walker::do_function_call_node(node, lvl);
+    }
+
+#define COUNTED(type, name) \
+    void do_##name(type *const node, int lvl) { count(); tree_walker::do_##name(node, lvl); }
+    COUNTED(cdk::integer_node, integer_node) COUNTED(cdk::double_node, double_node)
+    COUNTED(cdk::string_node, string_node) COUNTED(til::nullptr_node, nullptr_node)
+    COUNTED(til::read_node, read_node) COUNTED(til::stop_node, stop_node)
+    COUNTED(til::next_node, next_node) COUNTED(cdk::not_node, not_node)
+    COUNTED(cdk::unary_minus_node, unary_minus_node) COUNTED(cdk::unary_plus_node, unary_plus_node)
+    COUNTED(til::sizeof_node, sizeof_node) COUNTED(cdk::add_node, add_node)
+    COUNTED(cdk::sub_node, sub_node) COUNTED(cdk::mul_node, mul_node)
+    COUNTED(cdk::div_node, div_node) COUNTED(cdk::mod_node, mod_node)
+    COUNTED(cdk::lt_node, lt_node) COUNTED(cdk::le_node, le_node)
+    COUNTED(cdk::ge_node, ge_node) COUNTED(cdk::gt_node, gt_node)
+    COUNTED(cdk::ne_node, ne_node) COUNTED(cdk::eq_node, eq_node)
+    COUNTED(cdk::and_node, and_node) COUNTED(cdk::or_node, or_node)
+    COUNTED(cdk::rvalue_node, rvalue_node) COUNTED(cdk::assignment_node, assignment_node)
+    COUNTED(til::index_node, index_node) COUNTED(til::address_of_node, address_of_node)
+    COUNTED(til::return_node, return_node) COUNTED(til::evaluation_node, evaluation_node)
+    COUNTED(til::print_node, print_node) COUNTED(til::loop_node, loop_node)
+    COUNTED(til::if_node, if_node) COUNTED(til::if_else_node, if_else_node)
+#undef COUNTED
+  };
+
+  /** Collect the calls of a body, except those in nested functions. */
+  class call_collector: public til::tree_walker {
+  public:
+    std::vector<til::function_call_node *> calls;
+
+    call_collector(std::shared_ptr<cdk::compiler> compiler) :
+        til::tree_walker(compiler) {
+    }
+
+    void do_function_node(til::function_node *const node, int lvl) {
+      // another frame
+    }
+    void do_function_call_node(til::function_call_node *const node, int lvl) {
+      calls.push_back(node);
+      tree_walker::do_function_call_node(node, lvl);
+    }
+  };
+
+}
+
+//---------------------------------------------------------------------------
+
+til::inliner::inliner(std::shared_ptr<cdk::compiler> compiler, const til::call_resolver &resolver,
+                      const til::loop_invariants &invariants) :
+    _compiler(compiler), _resolver(resolver), _invariants(invariants), _limit(30) {
+  if (const char *limit = std::getenv("TIL_INLINE_LIMIT"))
+    _limit = std::strtoul(limit, nullptr, 10);
+}
+
+til::function_node *til::inliner::candidate(til::function_call_node *call) {
+  auto known = _candidates.find(call);
+  if (known != _candidates.end())
+    return known->second;
+
+  til::function_node *function = nullptr;
+  if (_limit > 0 && call->func() != nullptr) {
+    auto target = _resolver.target(call);
+    if (target != nullptr && target->function != nullptr) {
+      auto &callee = info(target->function);
+      if (callee.eligible && !callee.in_progress)
+        function = target->function;
+    }
+  }
+
+  // decided once: frame sizes and code generation must agree
+  _candidates[call] = function;
+  return function;
+}
+
+const til::inliner::callee &til::inliner::info(til::function_node *function) {
+  auto known = _callees.find(function);
+  if (known != _callees.end())
+    return known->second;
+
+  auto &callee = _callees[function];
+  callee_scanner scanner(_compiler);
+  scanner.scan(function);
+  callee.size = scanner.size;
+  callee.free_names = scanner.free_names;
+  callee.eligible = scanner.simple && scanner.size <= _limit;
+  if (!callee.eligible)
+    return callee;
+
+  // parameters are laid out like locals, at the top of the inline area
+  for (size_t i = 0; i < function->arguments()->size(); i++) {
+    auto param = dynamic_cast<cdk::typed_node *>(function->arguments()->node(i));
+    size_t size = param->type()->size();
+    callee.params += size;
+    if (size == 8)
+      callee.params = (callee.params + 7) & ~static_cast<size_t>(7);
+    callee.param_offsets.push_back(-static_cast<int>(callee.params));
+  }
+
+  callee.in_progress = true;
+  callee.inline_area = inline_area(function->block());
+  callee.in_progress = false;
+  return callee;
+}
+
+size_t til::inliner::inline_area(cdk::basic_node *body) {
+  call_collector collector(_compiler);
+  body->accept(&collector, 0);
+
+  size_t area = 0;
+  for (auto call : collector.calls)
+    if (auto function = candidate(call)) {
+      auto &callee = info(function);
+      area = std::max(area, callee.params + frame(function).size + callee.inline_area);
+    }
+  return area;
+}
+
+const til::inliner::frame_layout &til::inliner::frame(til::function_node *function) {
+  auto known = _frames.find(function);
+  if (known != _frames.end())
+    return known->second;
+
+  til::symbol_table symtab; // not used by the calculator
+  frame_size_calculator fsc(_compiler, symtab, &_invariants);
+  function->block()->accept(&fsc, 0);
+  auto &layout = _frames[function];
+  layout.size = fsc.localsize();
+  layout.offsets = fsc.offsets();
+  layout.temporaries = fsc.temporaries();
+  return layout;
+}
+
+void til::inliner::report(std::ostream &os) const {
+  os << "inliner: " << _inlined.size() << " call sites inlined (limit " << _limit << " nodes)" << std::endl;
+  for (auto &site : _inlined) {
+    auto known = _callees.find(site.second);
+    os << "  line " << site.first->lineno() << ": callee of line " << site.second->lineno() << " ("
+       << (known == _callees.end() ? 0 : known->second.size) << " nodes)" << std::endl;
+  }
+}
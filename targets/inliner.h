@@ -0,0 +1,88 @@
+#ifndef __TIL_TARGETS_INLINER_H__
+#define __TIL_TARGETS_INLINER_H__
+
+#include "targets/call_resolver.h"
+#include "targets/loop_invariants.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Decide which calls are expanded in place, and how much frame they need.
+   *
+   * A call is inlined if its callee is a known function literal (see
+   * call_resolver) of at most TIL_INLINE_LIMIT nodes (default 30; 0 turns
+   * inlining off) that does not call "@", define functions or allocate stack
+   * objects, and is not (mutually) recursive with the caller. The expanded
+   * callee uses an area at the bottom of the caller's frame: its parameters,
+   * then its own frame.
+   *
+   * The frame of each function is computed here, once, and used both where
+   * the function is generated and where it is expanded.
+   */
+  class inliner {
+  public:
+    /** Layout of a function's body (with the temporaries of its loops). */
+    struct frame_layout {
+      size_t size = 0; // bytes
+      std::unordered_map<const til::declaration_node *, int> offsets;
+      std::unordered_map<const cdk::typed_node *, int> temporaries;
+    };
+
+    struct callee {
+      bool eligible = false;
+      bool in_progress = false;     // frame being computed (recursion)
+      size_t size = 0;              // syntax tree nodes
+      std::vector<const std::string *> free_names; // globals used by the callee (interned)
+      std::vector<int> param_offsets; // relative to the inline area
+      size_t params = 0;            // bytes of the parameters
+      size_t inline_area = 0;       // bytes for the callee's own inlined calls
+    };
+
+  private:
+    std::shared_ptr<cdk::compiler> _compiler;
+    const til::call_resolver &_resolver;
+    const til::loop_invariants &_invariants;
+    size_t _limit;
+
+    std::unordered_map<const til::function_node *, frame_layout> _frames;
+    std::unordered_map<const til::function_node *, callee> _callees;
+    std::unordered_map<const til::function_call_node *, til::function_node *> _candidates;
+    std::vector<std::pair<const til::function_call_node *, const til::function_node *>> _inlined;
+
+  public:
+    inliner(std::shared_ptr<cdk::compiler> compiler, const til::call_resolver &resolver,
+            const til::loop_invariants &invariants);
+
+  public:
+    /** The function to expand at the call site (null if the call is kept). */
+    til::function_node *candidate(til::function_call_node *call);
+
+    /** What the callee needs to be expanded. */
+    const callee &info(til::function_node *function);
+
+    /** The frame of a function's body. */
+    const frame_layout &frame(til::function_node *function);
+
+    /** Frame bytes needed by the calls expanded in the body (not in nested functions). */
+    size_t inline_area(cdk::basic_node *body);
+
+    /** Record an expansion (for the report). */
+    void inlined(const til::function_call_node *call, const til::function_node *function) {
+      _inlined.emplace_back(call, function);
+    }
+
+    size_t count() const {
+      return _inlined.size();
+    }
+
+    void report(std::ostream &os) const;
+  };
+
+} // til
+
+#endif
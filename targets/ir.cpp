@@ -0,0 +1,569 @@
+#include "targets/ir.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+//---------------------------------------------------------------------------
+
+size_t til::ir::size_of(ir::type type, size_t pointer_size) {
+  switch (type) {
+    case type::VOID: return 0;
+    case type::DOUBLE: return 8;
+    case type::PTR: return pointer_size;
+    default: return 4;
+  }
+}
+
+const char *til::ir::name_of(ir::type type) {
+  switch (type) {
+    case type::VOID: return "void";
+    case type::INT: return "int";
+    case type::DOUBLE: return "double";
+    case type::PTR: return "ptr";
+  }
+  return "?";
+}
+
+const char *til::ir::name_of(ir::opcode op) {
+  switch (op) {
+#define TIL_IR_NAME(op) case opcode::op: return #op;
+    TIL_IR_OPCODES(TIL_IR_NAME)
+#undef TIL_IR_NAME
+  }
+  return "?";
+}
+
+bool til::ir::is_terminator(ir::opcode op) {
+  return op == opcode::JMP || op == opcode::BR || op == opcode::RET;
+}
+
+bool til::ir::has_side_effects(ir::opcode op) {
+  switch (op) {
+    case opcode::STORE: case opcode::CALL: case opcode::CALLI: case opcode::ALLOCA:
+    case opcode::JMP: case opcode::BR: case opcode::RET:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+til::ir::instruction *til::ir::block::terminator() const {
+  if (code.empty() || !is_terminator(code.back()->op))
+    return nullptr;
+  return code.back().get();
+}
+
+std::vector<til::ir::block *> til::ir::block::successors() const {
+  auto last = terminator();
+  return last == nullptr ? std::vector<block *>() : last->blocks;
+}
+
+void til::ir::function::renumber() {
+  int id = 0;
+  for (auto &b : blocks)
+    for (auto &instr : b->code)
+      instr->id = instr->type == type::VOID ? -1 : id++;
+}
+
+void til::ir::function::replace_uses(instruction *from, instruction *to) {
+  for (auto &b : blocks)
+    for (auto &instr : b->code)
+      std::replace(instr->args.begin(), instr->args.end(), from, to);
+}
+
+std::vector<til::ir::block *> til::ir::function::reverse_postorder() const {
+  std::vector<block *> order;
+  std::unordered_set<block *> seen;
+  if (blocks.empty())
+    return order;
+  // iterative depth-first search (programs may nest deeply)
+  std::vector<std::pair<block *, size_t>> stack { { blocks[0].get(), 0 } };
+  seen.insert(blocks[0].get());
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    auto succs = top.first->successors();
+    if (top.second < succs.size()) {
+      auto next = succs[succs.size() - ++top.second]; // the first successor is laid out next
+      if (seen.insert(next).second)
+        stack.emplace_back(next, 0);
+    } else {
+      order.push_back(top.first);
+      stack.pop_back();
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+void til::ir::function::remove_unreachable() {
+  auto order = reverse_postorder();
+  std::unordered_set<block *> live(order.begin(), order.end());
+
+  for (auto &b : blocks) {
+    if (live.count(b.get()) == 0)
+      continue;
+    // forget the dead predecessors (and what PHIs receive from them)
+    for (size_t p = b->preds.size(); p-- > 0;) {
+      if (live.count(b->preds[p]) > 0)
+        continue;
+      for (auto &instr : b->code) {
+        if (instr->op != opcode::PHI)
+          break;
+        instr->args.erase(instr->args.begin() + p);
+        instr->blocks.erase(instr->blocks.begin() + p);
+      }
+      b->preds.erase(b->preds.begin() + p);
+    }
+  }
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<block> &b) {
+    return live.count(b.get()) == 0;
+  }), blocks.end());
+}
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  std::string value_name(const til::ir::instruction *value) {
+    return value == nullptr ? "null" : "%" + std::to_string(value->id);
+  }
+
+  std::string quoted(const std::string &text) {
+    std::ostringstream oss;
+    oss << '"';
+    for (unsigned char c : text) {
+      if (c == '"' || c == '\\')
+        oss << '\\' << c;
+      else if (c < 32 || c >= 127)
+        oss << '\\' << std::hex << (c >> 4) << (c & 15) << std::dec;
+      else
+        oss << c;
+    }
+    oss << '"';
+    return oss.str();
+  }
+
+}
+
+void til::ir::print(std::ostream &os, const module &m) {
+  for (auto &name : m.externals)
+    os << "extern @" << name << std::endl;
+  for (auto &g : m.globals) {
+    os << (g.exported ? "public " : "") << "global @" << g.name << " : " << name_of(g.type);
+    switch (g.kind) {
+      case global::init::ZERO: break;
+      case global::init::INT: os << " = " << g.i; break;
+      case global::init::DOUBLE: os << " = " << g.d; break;
+      case global::init::STRING: os << " = " << quoted(g.s); break;
+      case global::init::SYMBOL: os << " = @" << g.s; break;
+    }
+    os << std::endl;
+  }
+
+  for (auto &f : m.functions) {
+    f->renumber();
+    os << std::endl << (f->exported ? "public " : "") << "function @" << f->name << "(";
+    for (size_t i = 0; i < f->params.size(); i++)
+      os << (i > 0 ? ", " : "") << name_of(f->params[i]);
+    os << ") : " << name_of(f->result) << " {" << std::endl;
+
+    for (auto &b : f->blocks) {
+      os << "b" << b->id << ":";
+      if (!b->preds.empty()) {
+        os << "  ; preds";
+        for (auto pred : b->preds)
+          os << " b" << pred->id;
+      }
+      os << std::endl;
+
+      for (auto &instr : b->code) {
+        os << "  ";
+        if (instr->type != type::VOID)
+          os << value_name(instr.get()) << " = ";
+        std::string op = name_of(instr->op);
+        std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+        os << op;
+        if (instr->type != type::VOID)
+          os << " " << name_of(instr->type);
+
+        switch (instr->op) {
+          case opcode::CONST: case opcode::PARAM: case opcode::SLOT: os << " " << instr->i; break;
+          case opcode::DCONST: os << " " << instr->d; break;
+          case opcode::STRING: os << " " << quoted(instr->s); break;
+          case opcode::SYMBOL: case opcode::CALL: os << " @" << instr->s; break;
+          default: break;
+        }
+
+        if (instr->op == opcode::PHI) {
+          for (size_t i = 0; i < instr->args.size(); i++)
+            os << (i > 0 ? ", " : " ") << "[" << value_name(instr->args[i]) << ", b" << instr->blocks[i]->id << "]";
+        } else {
+          for (size_t i = 0; i < instr->args.size(); i++)
+            os << (i > 0 ? ", " : " ") << value_name(instr->args[i]);
+          for (size_t i = 0; i < instr->blocks.size(); i++)
+            os << (i > 0 || !instr->args.empty() ? ", " : " ") << "b" << instr->blocks[i]->id;
+        }
+        os << std::endl;
+      }
+    }
+    os << "}" << std::endl;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+std::map<std::string, til::ir::external> til::ir::externals_of(const module &m) {
+  std::map<std::string, external> externals;
+  std::set<std::string> called;
+  for (auto &name : m.externals)
+    externals[name] = { false, { ir::type::VOID, {} } };
+  auto external = [&](const ir::instruction *value) {
+    return value->op == ir::opcode::SYMBOL && externals.count(value->s) > 0;
+  };
+
+  for (auto &f : m.functions)
+    for (auto &b : f->blocks)
+      for (auto &instr : b->code) {
+        const ir::instruction *address = nullptr;
+        if (instr->op == ir::opcode::LOAD || instr->op == ir::opcode::PTRADD)
+          address = instr->args[0];
+        else if (instr->op == ir::opcode::STORE)
+          address = instr->args[1];
+        if (address != nullptr && external(address))
+          externals[address->s].memory = true;
+
+        if (instr->op == ir::opcode::CALL && externals.count(instr->s) > 0 && called.insert(instr->s).second) {
+          auto &types = externals[instr->s].types;
+          types.result = instr->type;
+          for (auto arg : instr->args)
+            types.params.push_back(arg->type);
+        }
+      }
+  return externals;
+}
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  using namespace til::ir;
+
+  /** Checks of one function (errors are appended to a list). */
+  class function_verifier {
+    const function &_f;
+    size_t _pointer_size;
+    std::vector<std::string> &_errors;
+
+    std::unordered_map<const block *, size_t> _position; // in reverse post-order
+    std::unordered_map<const block *, const block *> _idom;
+
+  public:
+    function_verifier(const function &f, size_t pointer_size, std::vector<std::string> &errors) :
+        _f(f), _pointer_size(pointer_size), _errors(errors) {
+    }
+
+    void run() {
+      if (_f.blocks.empty()) {
+        error(nullptr, nullptr, "no blocks");
+        return;
+      }
+      std::unordered_set<const instruction *> defined;
+      for (auto &b : _f.blocks)
+        for (auto &instr : b->code)
+          defined.insert(instr.get());
+
+      check_edges();
+      dominators();
+      for (auto &b : _f.blocks) {
+        bool phis = true;
+        for (size_t k = 0; k < b->code.size(); k++) {
+          auto instr = b->code[k].get();
+          if (instr->parent != b.get())
+            error(b.get(), instr, "wrong parent block");
+          if (instr->op != opcode::PHI)
+            phis = false;
+          else if (!phis)
+            error(b.get(), instr, "PHI after other instructions");
+          if (is_terminator(instr->op) != (k + 1 == b->code.size()))
+            error(b.get(), instr, "terminators must end blocks (and only them)");
+          for (auto arg : instr->args) {
+            if (arg == nullptr || defined.count(arg) == 0)
+              error(b.get(), instr, "operand not defined in the function");
+            else if (arg->type == type::VOID)
+              error(b.get(), instr, "operand without a value");
+          }
+          check_types(b.get(), instr);
+          check_dominance(b.get(), k, defined);
+        }
+      }
+    }
+
+  private:
+    void error(const block *b, const instruction *instr, const std::string &message) {
+      std::ostringstream oss;
+      oss << "@" << _f.name;
+      if (b != nullptr)
+        oss << ", b" << b->id;
+      if (instr != nullptr)
+        oss << ", " << name_of(instr->op);
+      oss << ": " << message;
+      _errors.push_back(oss.str());
+    }
+
+    void check_edges() {
+      std::unordered_map<const block *, std::vector<const block *>> preds;
+      for (auto &b : _f.blocks)
+        for (auto succ : b->successors())
+          preds[succ].push_back(b.get());
+      for (auto &b : _f.blocks) {
+        auto expected = preds[b.get()];
+        std::vector<const block *> actual(b->preds.begin(), b->preds.end());
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        if (expected != actual)
+          error(b.get(), nullptr, "predecessors do not match the terminators");
+        for (auto &instr : b->code)
+          if (instr->op == opcode::PHI &&
+              (instr->args.size() != b->preds.size() || instr->blocks != b->preds))
+            error(b.get(), instr.get(), "PHI does not have one value per predecessor");
+      }
+    }
+
+    // Cooper, Harvey and Kennedy's iterative algorithm
+    void dominators() {
+      auto order = _f.reverse_postorder();
+      for (size_t i = 0; i < order.size(); i++)
+        _position[order[i]] = i;
+      if (order.size() != _f.blocks.size())
+        error(nullptr, nullptr, "unreachable blocks");
+
+      _idom[order[0]] = order[0];
+      for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); i++) {
+          const block *idom = nullptr;
+          for (auto pred : order[i]->preds) {
+            if (_idom.count(pred) == 0)
+              continue;
+            idom = idom == nullptr ? pred : intersect(pred, idom);
+          }
+          if (idom != nullptr && _idom[order[i]] != idom) {
+            _idom[order[i]] = idom;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    const block *intersect(const block *a, const block *b) {
+      while (a != b) {
+        while (_position.at(a) > _position.at(b))
+          a = _idom.at(a);
+        while (_position.at(b) > _position.at(a))
+          b = _idom.at(b);
+      }
+      return a;
+    }
+
+    bool dominates(const block *a, const block *b) {
+      if (_idom.count(b) == 0)
+        return true; // unreachable: already reported
+      while (b != a) {
+        auto up = _idom.at(b);
+        if (up == b)
+          return false;
+        b = up;
+      }
+      return true;
+    }
+
+    void check_dominance(const block *b, size_t k, const std::unordered_set<const instruction *> &defined) {
+      auto instr = b->code[k].get();
+      for (size_t a = 0; a < instr->args.size(); a++) {
+        auto arg = instr->args[a];
+        if (arg == nullptr || defined.count(arg) == 0)
+          continue;
+        if (instr->op == opcode::PHI) {
+          // used at the end of the predecessor
+          if (a < instr->blocks.size() && !dominates(arg->parent, instr->blocks[a]))
+            error(b, instr, "definition does not dominate its use");
+        } else if (arg->parent == b) {
+          bool before = false;
+          for (size_t j = 0; j < k && !before; j++)
+            before = b->code[j].get() == arg;
+          if (!before)
+            error(b, instr, "operand used before its definition");
+        } else if (!dominates(arg->parent, b)) {
+          error(b, instr, "definition does not dominate its use");
+        }
+      }
+    }
+
+    void check_types(const block *b, const instruction *instr) {
+      auto arity = [&](size_t n) {
+        if (instr->args.size() != n)
+          error(b, instr, "expected " + std::to_string(n) + " operands");
+        return instr->args.size() == n;
+      };
+      auto expect = [&](type actual, type expected, const char *what) {
+        if (actual != expected)
+          error(b, instr, std::string(what) + " should be " + name_of(expected) + ", not " + name_of(actual));
+      };
+      auto integral = [](type t) {
+        return t == type::INT || t == type::PTR;
+      };
+      auto fits = [&](type t, const instruction *address) {
+        if (address->op == opcode::SLOT && size_of(t, _pointer_size) > static_cast<size_t>(address->i))
+          error(b, instr, std::string(name_of(t)) + " does not fit in a slot of " +
+                              std::to_string(address->i) + " bytes");
+      };
+
+      switch (instr->op) {
+        case opcode::CONST:
+          if (!integral(instr->type))
+            error(b, instr, "constant should be int or ptr");
+          arity(0);
+          break;
+        case opcode::DCONST: expect(instr->type, type::DOUBLE, "result"); arity(0); break;
+        case opcode::STRING: case opcode::SYMBOL: case opcode::SLOT:
+          expect(instr->type, type::PTR, "result");
+          arity(0);
+          break;
+        case opcode::PARAM:
+          if (instr->i < 0 || (size_t)instr->i >= _f.params.size())
+            error(b, instr, "no such parameter");
+          else
+            expect(instr->type, _f.params[instr->i], "result");
+          break;
+        case opcode::UNDEF: arity(0); break;
+        case opcode::ADD: case opcode::SUB: case opcode::MUL: case opcode::DIV: case opcode::MOD:
+          expect(instr->type, type::INT, "result");
+          if (arity(2)) {
+            expect(instr->args[0]->type, type::INT, "operand");
+            expect(instr->args[1]->type, type::INT, "operand");
+          }
+          break;
+        case opcode::NEG:
+          expect(instr->type, type::INT, "result");
+          if (arity(1))
+            expect(instr->args[0]->type, type::INT, "operand");
+          break;
+        case opcode::DADD: case opcode::DSUB: case opcode::DMUL: case opcode::DDIV:
+          expect(instr->type, type::DOUBLE, "result");
+          if (arity(2)) {
+            expect(instr->args[0]->type, type::DOUBLE, "operand");
+            expect(instr->args[1]->type, type::DOUBLE, "operand");
+          }
+          break;
+        case opcode::DNEG:
+          expect(instr->type, type::DOUBLE, "result");
+          if (arity(1))
+            expect(instr->args[0]->type, type::DOUBLE, "operand");
+          break;
+        case opcode::I2D:
+          expect(instr->type, type::DOUBLE, "result");
+          if (arity(1))
+            expect(instr->args[0]->type, type::INT, "operand");
+          break;
+        case opcode::EQ: case opcode::NE: case opcode::LT: case opcode::LE: case opcode::GT: case opcode::GE:
+          expect(instr->type, type::INT, "result");
+          if (arity(2) && (!integral(instr->args[0]->type) || !integral(instr->args[1]->type)))
+            error(b, instr, "operands should be int or ptr");
+          break;
+        case opcode::DEQ: case opcode::DNE: case opcode::DLT: case opcode::DLE: case opcode::DGT: case opcode::DGE:
+          expect(instr->type, type::INT, "result");
+          if (arity(2)) {
+            expect(instr->args[0]->type, type::DOUBLE, "operand");
+            expect(instr->args[1]->type, type::DOUBLE, "operand");
+          }
+          break;
+        case opcode::PTRADD:
+          expect(instr->type, type::PTR, "result");
+          if (arity(2)) {
+            expect(instr->args[0]->type, type::PTR, "address");
+            expect(instr->args[1]->type, type::INT, "offset");
+          }
+          break;
+        case opcode::PTRDIFF:
+          expect(instr->type, type::INT, "result");
+          if (arity(2)) {
+            expect(instr->args[0]->type, type::PTR, "operand");
+            expect(instr->args[1]->type, type::PTR, "operand");
+          }
+          break;
+        case opcode::ALLOCA:
+          expect(instr->type, type::PTR, "result");
+          if (arity(1))
+            expect(instr->args[0]->type, type::INT, "size");
+          break;
+        case opcode::LOAD:
+          if (instr->type == type::VOID)
+            error(b, instr, "load without a type");
+          if (arity(1)) {
+            expect(instr->args[0]->type, type::PTR, "address");
+            fits(instr->type, instr->args[0]);
+          }
+          break;
+        case opcode::STORE:
+          expect(instr->type, type::VOID, "result");
+          if (arity(2)) {
+            expect(instr->args[1]->type, type::PTR, "address");
+            fits(instr->args[0]->type, instr->args[1]);
+          }
+          break;
+        case opcode::CALL:
+          if (instr->s.empty())
+            error(b, instr, "call without a callee");
+          break;
+        case opcode::CALLI:
+          if (instr->args.empty())
+            error(b, instr, "call without a callee");
+          else
+            expect(instr->args[0]->type, type::PTR, "callee");
+          break;
+        case opcode::PHI:
+          for (auto arg : instr->args)
+            if (arg != nullptr && arg->type != instr->type)
+              error(b, instr, "PHI values should have the PHI's type");
+          break;
+        case opcode::JMP:
+          arity(0);
+          if (instr->blocks.size() != 1)
+            error(b, instr, "expected one target");
+          break;
+        case opcode::BR:
+          if (arity(1) && !integral(instr->args[0]->type))
+            error(b, instr, "condition should be int or ptr");
+          if (instr->blocks.size() != 2)
+            error(b, instr, "expected two targets");
+          break;
+        case opcode::RET:
+          if (_f.result == type::VOID)
+            arity(0);
+          else if (arity(1))
+            expect(instr->args[0]->type, _f.result, "returned value");
+          break;
+      }
+    }
+  };
+
+}
+
+std::vector<std::string> til::ir::verify(const module &m) {
+  std::vector<std::string> errors;
+  std::unordered_set<std::string> names;
+  for (auto &g : m.globals)
+    if (!names.insert(g.name).second)
+      errors.push_back("@" + g.name + ": defined twice");
+  for (auto &f : m.functions) {
+    if (!names.insert(f->name).second)
+      errors.push_back("@" + f->name + ": defined twice");
+    function_verifier(*f, m.pointer_size, errors).run();
+  }
+  return errors;
+}
@@ -0,0 +1,186 @@
+#ifndef __TIL_TARGETS_IR_H__
+#define __TIL_TARGETS_IR_H__
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// opcodes of the intermediate representation
+#define TIL_IR_OPCODES(X) \
+  X(CONST) X(DCONST) X(STRING) X(SYMBOL) X(PARAM) X(UNDEF) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(NEG) \
+  X(DADD) X(DSUB) X(DMUL) X(DDIV) X(DNEG) X(I2D) \
+  X(EQ) X(NE) X(LT) X(LE) X(GT) X(GE) \
+  X(DEQ) X(DNE) X(DLT) X(DLE) X(DGT) X(DGE) \
+  X(PTRADD) X(PTRDIFF) \
+  X(SLOT) X(ALLOCA) X(LOAD) X(STORE) \
+  X(CALL) X(CALLI) X(PHI) \
+  X(JMP) X(BR) X(RET)
+
+namespace til {
+
+  /**
+   * Typed intermediate representation in static single assignment form.
+   *
+   * A module has globals and functions; a function is a list of basic
+   * blocks (the first is the entry), each ending with one terminator (JMP,
+   * BR or RET). Every instruction is a value, defined once. Local variables
+   * are values too, joined by PHI instructions where control flow meets;
+   * only variables whose address is taken live in frame slots (SLOT), read
+   * and written with LOAD and STORE.
+   *
+   * Operands and immediates, by opcode:
+   *   CONST i, DCONST d        constants (INT or PTR, DOUBLE)
+   *   STRING s                 address of a string literal
+   *   SYMBOL s                 address of a global variable or function
+   *   PARAM i                  value of the i-th argument
+   *   UNDEF                    any value (variable read before written)
+   *   ADD..NEG, DADD..DNEG     arithmetic (INT, DOUBLE)
+   *   I2D a                    integer to double
+   *   EQ..GE a b, DEQ..DGE a b comparisons of INT/PTR or DOUBLE (INT 0 or 1)
+   *   PTRADD p n, PTRDIFF p q  address plus/minus bytes
+   *   SLOT i                   address of i bytes in the frame
+   *   ALLOCA n                 address of n bytes allocated in the frame
+   *   LOAD p, STORE v p        memory access (the type is the value's)
+   *   CALL s args, CALLI f args  call of the function named s or at f
+   *   PHI args                 one value per predecessor (blocks, in order)
+   *   JMP, BR c, RET [v]       terminators (BR: blocks[0] if c != 0)
+   */
+  namespace ir {
+
+    /** Types of values (PTR is an address, of module::pointer_size bytes). */
+    enum class type {
+      VOID, INT, DOUBLE, PTR
+    };
+
+    enum class opcode {
+#define TIL_IR_OPCODE(op) op,
+      TIL_IR_OPCODES(TIL_IR_OPCODE)
+#undef TIL_IR_OPCODE
+    };
+
+    struct block;
+
+    struct instruction {
+      ir::opcode op;
+      ir::type type;                   // of the result (VOID if none)
+      std::vector<instruction *> args; // operands
+      std::vector<block *> blocks;     // JMP and BR targets; PHI predecessors
+      int i = 0;                       // CONST, PARAM, SLOT
+      double d = 0;                    // DCONST
+      std::string s;                   // STRING, SYMBOL, CALL
+      block *parent = nullptr;
+      int id = -1;                     // value number (see function::renumber)
+
+      instruction(ir::opcode op, ir::type type) :
+          op(op), type(type) {
+      }
+    };
+
+    struct block {
+      int id;
+      std::vector<std::unique_ptr<instruction>> code;
+      std::vector<block *> preds;
+
+      block(int id) :
+          id(id) {
+      }
+
+      /** The last instruction if it is a terminator, else null. */
+      instruction *terminator() const;
+      std::vector<block *> successors() const;
+    };
+
+    struct function {
+      std::string name;
+      ir::type result;
+      std::vector<ir::type> params;
+      bool exported = false;
+      std::vector<std::unique_ptr<block>> blocks;
+      int next_block = 0;
+
+      function(const std::string &name, ir::type result) :
+          name(name), result(result) {
+      }
+
+      block *add_block() {
+        blocks.push_back(std::make_unique<block>(next_block++));
+        return blocks.back().get();
+      }
+
+      /** Number the values in block order (for printing). */
+      void renumber();
+
+      /** Replace every use of a value (the value itself is kept). */
+      void replace_uses(instruction *from, instruction *to);
+
+      /** Drop the blocks that cannot be reached from the entry. */
+      void remove_unreachable();
+
+      /** Blocks in reverse post-order from the entry (a block's first successor follows it if it can). */
+      std::vector<block *> reverse_postorder() const;
+    };
+
+    /** A global variable and its initial value. */
+    struct global {
+      enum class init {
+        ZERO, INT, DOUBLE, STRING, SYMBOL
+      };
+
+      std::string name;
+      ir::type type;
+      init kind = init::ZERO;
+      int i = 0;
+      double d = 0;
+      std::string s; // STRING text or SYMBOL name
+      bool exported = false;
+    };
+
+    struct module {
+      std::vector<global> globals;
+      std::vector<std::unique_ptr<function>> functions;
+      std::set<std::string> externals; // called or used, defined elsewhere
+      size_t pointer_size = 4;         // in memory (offsets and sizes are in bytes)
+    };
+
+    /** Result and parameter types of a function. */
+    struct signature {
+      ir::type result;
+      std::vector<ir::type> params;
+    };
+
+    /** How a module uses a name defined elsewhere. */
+    struct external {
+      bool memory = false; // read or written through (data)
+      signature types;     // of its first call (VOID() if never called)
+    };
+
+    /**
+     * The externals of a module: functions get the types of their first call;
+     * symbols read or written through are data.
+     */
+    std::map<std::string, external> externals_of(const module &m);
+
+    /** Bytes of a value in memory (PTR has the module's pointer_size). */
+    size_t size_of(ir::type type, size_t pointer_size);
+    const char *name_of(ir::type type);
+    const char *name_of(ir::opcode op);
+    bool is_terminator(ir::opcode op);
+
+    /** Whether the instruction must run even if its value is unused. */
+    bool has_side_effects(ir::opcode op);
+
+    /** Write the module in a readable form. */
+    void print(std::ostream &os, const module &m);
+
+    /** Check the structure, types and dominance of definitions (empty if well formed). */
+    std::vector<std::string> verify(const module &m);
+
+  } // ir
+
+} // til
+
+#endif
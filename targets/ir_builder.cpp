@@ -0,0 +1,800 @@
+#include "targets/ir_builder.h"
+#include "targets/tree_walker.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+#include <algorithm>
+
+#include "til_parser.tab.h"
+#include "type_table.h"
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  /** Names of the variables whose address is taken (not in nested functions). */
+  class address_taken: public til::tree_walker {
+  public:
+    std::unordered_set<std::string> &names;
+
+    address_taken(std::shared_ptr<cdk::compiler> compiler, std::unordered_set<std::string> &names) :
+        til::tree_walker(compiler), names(names) {
+    }
+
+    void do_address_of_node(til::address_of_node *const node, int lvl) {
+      if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue()))
+        names.insert(variable->name());
+      tree_walker::do_address_of_node(node, lvl);
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      // another function
+    }
+  };
+
+  std::string error_at(cdk::basic_node *const node, const std::string &message) {
+    return std::to_string(node->lineno()) + ": " + message;
+  }
+
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::build(cdk::basic_node *root) {
+  root->accept(this, 0);
+  for (auto &name : _referenced)
+    if (_defined.count(name) == 0)
+      _module.externals.insert(name);
+}
+
+til::ir::type til::ir_builder::type_of(std::shared_ptr<cdk::basic_type> type) {
+  switch (type->name()) {
+    case cdk::TYPE_INT: return ir::type::INT;
+    case cdk::TYPE_DOUBLE: return ir::type::DOUBLE;
+    case cdk::TYPE_VOID: return ir::type::VOID;
+    default: return ir::type::PTR; // strings, pointers and functions
+  }
+}
+
+size_t til::ir_builder::size_of(std::shared_ptr<cdk::basic_type> type) const {
+  switch (type->name()) {
+    case cdk::TYPE_POINTER:
+    case cdk::TYPE_STRING:
+    case cdk::TYPE_FUNCTIONAL:
+      return _module.pointer_size;
+    default:
+      return type->size();
+  }
+}
+
+const std::string &til::ir_builder::function_name(const til::function_node *node) {
+  auto it = _function_names.find(node);
+  if (it == _function_names.end())
+    it = _function_names.emplace(node, "_F" + std::to_string(_function_names.size() + 1)).first;
+  return it->second;
+}
+
+til::ir::instruction *til::ir_builder::emit(ir::opcode op, ir::type type, std::vector<ir::instruction *> args) {
+  auto instr = std::make_unique<ir::instruction>(op, type);
+  instr->args = std::move(args);
+  instr->parent = _fn->current;
+  _fn->current->code.push_back(std::move(instr));
+  return _fn->current->code.back().get();
+}
+
+til::ir::instruction *til::ir_builder::constant(int value, ir::type type) {
+  auto instr = emit(ir::opcode::CONST, type);
+  instr->i = value;
+  return instr;
+}
+
+til::ir::instruction *til::ir_builder::value(cdk::expression_node *node) {
+  _value = nullptr;
+  node->accept(this, 0);
+  if (_value == nullptr)
+    throw error_at(node, "expression without a value");
+  return _value;
+}
+
+til::ir::instruction *til::ir_builder::convert(ir::instruction *value, std::shared_ptr<cdk::basic_type> type) {
+  if (type->name() == cdk::TYPE_DOUBLE && value->type == ir::type::INT)
+    return emit(ir::opcode::I2D, ir::type::DOUBLE, { value });
+  return value;
+}
+
+til::ir::instruction *til::ir_builder::scaled(ir::instruction *value, size_t size) {
+  if (size <= 1)
+    return value;
+  return emit(ir::opcode::MUL, ir::type::INT, { value, constant(size) });
+}
+
+til::ir::instruction *til::ir_builder::address(cdk::lvalue_node *node) {
+  if (auto variable = dynamic_cast<cdk::variable_node *>(node)) {
+    if (auto local = find(variable->name())) {
+      if (local->slot == nullptr)
+        throw error_at(node, "'" + variable->name() + "' has no address");
+      return local->slot;
+    }
+    _referenced.insert(variable->name());
+    auto symbol = emit(ir::opcode::SYMBOL, ir::type::PTR);
+    symbol->s = variable->name();
+    return symbol;
+  }
+  if (auto index = dynamic_cast<til::index_node *>(node)) {
+    auto base = value(index->base());
+    auto offset = scaled(value(index->index()), size_of(index->type()));
+    return emit(ir::opcode::PTRADD, ir::type::PTR, { base, offset });
+  }
+  throw error_at(node, "unknown lvalue");
+}
+
+//---------------------------------------------------------------------------
+
+til::ir::block *til::ir_builder::new_block() {
+  return _fn->function->add_block();
+}
+
+void til::ir_builder::enter(ir::block *block) {
+  _fn->current = block;
+}
+
+void til::ir_builder::leave() {
+  auto dead = new_block(); // removed when the function is complete
+  seal(dead);
+  enter(dead);
+}
+
+void til::ir_builder::jump(ir::block *target) {
+  auto jmp = emit(ir::opcode::JMP, ir::type::VOID);
+  jmp->blocks = { target };
+  target->preds.push_back(_fn->current);
+}
+
+void til::ir_builder::branch(ir::instruction *condition, ir::block *if_true, ir::block *if_false) {
+  if (if_true == if_false) {
+    jump(if_true);
+    return;
+  }
+  auto br = emit(ir::opcode::BR, ir::type::VOID, { condition });
+  br->blocks = { if_true, if_false };
+  if_true->preds.push_back(_fn->current);
+  if_false->preds.push_back(_fn->current);
+}
+
+// conditions jump directly: "and", "or" and "not" need no values
+void til::ir_builder::branch_on(cdk::expression_node *condition, ir::block *if_true, ir::block *if_false) {
+  if (auto negation = dynamic_cast<cdk::not_node *>(condition)) {
+    branch_on(negation->argument(), if_false, if_true);
+  } else if (auto conjunction = dynamic_cast<cdk::and_node *>(condition)) {
+    auto right = new_block();
+    branch_on(conjunction->left(), right, if_false);
+    seal(right);
+    enter(right);
+    branch_on(conjunction->right(), if_true, if_false);
+  } else if (auto disjunction = dynamic_cast<cdk::or_node *>(condition)) {
+    auto right = new_block();
+    branch_on(disjunction->left(), if_true, right);
+    seal(right);
+    enter(right);
+    branch_on(disjunction->right(), if_true, if_false);
+  } else {
+    auto test = value(condition);
+    if (test->type == ir::type::DOUBLE) {
+      auto zero = emit(ir::opcode::DCONST, ir::type::DOUBLE);
+      test = emit(ir::opcode::DNE, ir::type::INT, { test, zero });
+    }
+    branch(test, if_true, if_false);
+  }
+}
+
+void til::ir_builder::seal(ir::block *block) {
+  auto pending = _fn->incomplete.find(block);
+  if (pending != _fn->incomplete.end()) {
+    auto phis = std::move(pending->second);
+    _fn->incomplete.erase(pending);
+    for (auto &phi : phis)
+      add_phi_operands(phi.first, phi.second);
+  }
+  _fn->sealed.insert(block);
+}
+
+//---------------------------------------------------------------------------
+
+const til::ir_builder::variable *til::ir_builder::find(const std::string &name) const {
+  for (auto scope = _fn->scopes.rbegin(); scope != _fn->scopes.rend(); ++scope) {
+    auto it = scope->find(name);
+    if (it != scope->end())
+      return &it->second;
+  }
+  return nullptr; // global
+}
+
+void til::ir_builder::declare(const std::string &name, std::shared_ptr<cdk::basic_type> type,
+                              ir::instruction *initial) {
+  variable local;
+  local.type = type_of(type);
+  if (_fn->addressed.count(name) > 0) {
+    // frame slots are allocated on entry
+    auto entry = _fn->function->blocks[0].get();
+    auto slot = std::make_unique<ir::instruction>(ir::opcode::SLOT, ir::type::PTR);
+    slot->i = size_of(type);
+    slot->parent = entry;
+    local.slot = slot.get();
+    entry->code.insert(entry->code.begin(), std::move(slot));
+    if (initial != nullptr)
+      emit(ir::opcode::STORE, ir::type::VOID, { initial, local.slot });
+  } else {
+    local.id = _fn->types.size();
+    _fn->types.push_back(local.type);
+    if (initial == nullptr)
+      initial = read_variable(local.id, _fn->function->blocks[0].get()); // undefined
+    write_variable(local.id, _fn->current, initial);
+  }
+  _fn->scopes.back()[name] = local;
+}
+
+void til::ir_builder::write_variable(int id, ir::block *block, ir::instruction *value) {
+  _fn->definitions[id][block] = value;
+}
+
+til::ir::instruction *til::ir_builder::read_variable(int id, ir::block *block) {
+  auto &definitions = _fn->definitions[id];
+  auto it = definitions.find(block);
+  if (it != definitions.end())
+    return it->second;
+
+  ir::instruction *value;
+  if (_fn->sealed.count(block) == 0) {
+    value = new_phi(id, block);
+    _fn->incomplete[block].emplace_back(id, value);
+  } else if (block->preds.size() == 1) {
+    value = read_variable(id, block->preds[0]);
+  } else if (block->preds.empty()) {
+    // not written on any path: undefined, from the entry
+    auto entry = _fn->function->blocks[0].get();
+    auto undef = std::make_unique<ir::instruction>(ir::opcode::UNDEF, _fn->types[id]);
+    undef->parent = entry;
+    value = undef.get();
+    entry->code.insert(entry->code.begin(), std::move(undef));
+  } else {
+    value = new_phi(id, block);
+    write_variable(id, block, value); // breaks cycles through loops
+    add_phi_operands(id, value);
+  }
+  write_variable(id, block, value);
+  return value;
+}
+
+til::ir::instruction *til::ir_builder::new_phi(int id, ir::block *block) {
+  auto phi = std::make_unique<ir::instruction>(ir::opcode::PHI, _fn->types[id]);
+  phi->parent = block;
+  auto result = phi.get();
+  block->code.insert(block->code.begin(), std::move(phi));
+  return result;
+}
+
+void til::ir_builder::add_phi_operands(int id, ir::instruction *phi) {
+  for (auto pred : phi->parent->preds) {
+    auto incoming = read_variable(id, pred);
+    phi->args.push_back(incoming);
+    phi->blocks.push_back(pred);
+  }
+}
+
+// PHIs whose operands are all the same value (or the PHI itself) are that value
+void til::ir_builder::remove_trivial_phis(ir::function *function) {
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto &b : function->blocks) {
+      for (size_t k = 0; k < b->code.size() && b->code[k]->op == ir::opcode::PHI;) {
+        auto phi = b->code[k].get();
+        ir::instruction *same = nullptr;
+        bool trivial = true;
+        for (auto arg : phi->args) {
+          if (arg == phi || arg == same)
+            continue;
+          if (same != nullptr) {
+            trivial = false;
+            break;
+          }
+          same = arg;
+        }
+        if (!trivial) {
+          k++;
+          continue;
+        }
+        if (same == nullptr) {
+          // only reads itself: undefined
+          phi->op = ir::opcode::UNDEF;
+          phi->args.clear();
+          phi->blocks.clear();
+          auto undef = std::move(b->code[k]);
+          b->code.erase(b->code.begin() + k);
+          auto entry = function->blocks[0].get();
+          undef->parent = entry;
+          entry->code.insert(entry->code.begin(), std::move(undef));
+        } else {
+          function->replace_uses(phi, same);
+          b->code.erase(b->code.begin() + k);
+        }
+        changed = true;
+      }
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::build_function(const std::string &name, std::shared_ptr<cdk::functional_type> type,
+                                     cdk::sequence_node *arguments, til::block_node *body, bool exported) {
+  auto owned = std::make_unique<ir::function>(name, type_of(type->output(0)));
+  auto function = owned.get();
+  function->exported = exported;
+  for (size_t i = 0; i < arguments->size(); i++)
+    function->params.push_back(type_of(dynamic_cast<cdk::typed_node *>(arguments->node(i))->type()));
+  _module.functions.push_back(std::move(owned));
+  _defined.insert(name);
+
+  auto state = std::make_unique<function_state>();
+  state->function = function;
+  state->type = type;
+  address_taken addresses(_compiler, state->addressed);
+  arguments->accept(&addresses, 0);
+  body->accept(&addresses, 0);
+  _functions.push_back(std::move(state));
+  _fn = _functions.back().get();
+
+  auto entry = new_block();
+  seal(entry);
+  enter(entry);
+  _fn->scopes.emplace_back();
+  for (size_t i = 0; i < arguments->size(); i++) {
+    auto argument = dynamic_cast<til::declaration_node *>(arguments->node(i));
+    auto param = emit(ir::opcode::PARAM, function->params[i]);
+    param->i = i;
+    declare(argument->identifier(), argument->type(), param);
+  }
+
+  body->accept(this, 0);
+
+  // falling off the end returns (zero)
+  if (_fn->current->terminator() == nullptr) {
+    if (function->result == ir::type::VOID) {
+      emit(ir::opcode::RET, ir::type::VOID);
+    } else if (function->result == ir::type::DOUBLE) {
+      emit(ir::opcode::RET, ir::type::VOID, { emit(ir::opcode::DCONST, ir::type::DOUBLE) });
+    } else {
+      emit(ir::opcode::RET, ir::type::VOID, { constant(0, function->result) });
+    }
+  }
+
+  function->remove_unreachable();
+  remove_trivial_phis(function);
+
+  _functions.pop_back();
+  _fn = _functions.empty() ? nullptr : _functions.back().get();
+}
+
+til::ir::instruction *til::ir_builder::comparison(cdk::binary_operation_node *const node, ir::opcode int_op,
+                                             ir::opcode double_op) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  if (left->type == ir::type::DOUBLE || right->type == ir::type::DOUBLE) {
+    left = convert(left, node->left()->is_typed(cdk::TYPE_INT) ? node->right()->type() : node->left()->type());
+    right = convert(right, node->right()->is_typed(cdk::TYPE_INT) ? node->left()->type() : node->right()->type());
+    return emit(double_op, ir::type::INT, { left, right });
+  }
+  return emit(int_op, ir::type::INT, { left, right });
+}
+
+// "and" and "or" as values: 1 or 0, joined by a PHI
+til::ir::instruction *til::ir_builder::logical_value(cdk::expression_node *const node) {
+  auto if_true = new_block(), if_false = new_block(), join = new_block();
+  branch_on(node, if_true, if_false);
+  seal(if_true);
+  seal(if_false);
+
+  enter(if_true);
+  auto one = constant(1);
+  jump(join);
+  enter(if_false);
+  auto zero = constant(0);
+  jump(join);
+  seal(join);
+  enter(join);
+
+  auto phi = emit(ir::opcode::PHI, ir::type::INT, { one, zero });
+  phi->blocks = { if_true, if_false };
+  return phi;
+}
+
+void til::ir_builder::call_runtime(const std::string &name, ir::type type, std::vector<ir::instruction *> args) {
+  auto call = emit(ir::opcode::CALL, type, std::move(args));
+  call->s = name;
+  _referenced.insert(name);
+  _value = call;
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::do_nil_node(cdk::nil_node *const node, int lvl) {
+  // EMPTY
+}
+void til::ir_builder::do_data_node(cdk::data_node *const node, int lvl) {
+  // EMPTY
+}
+
+void til::ir_builder::do_sequence_node(cdk::sequence_node *const node, int lvl) {
+  for (size_t i = 0; i < node->size(); i++) {
+    _visits++;
+    node->node(i)->accept(this, lvl);
+  }
+}
+
+void til::ir_builder::do_integer_node(cdk::integer_node *const node, int lvl) {
+  _value = constant(node->value());
+}
+
+void til::ir_builder::do_double_node(cdk::double_node *const node, int lvl) {
+  _value = emit(ir::opcode::DCONST, ir::type::DOUBLE);
+  _value->d = node->value();
+}
+
+void til::ir_builder::do_string_node(cdk::string_node *const node, int lvl) {
+  _value = emit(ir::opcode::STRING, ir::type::PTR);
+  _value->s = node->value();
+}
+
+void til::ir_builder::do_nullptr_node(til::nullptr_node *const node, int lvl) {
+  _value = constant(0, ir::type::PTR);
+}
+
+void til::ir_builder::do_sizeof_node(til::sizeof_node *const node, int lvl) {
+  _value = constant(size_of(node->argument()->type())); // not evaluated
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::do_not_node(cdk::not_node *const node, int lvl) {
+  auto argument = value(node->argument());
+  if (argument->type == ir::type::DOUBLE)
+    _value = emit(ir::opcode::DEQ, ir::type::INT, { argument, emit(ir::opcode::DCONST, ir::type::DOUBLE) });
+  else
+    _value = emit(ir::opcode::EQ, ir::type::INT, { argument, constant(0, argument->type) });
+}
+
+void til::ir_builder::do_and_node(cdk::and_node *const node, int lvl) {
+  _value = logical_value(node);
+}
+
+void til::ir_builder::do_or_node(cdk::or_node *const node, int lvl) {
+  _value = logical_value(node);
+}
+
+void til::ir_builder::do_unary_minus_node(cdk::unary_minus_node *const node, int lvl) {
+  auto argument = value(node->argument());
+  if (argument->type == ir::type::DOUBLE)
+    _value = emit(ir::opcode::DNEG, ir::type::DOUBLE, { argument });
+  else
+    _value = emit(ir::opcode::NEG, ir::type::INT, { argument });
+}
+
+void til::ir_builder::do_unary_plus_node(cdk::unary_plus_node *const node, int lvl) {
+  _value = value(node->argument());
+}
+
+void til::ir_builder::do_add_node(cdk::add_node *const node, int lvl) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  if (node->is_typed(cdk::TYPE_DOUBLE)) {
+    _value = emit(ir::opcode::DADD, ir::type::DOUBLE,
+                  { convert(left, node->type()), convert(right, node->type()) });
+  } else if (node->is_typed(cdk::TYPE_POINTER)) {
+    auto referenced = cdk::reference_type::cast(node->type())->referenced();
+    if (left->type == ir::type::PTR)
+      _value = emit(ir::opcode::PTRADD, ir::type::PTR, { left, scaled(right, size_of(referenced)) });
+    else
+      _value = emit(ir::opcode::PTRADD, ir::type::PTR, { right, scaled(left, size_of(referenced)) });
+  } else {
+    _value = emit(ir::opcode::ADD, ir::type::INT, { left, right });
+  }
+}
+
+void til::ir_builder::do_sub_node(cdk::sub_node *const node, int lvl) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  if (node->is_typed(cdk::TYPE_DOUBLE)) {
+    _value = emit(ir::opcode::DSUB, ir::type::DOUBLE,
+                  { convert(left, node->type()), convert(right, node->type()) });
+  } else if (left->type == ir::type::PTR && right->type == ir::type::PTR) {
+    // elements between the addresses
+    auto referenced = cdk::reference_type::cast(node->left()->type())->referenced();
+    _value = emit(ir::opcode::PTRDIFF, ir::type::INT, { left, right });
+    if (referenced->name() != cdk::TYPE_VOID && size_of(referenced) > 1)
+      _value = emit(ir::opcode::DIV, ir::type::INT, { _value, constant(size_of(referenced)) });
+  } else if (left->type == ir::type::PTR) {
+    auto referenced = cdk::reference_type::cast(node->left()->type())->referenced();
+    auto offset = emit(ir::opcode::NEG, ir::type::INT, { scaled(right, size_of(referenced)) });
+    _value = emit(ir::opcode::PTRADD, ir::type::PTR, { left, offset });
+  } else {
+    _value = emit(ir::opcode::SUB, ir::type::INT, { left, right });
+  }
+}
+
+void til::ir_builder::do_mul_node(cdk::mul_node *const node, int lvl) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  if (node->is_typed(cdk::TYPE_DOUBLE))
+    _value = emit(ir::opcode::DMUL, ir::type::DOUBLE, { convert(left, node->type()), convert(right, node->type()) });
+  else
+    _value = emit(ir::opcode::MUL, ir::type::INT, { left, right });
+}
+
+void til::ir_builder::do_div_node(cdk::div_node *const node, int lvl) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  if (node->is_typed(cdk::TYPE_DOUBLE))
+    _value = emit(ir::opcode::DDIV, ir::type::DOUBLE, { convert(left, node->type()), convert(right, node->type()) });
+  else
+    _value = emit(ir::opcode::DIV, ir::type::INT, { left, right });
+}
+
+void til::ir_builder::do_mod_node(cdk::mod_node *const node, int lvl) {
+  auto left = value(node->left());
+  auto right = value(node->right());
+  _value = emit(ir::opcode::MOD, ir::type::INT, { left, right });
+}
+
+void til::ir_builder::do_lt_node(cdk::lt_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::LT, ir::opcode::DLT);
+}
+void til::ir_builder::do_le_node(cdk::le_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::LE, ir::opcode::DLE);
+}
+void til::ir_builder::do_ge_node(cdk::ge_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::GE, ir::opcode::DGE);
+}
+void til::ir_builder::do_gt_node(cdk::gt_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::GT, ir::opcode::DGT);
+}
+void til::ir_builder::do_ne_node(cdk::ne_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::NE, ir::opcode::DNE);
+}
+void til::ir_builder::do_eq_node(cdk::eq_node *const node, int lvl) {
+  _value = comparison(node, ir::opcode::EQ, ir::opcode::DEQ);
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::do_variable_node(cdk::variable_node *const node, int lvl) {
+  _value = address(node);
+}
+
+void til::ir_builder::do_index_node(til::index_node *const node, int lvl) {
+  _value = address(node);
+}
+
+void til::ir_builder::do_address_of_node(til::address_of_node *const node, int lvl) {
+  _value = address(node->lvalue());
+}
+
+void til::ir_builder::do_rvalue_node(cdk::rvalue_node *const node, int lvl) {
+  if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue())) {
+    auto local = find(variable->name());
+    if (local != nullptr && local->slot == nullptr) {
+      _value = read_variable(local->id, _fn->current);
+      return;
+    }
+    if (local == nullptr && _externs.count(variable->name()) > 0) {
+      _value = address(variable); // an external function is its address
+      return;
+    }
+  }
+  _value = emit(ir::opcode::LOAD, type_of(node->type()), { address(node->lvalue()) });
+}
+
+void til::ir_builder::do_assignment_node(cdk::assignment_node *const node, int lvl) {
+  auto rvalue = convert(value(node->rvalue()), node->lvalue()->type());
+  if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue())) {
+    auto local = find(variable->name());
+    if (local != nullptr && local->slot == nullptr) {
+      write_variable(local->id, _fn->current, rvalue);
+      _value = rvalue;
+      return;
+    }
+  }
+  emit(ir::opcode::STORE, ir::type::VOID, { rvalue, address(node->lvalue()) });
+  _value = rvalue;
+}
+
+void til::ir_builder::do_stack_alloc_node(til::stack_alloc_node *const node, int lvl) {
+  auto referenced = cdk::reference_type::cast(node->type())->referenced();
+  auto count = value(node->argument());
+  _value = emit(ir::opcode::ALLOCA, ir::type::PTR, { scaled(count, size_of(referenced)) });
+}
+
+void til::ir_builder::do_read_node(til::read_node *const node, int lvl) {
+  if (node->is_typed(cdk::TYPE_DOUBLE))
+    call_runtime("readd", ir::type::DOUBLE, {});
+  else
+    call_runtime("readi", ir::type::INT, {});
+}
+
+void til::ir_builder::do_function_call_node(til::function_call_node *const node, int lvl) {
+  auto type = node->func() ? cdk::functional_type::cast(node->func()->type()) : _fn->type;
+
+  // arguments are evaluated last to first (as by the postfix writer)
+  std::vector<ir::instruction *> args(node->arguments()->size());
+  for (size_t i = args.size(); i-- > 0;) {
+    auto arg = dynamic_cast<cdk::expression_node *>(node->arguments()->node(i));
+    args[i] = convert(value(arg), type->input(i));
+  }
+
+  auto result = type_of(type->output(0));
+  if (!node->func()) {
+    call_runtime(_fn->function->name, result, args); // "@"
+  } else if (auto target = _resolver.target(node)) {
+    call_runtime(target->function ? function_name(target->function) : target->external, result, args);
+  } else {
+    args.insert(args.begin(), value(node->func()));
+    _value = emit(ir::opcode::CALLI, result, args);
+  }
+}
+
+void til::ir_builder::do_function_node(til::function_node *const node, int lvl) {
+  auto &name = function_name(node);
+  build_function(name, cdk::functional_type::cast(node->type()), node->arguments(), node->block(), false);
+  if (_fn != nullptr) {
+    _value = emit(ir::opcode::SYMBOL, ir::type::PTR);
+    _value->s = name;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::do_evaluation_node(til::evaluation_node *const node, int lvl) {
+  node->argument()->accept(this, lvl);
+}
+
+void til::ir_builder::do_print_node(til::print_node *const node, int lvl) {
+  for (auto arg : node->arguments()->nodes()) {
+    auto expression = dynamic_cast<cdk::expression_node *>(arg);
+    auto printed = value(expression);
+    if (expression->is_typed(cdk::TYPE_INT))
+      call_runtime("printi", ir::type::VOID, { printed });
+    else if (expression->is_typed(cdk::TYPE_DOUBLE))
+      call_runtime("printd", ir::type::VOID, { printed });
+    else if (expression->is_typed(cdk::TYPE_STRING))
+      call_runtime("prints", ir::type::VOID, { printed });
+  }
+  if (node->newline())
+    call_runtime("println", ir::type::VOID, {});
+}
+
+void til::ir_builder::do_return_node(til::return_node *const node, int lvl) {
+  auto output = _fn->type->output(0);
+  if (node->ret_val() != nullptr && output->name() != cdk::TYPE_VOID)
+    emit(ir::opcode::RET, ir::type::VOID, { convert(value(node->ret_val()), output) });
+  else
+    emit(ir::opcode::RET, ir::type::VOID);
+  leave();
+}
+
+void til::ir_builder::do_if_node(til::if_node *const node, int lvl) {
+  auto then_block = new_block(), join = new_block();
+  branch_on(node->condition(), then_block, join);
+  seal(then_block);
+  enter(then_block);
+  node->block()->accept(this, lvl + 2);
+  jump(join);
+  seal(join);
+  enter(join);
+}
+
+void til::ir_builder::do_if_else_node(til::if_else_node *const node, int lvl) {
+  auto then_block = new_block(), else_block = new_block(), join = new_block();
+  branch_on(node->condition(), then_block, else_block);
+  seal(then_block);
+  seal(else_block);
+  enter(then_block);
+  node->thenblock()->accept(this, lvl + 2);
+  jump(join);
+  enter(else_block);
+  node->elseblock()->accept(this, lvl + 2);
+  jump(join);
+  seal(join);
+  enter(join);
+}
+
+void til::ir_builder::do_loop_node(til::loop_node *const node, int lvl) {
+  auto header = new_block(), body = new_block(), exit = new_block();
+  jump(header);
+  enter(header); // sealed when the body (and its "next"s) are known
+  branch_on(node->condition(), body, exit);
+  seal(body);
+
+  enter(body);
+  _fn->loops.emplace_back(header, exit);
+  node->instruction()->accept(this, lvl + 2);
+  _fn->loops.pop_back();
+  jump(header);
+
+  seal(header);
+  seal(exit);
+  enter(exit);
+}
+
+void til::ir_builder::do_stop_node(til::stop_node *const node, int lvl) {
+  if (node->level() < 1 || (size_t)node->level() > _fn->loops.size())
+    throw error_at(node, "invalid stop level " + std::to_string(node->level()));
+  jump(_fn->loops[_fn->loops.size() - node->level()].second);
+  leave();
+}
+
+void til::ir_builder::do_next_node(til::next_node *const node, int lvl) {
+  if (node->level() < 1 || (size_t)node->level() > _fn->loops.size())
+    throw error_at(node, "invalid next level " + std::to_string(node->level()));
+  jump(_fn->loops[_fn->loops.size() - node->level()].first);
+  leave();
+}
+
+void til::ir_builder::do_block_node(til::block_node *const node, int lvl) {
+  _fn->scopes.emplace_back();
+  node->declarations()->accept(this, lvl + 2);
+  node->instructions()->accept(this, lvl + 2);
+  _fn->scopes.pop_back();
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_builder::do_declaration_node(til::declaration_node *const node, int lvl) {
+  if (_fn != nullptr) {
+    ir::instruction *initial = nullptr;
+    if (node->initializer() != nullptr)
+      initial = convert(value(node->initializer()), node->type());
+    declare(node->identifier(), node->type(), initial);
+    return;
+  }
+
+  // globals
+  if (node->qualifier() == tEXTERNAL) {
+    _externs.insert(node->identifier());
+    return;
+  }
+  if (node->qualifier() == tFORWARD)
+    return; // defined later, or elsewhere
+
+  ir::global g;
+  g.name = node->identifier();
+  g.type = type_of(node->type());
+  g.exported = node->qualifier() == tPUBLIC;
+  if (auto initializer = node->initializer()) {
+    if (auto folded = _folder.value(initializer)) {
+      if (node->is_typed(cdk::TYPE_DOUBLE)) {
+        g.kind = ir::global::init::DOUBLE;
+        g.d = folded->as_double();
+      } else {
+        g.kind = ir::global::init::INT;
+        g.i = folded->i;
+      }
+    } else if (auto text = dynamic_cast<cdk::string_node *>(initializer)) {
+      g.kind = ir::global::init::STRING;
+      g.s = text->value();
+    } else if (dynamic_cast<til::nullptr_node *>(initializer)) {
+      g.kind = ir::global::init::INT;
+    } else if (auto function = dynamic_cast<til::function_node *>(initializer)) {
+      function->accept(this, lvl);
+      g.kind = ir::global::init::SYMBOL;
+      g.s = function_name(function);
+      _referenced.insert(g.s);
+    } else {
+      throw error_at(node, "initializer of '" + node->identifier() + "' is not a constant");
+    }
+  }
+  _module.globals.push_back(g);
+  _defined.insert(g.name);
+}
+
+void til::ir_builder::do_program_node(til::program_node *const node, int lvl) {
+  auto type = til::make_functional_type(til::make_primitive_type(4, cdk::TYPE_INT));
+  cdk::sequence_node no_arguments(node->lineno());
+  build_function("_main", type, &no_arguments, node->block(), true);
+}
@@ -0,0 +1,138 @@
+#ifndef __TIL_TARGETS_IR_BUILDER_H__
+#define __TIL_TARGETS_IR_BUILDER_H__
+
+#include "targets/basic_ast_visitor.h"
+#include "targets/constant_folder.h"
+#include "targets/call_resolver.h"
+#include "targets/ir.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cdk/types/types.h>
+
+namespace til {
+
+  /**
+   * Lower a type-checked program to the intermediate representation.
+   *
+   * Each function literal becomes an IR function (the program is "_main").
+   * Local variables are renamed into SSA values as the code is built (Braun
+   * et al., "Simple and Efficient Construction of Static Single Assignment
+   * Form", 2013): a block is sealed once all its predecessors are known and
+   * reads in unsealed blocks create PHIs that are completed when it is.
+   * Variables whose address is taken (in the function) live in frame slots.
+   */
+  class ir_builder: public basic_ast_visitor {
+    /** A local variable: an SSA variable or a frame slot. */
+    struct variable {
+      int id = -1;                    // SSA variable (if not in memory)
+      ir::instruction *slot = nullptr; // frame slot (if in memory)
+      ir::type type;
+    };
+
+    /** Function being built (function literals nest). */
+    struct function_state {
+      ir::function *function;
+      ir::block *current = nullptr;
+      std::unordered_set<std::string> addressed; // locals whose address is taken
+      std::vector<std::unordered_map<std::string, variable>> scopes;
+      std::vector<ir::type> types; // of the SSA variables
+      std::unordered_map<int, std::unordered_map<ir::block *, ir::instruction *>> definitions;
+      std::unordered_set<ir::block *> sealed;
+      std::unordered_map<ir::block *, std::vector<std::pair<int, ir::instruction *>>> incomplete;
+      std::vector<std::pair<ir::block *, ir::block *>> loops; // (next, stop) targets
+      std::shared_ptr<cdk::functional_type> type;
+    };
+
+    ir::module &_module;
+    const til::constant_folder &_folder;
+    const til::call_resolver &_resolver;
+
+    std::vector<std::unique_ptr<function_state>> _functions;
+    function_state *_fn = nullptr;
+    std::unordered_map<const til::function_node *, std::string> _function_names;
+    std::unordered_set<std::string> _externs;    // declared external
+    std::unordered_set<std::string> _referenced; // called or addressed by name
+    std::unordered_set<std::string> _defined;    // globals and functions of the module
+    ir::instruction *_value = nullptr; // of the last expression
+    size_t _visits = 0; // sequence items visited
+
+  public:
+    ir_builder(std::shared_ptr<cdk::compiler> compiler, ir::module &module, const til::constant_folder &folder,
+               const til::call_resolver &resolver) :
+        basic_ast_visitor(compiler), _module(module), _folder(folder), _resolver(resolver) {
+    }
+
+  public:
+    ~ir_builder() {
+      os().flush();
+    }
+
+    size_t visits() const {
+      return _visits;
+    }
+
+    /** Build the module of a whole program. */
+    void build(cdk::basic_node *root);
+
+  protected:
+    static ir::type type_of(std::shared_ptr<cdk::basic_type> type);
+
+    /** Size of a value of the type in memory (addresses have the module's size). */
+    size_t size_of(std::shared_ptr<cdk::basic_type> type) const;
+
+    /** Name of the IR function of a function literal. */
+    const std::string &function_name(const til::function_node *node);
+
+    ir::instruction *emit(ir::opcode op, ir::type type, std::vector<ir::instruction *> args = {});
+    ir::instruction *constant(int value, ir::type type = ir::type::INT);
+    ir::instruction *value(cdk::expression_node *node);
+    ir::instruction *convert(ir::instruction *value, std::shared_ptr<cdk::basic_type> type);
+
+    /** Address of an lvalue (not an SSA variable). */
+    ir::instruction *address(cdk::lvalue_node *node);
+
+    /** Integer multiplied by a size, as an address offset. */
+    ir::instruction *scaled(ir::instruction *value, size_t size);
+
+    // control flow
+    ir::block *new_block();
+    void jump(ir::block *target);
+    void branch(ir::instruction *condition, ir::block *if_true, ir::block *if_false);
+    void branch_on(cdk::expression_node *condition, ir::block *if_true, ir::block *if_false);
+    void seal(ir::block *block);
+    void enter(ir::block *block);
+    void leave(); // after a terminator: the following code is unreachable
+
+    // variables
+    const variable *find(const std::string &name) const;
+    void declare(const std::string &name, std::shared_ptr<cdk::basic_type> type, ir::instruction *initial);
+    void write_variable(int id, ir::block *block, ir::instruction *value);
+    ir::instruction *read_variable(int id, ir::block *block);
+    ir::instruction *new_phi(int id, ir::block *block);
+    void add_phi_operands(int id, ir::instruction *phi);
+    void remove_trivial_phis(ir::function *function);
+
+    // functions
+    void build_function(const std::string &name, std::shared_ptr<cdk::functional_type> type,
+                        cdk::sequence_node *arguments, til::block_node *body, bool exported);
+
+    ir::instruction *comparison(cdk::binary_operation_node *const node, ir::opcode int_op, ir::opcode double_op);
+    ir::instruction *logical_value(cdk::expression_node *const node);
+    void call_runtime(const std::string &name, ir::type type, std::vector<ir::instruction *> args);
+
+  public:
+    // do not edit these lines
+#define __IN_VISITOR_HEADER__
+#include ".auto/visitor_decls.h"       // automatically generated
+#undef __IN_VISITOR_HEADER__
+    // do not edit these lines: end
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,396 @@
+#include "targets/ir_postfix_backend.h"
+
+#include <algorithm>
+#include <map>
+
+//---------------------------------------------------------------------------
+
+bool til::ir_postfix_backend::rematerialized(const ir::instruction *value) {
+  switch (value->op) {
+    case ir::opcode::CONST:
+    case ir::opcode::DCONST:
+    case ir::opcode::STRING:
+    case ir::opcode::SYMBOL:
+    case ir::opcode::PARAM:
+    case ir::opcode::UNDEF:
+    case ir::opcode::SLOT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::vector<til::ir::instruction *> til::ir_postfix_backend::stack_order(const ir::instruction *instr) {
+  if (instr->op == ir::opcode::CALL)
+    return std::vector<ir::instruction *>(instr->args.rbegin(), instr->args.rend()); // first argument on top
+  if (instr->op == ir::opcode::CALLI) {
+    std::vector<ir::instruction *> order(instr->args.rbegin(), instr->args.rend() - 1);
+    order.push_back(instr->args[0]); // the function's address
+    return order;
+  }
+  if (instr->op == ir::opcode::PHI)
+    return {}; // pushed on the edges
+  return instr->args;
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_postfix_backend::emit(const ir::module &m) {
+  _pointer_size = m.pointer_size;
+  for (auto &g : m.globals)
+    emit_global(g);
+  for (auto &f : m.functions)
+    emit_function(*f);
+  _pool.emit(_pf);
+  for (auto &name : m.externals)
+    _pf.EXTERN(name);
+}
+
+void til::ir_postfix_backend::emit_global(const ir::global &g) {
+  if (g.kind == ir::global::init::ZERO) {
+    _pf.BSS();
+    _pf.ALIGN();
+    if (g.exported)
+      _pf.GLOBAL(g.name, _pf.OBJ());
+    _pf.LABEL(g.name);
+    _pf.SALLOC(ir::size_of(g.type, _pointer_size));
+    return;
+  }
+
+  _pf.DATA();
+  _pf.ALIGN();
+  if (g.exported)
+    _pf.GLOBAL(g.name, _pf.OBJ());
+  _pf.LABEL(g.name);
+  switch (g.kind) {
+    case ir::global::init::INT: _pf.SINT(g.i); break;
+    case ir::global::init::DOUBLE: _pf.SDOUBLE(g.d); break;
+    case ir::global::init::STRING: _pf.SADDR(_pool.string_address(g.s)); break;
+    case ir::global::init::SYMBOL: _pf.SADDR(g.s); break;
+    default: break;
+  }
+}
+
+void til::ir_postfix_backend::emit_function(const ir::function &f) {
+  _offsets.clear();
+  _uses.clear();
+  _stacked.clear();
+  _labels.clear();
+  _params.clear();
+
+  int offset = 8;
+  for (auto type : f.params) {
+    _params.push_back(offset);
+    offset += ir::size_of(type, _pointer_size);
+  }
+
+  for (auto &b : f.blocks) {
+    _labels[b.get()] = mklbl();
+    for (auto &instr : b->code)
+      for (auto arg : instr->args)
+        _uses[arg]++;
+  }
+
+  int frame = 0;
+  for (auto &b : f.blocks) {
+    for (auto &instr : b->code) {
+      if (instr->op == ir::opcode::SLOT) {
+        frame += (instr->i + 3) / 4 * 4;
+        _offsets[instr.get()] = -frame;
+      }
+    }
+  }
+
+  _pf.TEXT();
+  _pf.ALIGN();
+  if (f.exported)
+    _pf.GLOBAL(f.name, _pf.FUNC());
+  _pf.LABEL(f.name);
+
+  // decide which values stay on the stack (as emit_block will find the
+  // runs): the others get slots, so the frame size is known on entry
+  for (auto &b : f.blocks) {
+    std::unordered_map<const ir::instruction *, int> position, run_start;
+    std::vector<const ir::instruction *> order;
+    for (auto &instr : b->code) {
+      if (rematerialized(instr.get()) || instr->op == ir::opcode::PHI)
+        continue;
+      int p = order.size();
+      position[instr.get()] = p;
+      order.push_back(instr.get());
+
+      // stack the operands computed just before (last operand last)
+      auto operands = stack_order(instr.get());
+      int expect = p - 1, start = p;
+      bool started = false;
+      for (size_t j = operands.size(); j-- > 0;) {
+        auto o = operands[j];
+        auto at = position.find(o);
+        bool eligible = at != position.end() && at->second == expect && _uses[o] == 1 &&
+                        o->type != ir::type::VOID && o->op != ir::opcode::ALLOCA &&
+                        std::count(operands.begin(), operands.end(), o) == 1;
+        if (eligible) {
+          _stacked[o] = true;
+          start = run_start[o];
+          expect = start - 1;
+          started = true;
+        } else if (started) {
+          break;
+        }
+      }
+      run_start[instr.get()] = start;
+    }
+    for (auto &instr : b->code) {
+      auto value = instr.get();
+      if (value->type == ir::type::VOID || value->op == ir::opcode::SLOT || rematerialized(value))
+        continue;
+      if (_stacked.count(value) > 0 || _uses[value] == 0) {
+        _kept += _stacked.count(value);
+        continue;
+      }
+      frame += ir::size_of(value->type, _pointer_size);
+      _offsets[value] = -frame;
+      _stores++;
+    }
+  }
+
+  _pf.ENTER(frame);
+  for (auto &b : f.blocks)
+    emit_block(*b);
+}
+
+void til::ir_postfix_backend::emit_block(const ir::block &b) {
+  _pf.LABEL(_labels[&b]);
+
+  // operands pushed before the values stacked above them ("preloads"),
+  // by the position where the stacked run starts (outer users first)
+  std::vector<const ir::instruction *> order;
+  for (auto &instr : b.code)
+    if (!rematerialized(instr.get()) && instr->op != ir::opcode::PHI)
+      order.push_back(instr.get());
+
+  std::map<int, std::vector<std::pair<int, std::vector<ir::instruction *>>>> preloads;
+  std::unordered_map<const ir::instruction *, int> run_start;
+  std::unordered_map<const ir::instruction *, size_t> trailing; // first operand pushed by the user
+  for (size_t p = 0; p < order.size(); p++) {
+    auto operands = stack_order(order[p]);
+    int start = p;
+    size_t first = operands.size(), last = operands.size();
+    for (size_t j = operands.size(); j-- > 0;) {
+      if (_stacked.count(operands[j]) > 0) {
+        if (last == operands.size())
+          last = j;
+        first = j;
+        start = run_start[operands[j]];
+      } else if (last != operands.size()) {
+        break;
+      }
+    }
+    run_start[order[p]] = start;
+    if (last == operands.size()) {
+      trailing[order[p]] = 0; // nothing stacked: all pushed by the user
+    } else {
+      trailing[order[p]] = last + 1;
+      if (first > 0)
+        preloads[start].emplace_back(p, std::vector<ir::instruction *>(operands.begin(), operands.begin() + first));
+    }
+  }
+
+  for (size_t p = 0; p < order.size(); p++) {
+    auto pending = preloads.find(p);
+    if (pending != preloads.end()) {
+      auto users = pending->second;
+      std::sort(users.begin(), users.end(), [](auto &a, auto &b) { return a.first > b.first; });
+      for (auto &user : users)
+        for (auto operand : user.second)
+          push(operand);
+    }
+
+    auto instr = order[p];
+    auto operands = stack_order(instr);
+    for (size_t j = trailing[instr]; j < operands.size(); j++)
+      push(operands[j]);
+    emit_instruction(instr);
+
+    if (instr->type == ir::type::VOID || _stacked.count(instr) > 0 || ir::is_terminator(instr->op))
+      continue;
+    auto slot = _offsets.find(instr);
+    if (slot != _offsets.end())
+      store(instr, slot->second);
+    else
+      _pf.TRASH(ir::size_of(instr->type, _pointer_size)); // unused
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_postfix_backend::push(const ir::instruction *value) {
+  switch (value->op) {
+    case ir::opcode::CONST:
+      _pf.INT(value->i);
+      return;
+    case ir::opcode::DCONST:
+      _pf.ADDR(_pool.double_label(value->d));
+      _pf.LDDOUBLE();
+      return;
+    case ir::opcode::STRING:
+      _pf.ADDR(_pool.string_address(value->s));
+      return;
+    case ir::opcode::SYMBOL:
+      _pf.ADDR(value->s);
+      return;
+    case ir::opcode::SLOT:
+      _pf.LOCAL(_offsets.at(value));
+      return;
+    case ir::opcode::UNDEF:
+      if (value->type != ir::type::DOUBLE) {
+        _pf.INT(0);
+        return;
+      }
+      _pf.ADDR(_pool.double_label(0));
+      break;
+    case ir::opcode::PARAM:
+      _pf.LOCAL(_params.at(value->i));
+      break;
+    default:
+      if (_stacked.count(value) > 0)
+        return; // already there
+      _pf.LOCAL(_offsets.at(value));
+      break;
+  }
+  if (value->type == ir::type::DOUBLE)
+    _pf.LDDOUBLE();
+  else
+    _pf.LDINT();
+}
+
+void til::ir_postfix_backend::store(const ir::instruction *value, int offset) {
+  _pf.LOCAL(offset);
+  if (value->type == ir::type::DOUBLE)
+    _pf.STDOUBLE();
+  else
+    _pf.STINT();
+}
+
+// PHIs of the target take their values for this edge: all are pushed, then
+// stored (last first), so a PHI may read another's old value
+void til::ir_postfix_backend::emit_edge(const ir::block *from, const ir::block *to) {
+  std::vector<const ir::instruction *> phis;
+  for (auto &instr : to->code) {
+    if (instr->op != ir::opcode::PHI)
+      break;
+    if (_offsets.count(instr.get()) == 0)
+      continue; // unused
+    auto k = std::find(instr->blocks.begin(), instr->blocks.end(), from) - instr->blocks.begin();
+    push(instr->args[k]);
+    phis.push_back(instr.get());
+  }
+  for (auto phi = phis.rbegin(); phi != phis.rend(); ++phi)
+    store(*phi, _offsets.at(*phi));
+  _pf.JMP(_labels.at(to));
+}
+
+void til::ir_postfix_backend::emit_instruction(const ir::instruction *instr) {
+  switch (instr->op) {
+    case ir::opcode::ADD: case ir::opcode::PTRADD: _pf.ADD(); break;
+    case ir::opcode::SUB: case ir::opcode::PTRDIFF: _pf.SUB(); break;
+    case ir::opcode::MUL: _pf.MUL(); break;
+    case ir::opcode::DIV: _pf.DIV(); break;
+    case ir::opcode::MOD: _pf.MOD(); break;
+    case ir::opcode::NEG: _pf.NEG(); break;
+    case ir::opcode::DADD: _pf.DADD(); break;
+    case ir::opcode::DSUB: _pf.DSUB(); break;
+    case ir::opcode::DMUL: _pf.DMUL(); break;
+    case ir::opcode::DDIV: _pf.DDIV(); break;
+    case ir::opcode::DNEG: _pf.DNEG(); break;
+    case ir::opcode::I2D: _pf.I2D(); break;
+    case ir::opcode::EQ: _pf.EQ(); break;
+    case ir::opcode::NE: _pf.NE(); break;
+    case ir::opcode::LT: _pf.LT(); break;
+    case ir::opcode::LE: _pf.LE(); break;
+    case ir::opcode::GT: _pf.GT(); break;
+    case ir::opcode::GE: _pf.GE(); break;
+    case ir::opcode::DEQ: case ir::opcode::DNE: case ir::opcode::DLT:
+    case ir::opcode::DLE: case ir::opcode::DGT: case ir::opcode::DGE:
+      _pf.DCMP();
+      _pf.INT(0);
+      switch (instr->op) {
+        case ir::opcode::DEQ: _pf.EQ(); break;
+        case ir::opcode::DNE: _pf.NE(); break;
+        case ir::opcode::DLT: _pf.LT(); break;
+        case ir::opcode::DLE: _pf.LE(); break;
+        case ir::opcode::DGT: _pf.GT(); break;
+        default: _pf.GE(); break;
+      }
+      break;
+    case ir::opcode::ALLOCA:
+      _pf.ALLOC();
+      _pf.SP();
+      break;
+    case ir::opcode::LOAD:
+      if (instr->type == ir::type::DOUBLE)
+        _pf.LDDOUBLE();
+      else
+        _pf.LDINT();
+      break;
+    case ir::opcode::STORE:
+      if (instr->args[0]->type == ir::type::DOUBLE)
+        _pf.STDOUBLE();
+      else
+        _pf.STINT();
+      break;
+    case ir::opcode::CALL:
+    case ir::opcode::CALLI: {
+      if (instr->op == ir::opcode::CALL)
+        _pf.CALL(instr->s);
+      else
+        _pf.BRANCH();
+      size_t size = 0;
+      for (size_t k = instr->op == ir::opcode::CALLI ? 1 : 0; k < instr->args.size(); k++)
+        size += ir::size_of(instr->args[k]->type, _pointer_size);
+      if (size > 0)
+        _pf.TRASH(size);
+      if (instr->type == ir::type::DOUBLE)
+        _pf.LDFVAL64();
+      else if (instr->type != ir::type::VOID)
+        _pf.LDFVAL32();
+      break;
+    }
+    case ir::opcode::JMP:
+      emit_edge(instr->parent, instr->blocks[0]);
+      break;
+    case ir::opcode::BR: {
+      auto otherwise = instr->blocks[1];
+      bool copies = !otherwise->code.empty() && otherwise->code[0]->op == ir::opcode::PHI;
+      if (!copies) {
+        _pf.JZ(_labels.at(otherwise));
+        emit_edge(instr->parent, instr->blocks[0]);
+        break;
+      }
+      auto edge = mklbl();
+      _pf.JZ(edge);
+      emit_edge(instr->parent, instr->blocks[0]);
+      _pf.LABEL(edge);
+      emit_edge(instr->parent, otherwise);
+      break;
+    }
+    case ir::opcode::RET:
+      if (!instr->args.empty()) {
+        if (instr->args[0]->type == ir::type::DOUBLE)
+          _pf.STFVAL64();
+        else
+          _pf.STFVAL32();
+      }
+      _pf.LEAVE();
+      _pf.RET();
+      break;
+    default:
+      break;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::ir_postfix_backend::report(std::ostream &os) const {
+  os << "ir backend: " << _stores << " values stored, " << _kept << " kept on the stack" << std::endl;
+}
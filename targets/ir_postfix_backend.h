@@ -0,0 +1,75 @@
+#ifndef __TIL_TARGETS_IR_POSTFIX_BACKEND_H__
+#define __TIL_TARGETS_IR_POSTFIX_BACKEND_H__
+
+#include "targets/ir.h"
+#include "targets/literal_pool.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cdk/emitters/basic_postfix_emitter.h>
+
+namespace til {
+
+  /**
+   * Emit postfix code for an IR module.
+   *
+   * Values live in frame slots, except constants, addresses and arguments,
+   * which are pushed where they are used. A value used once, by the next
+   * instructions of its block, is left on the stack for its user instead
+   * ("stackified"): expression trees become the usual postfix sequences and
+   * only values used more than once, or across blocks, are stored. A PHI is a
+   * slot written on each incoming edge (all values are pushed, then stored).
+   */
+  class ir_postfix_backend {
+    cdk::basic_postfix_emitter &_pf;
+    til::literal_pool &_pool;
+    size_t _pointer_size = 4; // of the module
+
+    // per function
+    std::unordered_map<const ir::instruction *, int> _offsets; // of slots (values and SLOTs)
+    std::unordered_map<const ir::instruction *, int> _uses;
+    std::unordered_map<const ir::instruction *, bool> _stacked; // left on the stack for the user
+    std::unordered_map<const ir::block *, std::string> _labels;
+    std::vector<int> _params; // offsets of the arguments
+    size_t _stores = 0, _kept = 0;
+
+    int _lbl = 0;
+
+  public:
+    ir_postfix_backend(cdk::basic_postfix_emitter &pf, til::literal_pool &pool) :
+        _pf(pf), _pool(pool) {
+    }
+
+  public:
+    void emit(const ir::module &m);
+
+    /** Print how many values were stored and kept on the stack. */
+    void report(std::ostream &os) const;
+
+  private:
+    void emit_global(const ir::global &g);
+    void emit_function(const ir::function &f);
+    void emit_block(const ir::block &b);
+
+    /** Push the value of an operand (from its slot, or computed in place). */
+    void push(const ir::instruction *value);
+    void store(const ir::instruction *value, int offset);
+    void emit_instruction(const ir::instruction *instr);
+    void emit_edge(const ir::block *from, const ir::block *to);
+
+    /** Whether the value is computed where it is used (never stored). */
+    static bool rematerialized(const ir::instruction *value);
+
+    /** Operands in the order they are pushed. */
+    static std::vector<ir::instruction *> stack_order(const ir::instruction *instr);
+
+    std::string mklbl() {
+      return "_IR" + std::to_string(++_lbl);
+    }
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,7 @@
+#include "targets/ir_target.h"
+
+/**
+ * Intermediate representation, as text.
+ * @var create and register an evaluator for IR targets.
+ */
+til::ir_target til::ir_target::_self;
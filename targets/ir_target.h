@@ -0,0 +1,48 @@
+#ifndef __TIL_TARGETS_IR_TARGET_H__
+#define __TIL_TARGETS_IR_TARGET_H__
+
+#include <cdk/targets/basic_target.h>
+#include <cdk/ast/basic_node.h>
+#include "targets/front_end.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
+
+namespace til {
+
+  /** Print the intermediate representation of the program (after verifying it). */
+  class ir_target: public cdk::basic_target {
+    static ir_target _self;
+
+  private:
+    ir_target() :
+        cdk::basic_target("ir") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
+      front_end front(compiler);
+      auto module = front.analyse() ? front.build_ir(4) : nullptr; // 32-bit addresses, as in the asm target
+      if (module == nullptr) {
+        report.print_if_requested(std::cerr);
+        return false;
+      }
+
+      {
+        til::scoped_pass pass("ir output");
+        ir::print(*compiler->ostream(), *module);
+        compiler->ostream()->flush();
+      }
+
+      report.print_if_requested(std::cerr);
+      return true;
+    }
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,90 @@
+#include "targets/literal_pool.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+//---------------------------------------------------------------------------
+
+void til::literal_pool::collect(cdk::basic_node *root) {
+  root->accept(this, 0);
+
+  // sorted by their reversed text, a string that ends another one comes
+  // right before some string it ends (the longest of those comes last)
+  std::vector<std::string> reversed;
+  for (auto &entry : _strings)
+    reversed.emplace_back(entry.first.rbegin(), entry.first.rend());
+  std::sort(reversed.begin(), reversed.end());
+
+  for (size_t i = reversed.size(); i-- > 0;) {
+    std::string value(reversed[i].rbegin(), reversed[i].rend());
+    auto &where = _strings[value];
+    if (i + 1 < reversed.size() && reversed[i + 1].compare(0, reversed[i].size(), reversed[i]) == 0) {
+      auto &longer = _strings[std::string(reversed[i + 1].rbegin(), reversed[i + 1].rend())];
+      where.root = longer.root;
+      where.offset = longer.offset + reversed[i + 1].size() - reversed[i].size();
+    } else {
+      where.root = _roots.size();
+      where.offset = 0;
+      _roots.push_back(value);
+    }
+  }
+}
+
+std::string til::literal_pool::string_address(const std::string &value) {
+  _requests++;
+  auto it = _strings.find(value);
+  if (it == _strings.end() || it->second.root >= _roots.size()) {
+    // not seen by collect (e.g., created after it): a copy of its own
+    it = _strings.insert_or_assign(value, location { _roots.size(), 0 }).first;
+    _roots.push_back(value);
+  }
+  auto address = "_LS" + std::to_string(it->second.root);
+  if (it->second.offset > 0)
+    address += "+" + std::to_string(it->second.offset);
+  return address;
+}
+
+uint64_t til::literal_pool::bits(double value) {
+  uint64_t result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+std::string til::literal_pool::double_label(double value) {
+  _double_requests++;
+  auto inserted = _double_labels.emplace(bits(value), _doubles.size());
+  if (inserted.second)
+    _doubles.push_back(value);
+  return "_LD" + std::to_string(inserted.first->second);
+}
+
+void til::literal_pool::emit(cdk::basic_postfix_emitter &pf) const {
+  if (_roots.empty() && _doubles.empty())
+    return;
+
+  pf.RODATA();
+  for (size_t i = 0; i < _doubles.size(); i++) {
+    pf.ALIGN();
+    pf.LABEL("_LD" + std::to_string(i));
+    pf.SDOUBLE(_doubles[i]);
+  }
+  for (size_t i = 0; i < _roots.size(); i++) {
+    pf.ALIGN();
+    pf.LABEL("_LS" + std::to_string(i));
+    pf.SSTRING(_roots[i]);
+  }
+}
+
+void til::literal_pool::report(std::ostream &os) const {
+  os << "literal pool: " << _requests << " string references, " << _strings.size() << " distinct, "
+     << _roots.size() << " emitted; " << _double_requests << " double references, " << _doubles.size()
+     << " emitted" << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+void til::literal_pool::do_string_node(cdk::string_node *const node, int lvl) {
+  _strings.emplace(node->value(), location { (size_t)-1, 0 });
+}
@@ -0,0 +1,69 @@
+#ifndef __TIL_TARGETS_LITERAL_POOL_H__
+#define __TIL_TARGETS_LITERAL_POOL_H__
+
+#include "targets/tree_walker.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cdk/emitters/basic_postfix_emitter.h>
+
+namespace til {
+
+  /**
+   * Read-only literals of a translation unit, each emitted once.
+   *
+   * The string literals of the program are collected before code generation.
+   * Equal strings share one copy and a string that ends another one is a
+   * reference into it ("label+offset"). Doubles are pooled as they are
+   * requested, by bit pattern. The pool is emitted after the whole
+   * translation unit.
+   */
+  class literal_pool: public tree_walker {
+    struct location {
+      size_t root; // index of the emitted string
+      size_t offset;
+    };
+
+    std::vector<std::string> _roots; // emitted strings
+    std::unordered_map<std::string, location> _strings;
+    size_t _requests = 0; // string references
+
+    std::map<uint64_t, size_t> _double_labels; // by bit pattern
+    std::vector<double> _doubles;
+    size_t _double_requests = 0;
+
+  public:
+    literal_pool(std::shared_ptr<cdk::compiler> compiler) :
+        tree_walker(compiler) {
+    }
+
+  public:
+    /** Collect the string literals of the program and lay them out. */
+    void collect(cdk::basic_node *root);
+
+    /** Address (label, maybe with an offset) of a string literal. */
+    std::string string_address(const std::string &value);
+
+    /** Label of a double constant. */
+    std::string double_label(double value);
+
+    /** Emit the pool (read-only data). */
+    void emit(cdk::basic_postfix_emitter &pf) const;
+
+    /** Print how many literals were shared. */
+    void report(std::ostream &os) const;
+
+  private:
+    static uint64_t bits(double value);
+
+  public:
+    void do_string_node(cdk::string_node *const node, int lvl);
+
+  };
+
+} // til
+
+#endif
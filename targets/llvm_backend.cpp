@@ -0,0 +1,432 @@
+#include "targets/llvm_backend.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  const char *llvm_type(til::ir::type type) {
+    switch (type) {
+      case til::ir::type::VOID: return "void";
+      case til::ir::type::INT: return "i32";
+      case til::ir::type::DOUBLE: return "double";
+      case til::ir::type::PTR: return "i8*";
+    }
+    return "?";
+  }
+
+  std::string function_type(til::ir::type result, const std::vector<til::ir::type> &params) {
+    std::string text = std::string(llvm_type(result)) + " (";
+    for (size_t k = 0; k < params.size(); k++)
+      text += std::string(k > 0 ? ", " : "") + llvm_type(params[k]);
+    return text + ")";
+  }
+
+  // the exact bits, as LLVM writes them
+  std::string double_constant(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    char text[24];
+    std::snprintf(text, sizeof text, "0x%016" PRIX64, bits);
+    return text;
+  }
+
+  std::string label(const til::ir::block *b) {
+    return "b" + std::to_string(b->id);
+  }
+
+  bool rematerialized(const til::ir::instruction *value) {
+    switch (value->op) {
+      case til::ir::opcode::CONST:
+      case til::ir::opcode::DCONST:
+      case til::ir::opcode::STRING:
+      case til::ir::opcode::SYMBOL:
+      case til::ir::opcode::PARAM:
+      case til::ir::opcode::UNDEF:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  const char *integer_predicate(til::ir::opcode op) {
+    switch (op) {
+      case til::ir::opcode::EQ: return "eq";
+      case til::ir::opcode::NE: return "ne";
+      case til::ir::opcode::LT: return "slt";
+      case til::ir::opcode::LE: return "sle";
+      case til::ir::opcode::GT: return "sgt";
+      default: return "sge";
+    }
+  }
+
+  // ordered, except "not equal" (true if unordered, as in C)
+  const char *double_predicate(til::ir::opcode op) {
+    switch (op) {
+      case til::ir::opcode::DEQ: return "oeq";
+      case til::ir::opcode::DNE: return "une";
+      case til::ir::opcode::DLT: return "olt";
+      case til::ir::opcode::DLE: return "ole";
+      case til::ir::opcode::DGT: return "ogt";
+      default: return "oge";
+    }
+  }
+
+}
+
+//---------------------------------------------------------------------------
+
+void til::llvm_backend::emit(const ir::module &m) {
+  _module = &m;
+  for (auto &f : m.functions)
+    _signatures[f->name] = { f->result, f->params };
+  for (auto &g : m.globals)
+    _globals[g.name] = g.type;
+  for (auto &e : ir::externals_of(m)) {
+    _externals[e.first] = e.second.memory;
+    _signatures[e.first] = e.second.types;
+  }
+
+  _os << "; TIL program" << std::endl;
+  for (auto &g : m.globals)
+    emit_global(g);
+  for (auto &f : m.functions)
+    emit_function(*f);
+
+  if (!_externals.empty())
+    _os << std::endl;
+  for (auto &e : _externals) {
+    if (e.second) {
+      _os << "@" << e.first << " = external global i8" << std::endl;
+    } else {
+      auto &s = _signatures.at(e.first);
+      _os << "declare " << llvm_type(s.result) << " @" << e.first << "(";
+      for (size_t k = 0; k < s.params.size(); k++)
+        _os << (k > 0 ? ", " : "") << llvm_type(s.params[k]);
+      _os << ")" << std::endl;
+    }
+  }
+
+  if (!_strings.empty())
+    _os << std::endl;
+  for (auto &s : _strings) {
+    _os << s.second << " = private unnamed_addr constant [" << s.first.size() + 1 << " x i8] c\"";
+    for (unsigned char c : s.first) {
+      if (c < 32 || c >= 127 || c == '"' || c == '\\') {
+        char escape[4];
+        std::snprintf(escape, sizeof escape, "\\%02X", c);
+        _os << escape;
+      } else {
+        _os << c;
+      }
+    }
+    _os << "\\00\", align 1" << std::endl;
+  }
+  _module = nullptr;
+}
+
+void til::llvm_backend::emit_global(const ir::global &g) {
+  std::string initial;
+  switch (g.kind) {
+    case ir::global::init::ZERO:
+      initial = g.type == ir::type::DOUBLE ? "0.0" : constant(0, g.type);
+      break;
+    case ir::global::init::INT:
+      initial = constant(g.i, g.type);
+      break;
+    case ir::global::init::DOUBLE:
+      initial = double_constant(g.d);
+      break;
+    case ir::global::init::STRING:
+      initial = string_address(g.s);
+      break;
+    case ir::global::init::SYMBOL:
+      initial = symbol(g.s);
+      break;
+  }
+  _os << "@" << g.name << " = " << (g.exported ? "" : "internal ") << "global " << llvm_type(g.type) << " "
+      << initial << ", align " << (g.type == ir::type::INT ? 4 : 8) << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+void til::llvm_backend::emit_function(const ir::function &f) {
+  _function = &f;
+  _names.clear();
+  _temporaries = 0;
+  int n = 0;
+  for (auto &b : f.blocks)
+    for (auto &instr : b->code)
+      if (!rematerialized(instr.get()) && instr->type != ir::type::VOID)
+        _names[instr.get()] = "%v" + std::to_string(n++);
+
+  _os << std::endl << "define " << (f.exported ? "" : "internal ") << llvm_type(f.result) << " @" << f.name << "(";
+  for (size_t k = 0; k < f.params.size(); k++)
+    _os << (k > 0 ? ", " : "") << llvm_type(f.params[k]) << " %p" << k;
+  _os << ") {" << std::endl;
+
+  auto order = f.reverse_postorder();
+  for (auto b : order) {
+    _os << label(b) << ":" << std::endl;
+
+    // frame slots: static allocas, so that they can be promoted
+    if (b == order.front())
+      for (auto &block : f.blocks)
+        for (auto &instr : block->code)
+          if (instr->op == ir::opcode::SLOT) {
+            auto &name = _names.at(instr.get());
+            _os << "  " << name << ".slot = alloca [" << instr->i << " x i8], align 8" << std::endl;
+            _os << "  " << name << " = bitcast [" << instr->i << " x i8]* " << name << ".slot to i8*" << std::endl;
+          }
+
+    for (auto &instr : b->code)
+      if (!rematerialized(instr.get()) && instr->op != ir::opcode::SLOT)
+        emit_instruction(instr.get());
+  }
+  _os << "}" << std::endl;
+  _function = nullptr;
+}
+
+//---------------------------------------------------------------------------
+
+std::string til::llvm_backend::constant(int value, ir::type type) {
+  switch (type) {
+    case ir::type::PTR:
+      return value == 0 ? "null" : "inttoptr (i64 " + std::to_string(value) + " to i8*)";
+    case ir::type::DOUBLE:
+      return double_constant(value);
+    default:
+      return std::to_string(value);
+  }
+}
+
+std::string til::llvm_backend::symbol(const std::string &name) {
+  auto external = _externals.find(name);
+  if (external != _externals.end() && external->second)
+    return "@" + name;
+  auto function = _signatures.find(name);
+  if (function != _signatures.end())
+    return "bitcast (" + function_type(function->second.result, function->second.params) + "* @" + name + " to i8*)";
+  auto global = _globals.find(name);
+  if (global != _globals.end())
+    return std::string("bitcast (") + llvm_type(global->second) + "* @" + name + " to i8*)";
+  return "@" + name;
+}
+
+std::string til::llvm_backend::string_address(const std::string &value) {
+  auto it = _strings.find(value);
+  if (it == _strings.end())
+    it = _strings.emplace(value, "@.str." + std::to_string(_strings.size())).first;
+  auto array = "[" + std::to_string(value.size() + 1) + " x i8]";
+  return "getelementptr inbounds (" + array + ", " + array + "* " + it->second + ", i64 0, i64 0)";
+}
+
+std::string til::llvm_backend::operand(const ir::instruction *value, ir::type type) {
+  std::string text;
+  switch (value->op) {
+    case ir::opcode::CONST: return constant(value->i, type);
+    case ir::opcode::UNDEF: return type == ir::type::DOUBLE ? "0.0" : constant(0, type);
+    case ir::opcode::DCONST: text = double_constant(value->d); break;
+    case ir::opcode::STRING: text = string_address(value->s); break;
+    case ir::opcode::SYMBOL: text = symbol(value->s); break;
+    case ir::opcode::PARAM: text = "%p" + std::to_string(value->i); break;
+    default: text = _names.at(value); break;
+  }
+  if (value->type == type)
+    return text;
+
+  auto converted = temporary();
+  if (value->type == ir::type::INT && type == ir::type::PTR)
+    _os << "  " << converted << " = inttoptr i32 " << text << " to i8*" << std::endl;
+  else if (value->type == ir::type::PTR && type == ir::type::INT)
+    _os << "  " << converted << " = ptrtoint i8* " << text << " to i32" << std::endl;
+  else if (value->type == ir::type::INT && type == ir::type::DOUBLE)
+    _os << "  " << converted << " = sitofp i32 " << text << " to double" << std::endl;
+  else
+    return text;
+  return converted;
+}
+
+std::string til::llvm_backend::result(const ir::instruction *instr) {
+  auto it = _names.find(instr);
+  return it == _names.end() ? "" : it->second + " = ";
+}
+
+//---------------------------------------------------------------------------
+
+void til::llvm_backend::emit_call(const ir::instruction *call) {
+  signature actual { call->type, {} };
+  for (size_t k = call->op == ir::opcode::CALLI ? 1 : 0; k < call->args.size(); k++)
+    actual.params.push_back(call->args[k]->type);
+
+  // a direct call uses the declared types, unless the arity or result differ
+  signature used = actual;
+  std::string callee;
+  if (call->op == ir::opcode::CALLI) {
+    auto address = operand(call->args[0], ir::type::PTR);
+    callee = temporary();
+    _os << "  " << callee << " = bitcast i8* " << address << " to "
+        << function_type(actual.result, actual.params) << "*" << std::endl;
+  } else {
+    auto &declared = _signatures.at(call->s);
+    if (declared.result == actual.result && declared.params.size() == actual.params.size()) {
+      used = declared;
+      callee = "@" + call->s;
+    } else {
+      callee = "bitcast (" + function_type(declared.result, declared.params) + "* @" + call->s + " to "
+               + function_type(actual.result, actual.params) + "*)";
+    }
+  }
+
+  std::string arguments;
+  for (size_t k = 0; k < used.params.size(); k++) {
+    auto arg = call->args[k + (call->op == ir::opcode::CALLI ? 1 : 0)];
+    arguments += std::string(k > 0 ? ", " : "") + llvm_type(used.params[k]) + " " + operand(arg, used.params[k]);
+  }
+  _os << "  " << result(call) << "call " << llvm_type(used.result) << " " << callee << "(" << arguments << ")"
+      << std::endl;
+}
+
+void til::llvm_backend::emit_instruction(const ir::instruction *instr) {
+  auto a = instr->args.empty() ? nullptr : instr->args[0];
+  auto b = instr->args.size() < 2 ? nullptr : instr->args[1];
+  auto type = llvm_type(instr->type);
+
+  switch (instr->op) {
+    case ir::opcode::ADD: case ir::opcode::SUB: case ir::opcode::MUL:
+    case ir::opcode::DIV: case ir::opcode::MOD: {
+      const char *op = instr->op == ir::opcode::ADD ? "add" : instr->op == ir::opcode::SUB ? "sub"
+                       : instr->op == ir::opcode::MUL ? "mul" : instr->op == ir::opcode::DIV ? "sdiv" : "srem";
+      auto left = operand(a, ir::type::INT), right = operand(b, ir::type::INT);
+      _os << "  " << result(instr) << op << " i32 " << left << ", " << right << std::endl;
+      break;
+    }
+    case ir::opcode::NEG: {
+      auto value = operand(a, ir::type::INT);
+      _os << "  " << result(instr) << "sub i32 0, " << value << std::endl;
+      break;
+    }
+
+    case ir::opcode::DADD: case ir::opcode::DSUB: case ir::opcode::DMUL: case ir::opcode::DDIV: {
+      const char *op = instr->op == ir::opcode::DADD ? "fadd" : instr->op == ir::opcode::DSUB ? "fsub"
+                       : instr->op == ir::opcode::DMUL ? "fmul" : "fdiv";
+      auto left = operand(a, ir::type::DOUBLE), right = operand(b, ir::type::DOUBLE);
+      _os << "  " << result(instr) << op << " double " << left << ", " << right << std::endl;
+      break;
+    }
+    case ir::opcode::DNEG: {
+      auto value = operand(a, ir::type::DOUBLE);
+      _os << "  " << result(instr) << "fneg double " << value << std::endl;
+      break;
+    }
+    case ir::opcode::I2D: {
+      auto value = operand(a, ir::type::INT);
+      _os << "  " << result(instr) << "sitofp i32 " << value << " to double" << std::endl;
+      break;
+    }
+
+    case ir::opcode::EQ: case ir::opcode::NE: case ir::opcode::LT:
+    case ir::opcode::LE: case ir::opcode::GT: case ir::opcode::GE: {
+      auto compared = a->type == ir::type::PTR || b->type == ir::type::PTR ? ir::type::PTR : ir::type::INT;
+      auto left = operand(a, compared), right = operand(b, compared);
+      auto flag = temporary();
+      _os << "  " << flag << " = icmp " << integer_predicate(instr->op) << " " << llvm_type(compared) << " "
+          << left << ", " << right << std::endl;
+      _os << "  " << result(instr) << "zext i1 " << flag << " to i32" << std::endl;
+      break;
+    }
+    case ir::opcode::DEQ: case ir::opcode::DNE: case ir::opcode::DLT:
+    case ir::opcode::DLE: case ir::opcode::DGT: case ir::opcode::DGE: {
+      auto left = operand(a, ir::type::DOUBLE), right = operand(b, ir::type::DOUBLE);
+      auto flag = temporary();
+      _os << "  " << flag << " = fcmp " << double_predicate(instr->op) << " double " << left << ", " << right
+          << std::endl;
+      _os << "  " << result(instr) << "zext i1 " << flag << " to i32" << std::endl;
+      break;
+    }
+
+    case ir::opcode::PTRADD: {
+      auto base = operand(a, ir::type::PTR);
+      std::string offset;
+      if (b->op == ir::opcode::CONST) {
+        offset = std::to_string(b->i);
+      } else {
+        auto bytes = operand(b, ir::type::INT);
+        offset = temporary();
+        _os << "  " << offset << " = sext i32 " << bytes << " to i64" << std::endl;
+      }
+      _os << "  " << result(instr) << "getelementptr i8, i8* " << base << ", i64 " << offset << std::endl;
+      break;
+    }
+    case ir::opcode::PTRDIFF: {
+      auto left = operand(a, ir::type::PTR), right = operand(b, ir::type::PTR);
+      auto l = temporary(), r = temporary(), difference = temporary();
+      _os << "  " << l << " = ptrtoint i8* " << left << " to i64" << std::endl;
+      _os << "  " << r << " = ptrtoint i8* " << right << " to i64" << std::endl;
+      _os << "  " << difference << " = sub i64 " << l << ", " << r << std::endl;
+      _os << "  " << result(instr) << "trunc i64 " << difference << " to i32" << std::endl;
+      break;
+    }
+
+    case ir::opcode::ALLOCA: {
+      auto bytes = operand(a, ir::type::INT);
+      _os << "  " << result(instr) << "alloca i8, i32 " << bytes << ", align 8" << std::endl;
+      break;
+    }
+    case ir::opcode::LOAD: {
+      auto address = operand(a, ir::type::PTR);
+      auto typed = temporary();
+      _os << "  " << typed << " = bitcast i8* " << address << " to " << type << "*" << std::endl;
+      _os << "  " << result(instr) << "load " << type << ", " << type << "* " << typed << std::endl;
+      break;
+    }
+    case ir::opcode::STORE: {
+      auto stored = llvm_type(a->type);
+      auto value = operand(a, a->type), address = operand(b, ir::type::PTR);
+      auto typed = temporary();
+      _os << "  " << typed << " = bitcast i8* " << address << " to " << stored << "*" << std::endl;
+      _os << "  store " << stored << " " << value << ", " << stored << "* " << typed << std::endl;
+      break;
+    }
+
+    case ir::opcode::CALL: case ir::opcode::CALLI:
+      emit_call(instr);
+      break;
+
+    case ir::opcode::PHI: {
+      std::string incoming;
+      for (size_t k = 0; k < instr->args.size(); k++)
+        incoming += std::string(k > 0 ? ", " : "") + "[ " + operand(instr->args[k], instr->type) + ", %"
+                    + label(instr->blocks[k]) + " ]";
+      _os << "  " << result(instr) << "phi " << type << " " << incoming << std::endl;
+      break;
+    }
+
+    case ir::opcode::JMP:
+      _os << "  br label %" << label(instr->blocks[0]) << std::endl;
+      break;
+    case ir::opcode::BR: {
+      auto condition = operand(a, a->type);
+      auto flag = temporary();
+      _os << "  " << flag << " = icmp ne " << llvm_type(a->type) << " " << condition << ", "
+          << constant(0, a->type) << std::endl;
+      _os << "  br i1 " << flag << ", label %" << label(instr->blocks[0]) << ", label %" << label(instr->blocks[1])
+          << std::endl;
+      break;
+    }
+    case ir::opcode::RET:
+      if (a == nullptr || _function->result == ir::type::VOID) {
+        _os << "  ret void" << std::endl;
+      } else {
+        auto value = operand(a, _function->result);
+        _os << "  ret " << llvm_type(_function->result) << " " << value << std::endl;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef __TIL_TARGETS_LLVM_BACKEND_H__
+#define __TIL_TARGETS_LLVM_BACKEND_H__
+
+#include "targets/ir.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Write an IR module as textual LLVM IR (.ll), for opt and llc.
+   *
+   * The IR is already in SSA form, so values, PHIs and blocks map one to
+   * one. Every address is an i8* (accesses cast it to the type loaded or
+   * stored); frame slots become allocas in the entry block, where mem2reg
+   * can promote them. Externals are declared with the types of their first
+   * call (other calls cast the function); those used as memory are external
+   * byte arrays. No target triple is set: llc compiles for the host.
+   *
+   * The module must be built with 8-byte addresses.
+   */
+  class llvm_backend {
+    using signature = ir::signature;
+
+    std::ostream &_os;
+    const ir::module *_module = nullptr;
+    std::unordered_map<std::string, signature> _signatures; // functions, defined and external
+    std::unordered_map<std::string, ir::type> _globals;
+    std::map<std::string, bool> _externals;                 // true if used as memory
+    std::map<std::string, std::string> _strings;
+
+    // per function
+    std::unordered_map<const ir::instruction *, std::string> _names;
+    const ir::function *_function = nullptr;
+    int _temporaries = 0;
+
+  public:
+    llvm_backend(std::ostream &os) :
+        _os(os) {
+    }
+
+  public:
+    void emit(const ir::module &m);
+
+  private:
+    void emit_global(const ir::global &g);
+    void emit_function(const ir::function &f);
+    void emit_instruction(const ir::instruction *instr);
+    void emit_call(const ir::instruction *call);
+
+    /** An operand of the given type (converted first, if needed). */
+    std::string operand(const ir::instruction *value, ir::type type);
+
+    /** Constant operands, by kind. */
+    std::string constant(int value, ir::type type);
+    std::string symbol(const std::string &name);
+    std::string string_address(const std::string &value);
+
+    std::string result(const ir::instruction *instr); // "%vN = ", or nothing if VOID
+
+    std::string temporary() {
+      return "%t" + std::to_string(++_temporaries);
+    }
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,7 @@
+#include "targets/llvm_target.h"
+
+/**
+ * Textual LLVM IR.
+ * @var create and register an evaluator for LLVM targets.
+ */
+til::llvm_target til::llvm_target::_self;
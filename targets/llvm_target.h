@@ -0,0 +1,57 @@
+#ifndef __TIL_TARGETS_LLVM_TARGET_H__
+#define __TIL_TARGETS_LLVM_TARGET_H__
+
+#include <cdk/targets/basic_target.h>
+#include <cdk/ast/basic_node.h>
+#include "targets/front_end.h"
+#include "targets/llvm_backend.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
+
+namespace til {
+
+  /**
+   * Textual LLVM IR, through the intermediate representation (libLLVM is not
+   * needed: the output is for the LLVM tools).
+   *
+   *   til --target llvm prog.til -o prog.ll
+   *   opt -O2 -S prog.ll -o prog.opt.ll && llc -O2 prog.opt.ll -o prog.s
+   *   gcc -o prog prog.s runtime/libtilrt64.a
+   */
+  class llvm_target: public cdk::basic_target {
+    static llvm_target _self;
+
+  private:
+    llvm_target() :
+        cdk::basic_target("llvm") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
+      front_end front(compiler);
+      auto module = front.analyse() ? front.build_ir(8) : nullptr;
+      if (module == nullptr) {
+        report.print_if_requested(std::cerr);
+        return false;
+      }
+
+      llvm_backend backend(*compiler->ostream());
+      {
+        til::scoped_pass pass("code generation");
+        backend.emit(*module);
+        compiler->ostream()->flush();
+      }
+
+      report.print_if_requested(std::cerr);
+      return true;
+    }
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,218 @@
+#include "targets/loop_invariants.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+#include <cstdlib>
+#include <functional>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  /** Collect the variables whose address is taken (by name). */
+  class address_collector: public til::tree_walker {
+  public:
+    std::unordered_set<std::string> &names;
+
+    address_collector(std::shared_ptr<cdk::compiler> compiler, std::unordered_set<std::string> &names) :
+        til::tree_walker(compiler), names(names) {
+    }
+
+    void do_address_of_node(til::address_of_node *const node, int lvl) {
+      if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue()))
+        names.insert(variable->name());
+      tree_walker::do_address_of_node(node, lvl);
+    }
+  };
+
+  /** Collect what a loop (condition and body) changes (not counting nested functions). */
+  class effects_collector: public til::tree_walker {
+  public:
+    til::loop_invariants::effects &body;
+
+    effects_collector(std::shared_ptr<cdk::compiler> compiler, til::loop_invariants::effects &body) :
+        til::tree_walker(compiler), body(body) {
+    }
+
+    void do_assignment_node(cdk::assignment_node *const node, int lvl) {
+      if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue()))
+        body.assigned.insert(variable->name());
+      else
+        body.stores = true;
+      tree_walker::do_assignment_node(node, lvl);
+    }
+    void do_declaration_node(til::declaration_node *const node, int lvl) {
+      body.declared.insert(node->identifier());
+      tree_walker::do_declaration_node(node, lvl);
+    }
+    void do_function_call_node(til::function_call_node *const node, int lvl) {
+      body.calls = true;
+      tree_walker::do_function_call_node(node, lvl);
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      // not run by the loop
+    }
+  };
+
+  /** Offer the largest candidate expressions of a loop body for hoisting. */
+  class candidate_finder: public til::tree_walker {
+    std::function<bool(cdk::typed_node *)> _hoist;
+
+  public:
+    candidate_finder(std::shared_ptr<cdk::compiler> compiler, std::function<bool(cdk::typed_node *)> hoist) :
+        til::tree_walker(compiler), _hoist(hoist) {
+    }
+
+    void do_add_node(cdk::add_node *const node, int lvl) {
+      if (!_hoist(node))
+        tree_walker::do_add_node(node, lvl);
+    }
+    void do_sub_node(cdk::sub_node *const node, int lvl) {
+      if (!_hoist(node))
+        tree_walker::do_sub_node(node, lvl);
+    }
+    void do_mul_node(cdk::mul_node *const node, int lvl) {
+      if (!_hoist(node))
+        tree_walker::do_mul_node(node, lvl);
+    }
+    void do_index_node(til::index_node *const node, int lvl) {
+      if (!_hoist(node))
+        tree_walker::do_index_node(node, lvl);
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      // another frame
+    }
+  };
+
+}
+
+//---------------------------------------------------------------------------
+
+til::loop_invariants::loop_invariants(std::shared_ptr<cdk::compiler> compiler, const til::constant_folder &folder) :
+    tree_walker(compiler), _folder(folder), _enabled(std::getenv("TIL_NO_LICM") == nullptr) {
+}
+
+void til::loop_invariants::analyse(cdk::basic_node *root) {
+  if (!_enabled)
+    return;
+  address_collector addresses(_compiler, _addressed);
+  root->accept(&addresses, 0);
+  root->accept(this, 0);
+}
+
+const std::vector<cdk::typed_node *> &til::loop_invariants::hoisted(const til::loop_node *loop) const {
+  static const std::vector<cdk::typed_node *> none;
+  auto it = _hoisted.find(loop);
+  return it == _hoisted.end() ? none : it->second;
+}
+
+bool til::loop_invariants::is_address(cdk::typed_node *node) {
+  return dynamic_cast<til::index_node *>(node) != nullptr;
+}
+
+size_t til::loop_invariants::temporary_size(cdk::typed_node *node) {
+  return is_address(node) ? 4 : node->type()->size();
+}
+
+void til::loop_invariants::report(std::ostream &os) const {
+  os << "loop invariants: " << count() << " expressions hoisted" << std::endl;
+  for (auto loop : _loops)
+    os << "  loop at line " << loop->lineno() << ": " << hoisted(loop).size() << " hoisted" << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+// locals keep their values across calls and stores unless their address is taken
+bool til::loop_invariants::stable(const std::string &name, const effects &body) const {
+  if (body.assigned.count(name) > 0 || body.declared.count(name) > 0)
+    return false;
+  if (!body.calls && !body.stores)
+    return true;
+  if (_addressed.count(name) > 0)
+    return false;
+  for (auto &scope : _scopes)
+    if (scope.count(name) > 0)
+      return true;
+  return false; // global
+}
+
+bool til::loop_invariants::invariant(cdk::basic_node *node, const effects &body) const {
+  if (dynamic_cast<cdk::integer_node *>(node) || dynamic_cast<cdk::double_node *>(node) ||
+      dynamic_cast<cdk::string_node *>(node) || dynamic_cast<til::nullptr_node *>(node) ||
+      dynamic_cast<til::sizeof_node *>(node))
+    return true;
+  if (auto rvalue = dynamic_cast<cdk::rvalue_node *>(node)) {
+    auto variable = dynamic_cast<cdk::variable_node *>(rvalue->lvalue());
+    return variable != nullptr && stable(variable->name(), body); // no loads from memory
+  }
+  if (auto address = dynamic_cast<til::address_of_node *>(node))
+    return address_invariant(address->lvalue(), body);
+  if (dynamic_cast<cdk::div_node *>(node) || dynamic_cast<cdk::mod_node *>(node))
+    return false;
+  if (dynamic_cast<til::stack_alloc_node *>(node) || dynamic_cast<til::read_node *>(node))
+    return false; // a new value each time (objects is a unary operation)
+  if (auto binary = dynamic_cast<cdk::binary_operation_node *>(node))
+    return invariant(binary->left(), body) && invariant(binary->right(), body);
+  if (auto unary = dynamic_cast<cdk::unary_operation_node *>(node))
+    return invariant(unary->argument(), body);
+  return false; // calls, reads, assignments, allocations, functions
+}
+
+bool til::loop_invariants::address_invariant(cdk::basic_node *node, const effects &body) const {
+  if (auto variable = dynamic_cast<cdk::variable_node *>(node))
+    return body.declared.count(variable->name()) == 0;
+  if (auto index = dynamic_cast<til::index_node *>(node))
+    return invariant(index->base(), body) && invariant(index->index(), body);
+  return false;
+}
+
+bool til::loop_invariants::hoist(cdk::typed_node *node, const til::loop_node *loop, const effects &body) {
+  if (is_hoisted(node))
+    return true; // by an enclosing loop
+  auto expression = dynamic_cast<cdk::expression_node *>(node);
+  if (expression != nullptr && _folder.value(expression) != nullptr)
+    return true; // a constant already
+  if (is_address(node) ? !address_invariant(node, body) : !invariant(node, body))
+    return false;
+  _hoisted[loop].push_back(node);
+  _expressions.insert(node);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+void til::loop_invariants::do_function_node(til::function_node *const node, int lvl) {
+  // the locals of enclosing functions are not visible
+  auto outer = std::move(_scopes);
+  _scopes.clear();
+  _scopes.emplace_back();
+  tree_walker::do_function_node(node, lvl);
+  _scopes = std::move(outer);
+}
+
+void til::loop_invariants::do_block_node(til::block_node *const node, int lvl) {
+  _scopes.emplace_back();
+  tree_walker::do_block_node(node, lvl);
+  _scopes.pop_back();
+}
+
+void til::loop_invariants::do_declaration_node(til::declaration_node *const node, int lvl) {
+  tree_walker::do_declaration_node(node, lvl);
+  if (!_scopes.empty())
+    _scopes.back().insert(node->identifier());
+}
+
+void til::loop_invariants::do_loop_node(til::loop_node *const node, int lvl) {
+  effects body;
+  effects_collector collector(_compiler, body);
+  node->condition()->accept(&collector, 0); // evaluated on every iteration too
+  node->instruction()->accept(&collector, 0);
+
+  // outer loops first: what they hoist is not hoisted again by inner ones
+  _loops.push_back(node);
+  candidate_finder finder(_compiler, [&](cdk::typed_node *expression) {
+    return hoist(expression, node, body);
+  });
+  node->instruction()->accept(&finder, 0);
+
+  walk(node->instruction(), lvl + 2);
+}
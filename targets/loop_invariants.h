@@ -0,0 +1,94 @@
+#ifndef __TIL_TARGETS_LOOP_INVARIANTS_H__
+#define __TIL_TARGETS_LOOP_INVARIANTS_H__
+
+#include "targets/tree_walker.h"
+#include "targets/constant_folder.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Find the expressions of loop bodies that compute the same value on every
+   * iteration, to be evaluated once, before the loop, into a temporary.
+   *
+   * An expression is invariant if it reads no variable assigned or declared
+   * in the loop, and no memory. Globals and variables whose address is taken
+   * are only stable in loops without calls or stores through pointers. Only
+   * the largest invariant additions, subtractions, multiplications and
+   * element addresses are hoisted; divisions are not (they may trap on paths
+   * the loop does not take). Loop conditions are evaluated as before.
+   *
+   * Set TIL_NO_LICM in the environment to hoist nothing.
+   */
+  class loop_invariants: public tree_walker {
+  public:
+    /** What the loop body changes. */
+    struct effects {
+      std::unordered_set<std::string> assigned;
+      std::unordered_set<std::string> declared;
+      bool calls = false;
+      bool stores = false; // through pointers
+    };
+
+  private:
+    const til::constant_folder &_folder;
+    bool _enabled;
+
+    std::unordered_set<std::string> _addressed; // variables whose address is taken
+    std::vector<std::unordered_set<std::string>> _scopes; // locals in scope
+
+    std::unordered_map<const til::loop_node *, std::vector<cdk::typed_node *>> _hoisted;
+    std::unordered_set<const cdk::typed_node *> _expressions; // hoisted, in any loop
+    std::vector<const til::loop_node *> _loops; // in program order (report)
+
+  public:
+    loop_invariants(std::shared_ptr<cdk::compiler> compiler, const til::constant_folder &folder);
+
+  public:
+    /** Analyse every loop of the program. */
+    void analyse(cdk::basic_node *root);
+
+    /** The expressions evaluated before the loop (in order). */
+    const std::vector<cdk::typed_node *> &hoisted(const til::loop_node *loop) const;
+
+    bool is_hoisted(const cdk::typed_node *node) const {
+      return _expressions.count(node) > 0;
+    }
+
+    /** Whether the hoisted expression is an element address (not a value). */
+    static bool is_address(cdk::typed_node *node);
+
+    /** Bytes of the temporary holding the expression. */
+    static size_t temporary_size(cdk::typed_node *node);
+
+    size_t count() const {
+      return _expressions.size();
+    }
+
+    /** Print the number of expressions hoisted out of each loop. */
+    void report(std::ostream &os) const;
+
+  private:
+    bool stable(const std::string &name, const effects &body) const;
+    bool invariant(cdk::basic_node *node, const effects &body) const;
+    bool address_invariant(cdk::basic_node *node, const effects &body) const;
+
+    /** Hoist the expression out of the loop if it is invariant (true if hoisted now or before). */
+    bool hoist(cdk::typed_node *node, const til::loop_node *loop, const effects &body);
+
+  public:
+    void do_function_node(til::function_node *const node, int lvl);
+    void do_block_node(til::block_node *const node, int lvl);
+    void do_declaration_node(til::declaration_node *const node, int lvl);
+    void do_loop_node(til::loop_node *const node, int lvl);
+
+  };
+
+} // til
+
+#endif
@@ -0,0 +1,107 @@
+#include "targets/pass_report.h"
+#include "node_arena.h"
+#include "string_table.h"
+#include <cstdlib>
+#include <iomanip>
+
+//---------------------------------------------------------------------------
+
+size_t til::pass_report::allocated_bytes() {
+  return til::node_arena::allocated_bytes() + til::string_table::instance().bytes();
+}
+
+//---------------------------------------------------------------------------
+
+void til::pass_report::start(const std::string &name) {
+  size_t index = 0;
+  while (index < _phases.size() && _phases[index].name != name)
+    index++;
+  if (index == _phases.size()) {
+    _phases.emplace_back();
+    _phases.back().name = name;
+  }
+
+  _running.push_back({index, clock::now(), allocated_bytes()});
+}
+
+void til::pass_report::stop(size_t visits) {
+  if (_running.empty())
+    return;
+
+  running current = _running.back();
+  _running.pop_back();
+
+  double seconds = std::chrono::duration<double>(clock::now() - current.start).count();
+  size_t bytes = allocated_bytes() - current.bytes;
+
+  auto &p = _phases[current.index];
+  p.runs++;
+  p.seconds += seconds - current.child_seconds;
+  p.bytes += bytes - current.child_bytes;
+  p.visits += visits;
+
+  if (!_running.empty()) {
+    _running.back().child_seconds += seconds;
+    _running.back().child_bytes += bytes;
+  }
+}
+
+void til::pass_report::stop_if_running(const std::string &name, size_t visits) {
+  if (!_running.empty() && _phases[_running.back().index].name == name)
+    stop(visits);
+}
+
+void til::pass_report::print_if_requested(std::ostream &os) const {
+  const char *format = std::getenv("TIL_TIME_PASSES");
+  if (format == nullptr)
+    return;
+
+  if (std::string(format) == "json")
+    print_json(os);
+  else
+    print_text(os);
+}
+
+void til::pass_report::print_text(std::ostream &os) const {
+  double total_seconds = 0;
+  size_t total_bytes = 0;
+  for (auto &p : _phases) {
+    total_seconds += p.seconds;
+    total_bytes += p.bytes;
+  }
+
+  os << "===-------------------------------------------------------------===" << std::endl;
+  os << "                      TIL compiler pass report" << std::endl;
+  os << "===-------------------------------------------------------------===" << std::endl;
+  os << std::left << std::setw(20) << "phase" << std::right << std::setw(6) << "runs"
+     << std::setw(12) << "wall (ms)" << std::setw(8) << "%" << std::setw(10) << "visits"
+     << std::setw(14) << "bytes" << std::endl;
+  for (auto &p : _phases) {
+    os << std::left << std::setw(20) << p.name << std::right << std::setw(6) << p.runs
+       << std::setw(12) << std::fixed << std::setprecision(3) << p.seconds * 1e3
+       << std::setw(8) << std::setprecision(1)
+       << (total_seconds > 0 ? 100 * p.seconds / total_seconds : 0.0)
+       << std::setw(10) << p.visits << std::setw(14) << p.bytes << std::endl;
+  }
+  os << std::left << std::setw(20) << "total" << std::right << std::setw(6) << ""
+     << std::setw(12) << std::setprecision(3) << total_seconds * 1e3 << std::setw(8) << "100.0"
+     << std::setw(10) << "" << std::setw(14) << total_bytes << std::endl;
+  os.unsetf(std::ios::floatfield);
+}
+
+void til::pass_report::print_json(std::ostream &os) const {
+  os << "{\"passes\": [";
+  for (size_t i = 0; i < _phases.size(); i++) {
+    auto &p = _phases[i];
+    os << (i > 0 ? ", " : "") << "{\"name\": \"" << p.name << "\", \"runs\": " << p.runs
+       << ", \"wall_ms\": " << std::fixed << std::setprecision(3) << p.seconds * 1e3
+       << ", \"visits\": " << p.visits << ", \"bytes\": " << p.bytes << "}";
+  }
+  os << "]}" << std::endl;
+  os.unsetf(std::ios::floatfield);
+}
+
+til::pass_report &til::pass_report::instance() {
+  static pass_report report;
+  return report;
+}
@@ -0,0 +1,93 @@
+#ifndef __TIL_TARGETS_PASS_REPORT_H__
+#define __TIL_TARGETS_PASS_REPORT_H__
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Per-phase compile time report (wall time, node visits, bytes).
+   *
+   * Visits are counted by each pass: the parser reports nodes created, the
+   * type checker reports node visits, and the writers report sequence items.
+   * Bytes are those the compiler accounts for itself: tree nodes (see
+   * node_arena) and interned strings (see string_table).
+   *
+   * Phases nest: a phase started while another runs is charged separately and
+   * its cost is not counted in the enclosing one. The report is printed by the
+   * targets when TIL_TIME_PASSES is set in the environment ("json" selects the
+   * machine-readable variant; anything else gives a table).
+   */
+  class pass_report {
+    typedef std::chrono::steady_clock clock;
+
+  public:
+    struct phase {
+      std::string name;
+      size_t runs = 0;
+      double seconds = 0;
+      size_t visits = 0;
+      size_t bytes = 0;
+    };
+
+  private:
+    struct running {
+      size_t index;
+      clock::time_point start;
+      size_t bytes;
+      double child_seconds = 0;
+      size_t child_bytes = 0;
+    };
+
+    std::vector<phase> _phases; // in order of first appearance
+    std::vector<running> _running;
+
+  public:
+    void start(const std::string &name);
+    void stop(size_t visits = 0);
+
+    /** Stop the given phase if it is the one running (e.g. parsing). */
+    void stop_if_running(const std::string &name, size_t visits = 0);
+
+    const std::vector<phase> &phases() const {
+      return _phases;
+    }
+
+    /** Print the report if requested by TIL_TIME_PASSES. */
+    void print_if_requested(std::ostream &os) const;
+    void print_text(std::ostream &os) const;
+    void print_json(std::ostream &os) const;
+
+  public:
+    static pass_report &instance();
+
+    /** Bytes allocated so far for nodes and interned strings. */
+    static size_t allocated_bytes();
+  };
+
+  /**
+   * Time a phase for the lifetime of the object.
+   */
+  class scoped_pass {
+    size_t _visits = 0;
+
+  public:
+    explicit scoped_pass(const std::string &name) {
+      pass_report::instance().start(name);
+    }
+    ~scoped_pass() {
+      pass_report::instance().stop(_visits);
+    }
+
+    void visits(size_t visits) {
+      _visits = visits;
+    }
+  };
+
+} // til
+
+#endif
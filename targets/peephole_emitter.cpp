@@ -0,0 +1,292 @@
+#include "targets/peephole_emitter.h"
+#include <cstdlib>
+#include <iomanip>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  typedef til::peephole_emitter::opcode opcode;
+
+  struct rule {
+    const char *name;
+    bool (til::peephole_emitter::*apply)();
+  };
+
+}
+
+// the peephole table (tried in order)
+#define TIL_RULES(X) \
+  X("store then trash",    store_then_trash) \
+  X("push then trash",     push_then_trash) \
+  X("merge trash",         merge_trash) \
+  X("branch on zero test", branch_on_zero_test) \
+  X("compare then branch", compare_then_branch) \
+  X("jump to next",        jump_to_next) \
+  X("identity operation",  identity_operation) \
+  X("store then reload",   store_then_reload)
+
+namespace {
+#define TIL_RULE_NAME(name, method) name,
+  const char *const rule_names[] = { TIL_RULES(TIL_RULE_NAME) };
+#undef TIL_RULE_NAME
+  const size_t rule_count = sizeof(rule_names) / sizeof(rule_names[0]);
+
+  bool pushes_address(const til::peephole_emitter::instruction &instr) {
+    return instr.op == opcode::LOCAL || instr.op == opcode::ADDR;
+  }
+
+  bool same_address(const til::peephole_emitter::instruction &a, const til::peephole_emitter::instruction &b) {
+    return a.op == b.op && (a.op == opcode::LOCAL ? a.i == b.i : a.s == b.s);
+  }
+}
+
+//---------------------------------------------------------------------------
+
+til::peephole_emitter::peephole_emitter(std::shared_ptr<cdk::compiler> compiler,
+                                        cdk::basic_postfix_emitter &out) :
+    cdk::postfix_ix86_emitter(compiler), _out(out), _enabled(std::getenv("TIL_NO_PEEPHOLE") == nullptr),
+    _hits(rule_count, 0) {
+}
+
+til::peephole_emitter::~peephole_emitter() {
+  flush();
+}
+
+void til::peephole_emitter::record(instruction &&instr) {
+  _received++;
+  if (!_enabled) {
+    emit(instr);
+    return;
+  }
+
+  bool end_of_function = instr.op == opcode::RET;
+  _code.push_back(std::move(instr));
+  while (rewrite())
+    ;
+
+  if (end_of_function)
+    flush();
+}
+
+bool til::peephole_emitter::rewrite() {
+  size_t rule = 0;
+#define TIL_TRY_RULE(name, method) \
+  if (method()) { \
+    _hits[rule]++; \
+    return true; \
+  } \
+  rule++;
+  TIL_RULES(TIL_TRY_RULE)
+#undef TIL_TRY_RULE
+  return false;
+}
+
+void til::peephole_emitter::flush() {
+  for (auto &instr : _code)
+    emit(instr);
+  _code.clear();
+}
+
+void til::peephole_emitter::emit(const instruction &instr) {
+  _emitted++;
+  switch (instr.op) {
+#define TIL_EMIT(op) case opcode::op: _out.op(); break;
+    TIL_POSTFIX_OPS(TIL_EMIT)
+#undef TIL_EMIT
+#define TIL_EMIT(op) case opcode::op: _out.op(instr.s); break;
+    TIL_POSTFIX_LABEL_OPS(TIL_EMIT)
+#undef TIL_EMIT
+#define TIL_EMIT(op) case opcode::op: _out.op(instr.i); break;
+    TIL_POSTFIX_INT_OPS(TIL_EMIT)
+#undef TIL_EMIT
+#define TIL_EMIT(op) case opcode::op: _out.op(instr.d); break;
+    TIL_POSTFIX_DOUBLE_OPS(TIL_EMIT)
+#undef TIL_EMIT
+    case opcode::SSTRING: _out.SSTRING(instr.s); break;
+    case opcode::TEXT_NAMED: _out.TEXT(instr.s); break;
+    case opcode::GLOBAL: _out.GLOBAL(instr.s, instr.t); break;
+  }
+}
+
+void til::peephole_emitter::report(std::ostream &os) const {
+  os << "peephole: " << _received << " instructions in, " << _emitted << " out" << std::endl;
+  for (size_t rule = 0; rule < rule_count; rule++)
+    os << "  " << std::left << std::setw(24) << rule_names[rule] << std::right << std::setw(8) << _hits[rule]
+       << std::endl;
+}
+
+//---------------------------------------------------------------------------
+//     RULES
+//---------------------------------------------------------------------------
+
+void til::peephole_emitter::drop(size_t count) {
+  _code.erase(_code.end() - count, _code.end());
+}
+
+// DUP32; LOCAL n; STINT; TRASH 4 -> LOCAL n; STINT (assignment as a statement)
+bool til::peephole_emitter::store_then_trash() {
+  size_t n = _code.size();
+  if (n < 4)
+    return false;
+  auto &dup = _code[n - 4], &addr = _code[n - 3], &store = _code[n - 2], &trash = _code[n - 1];
+  if (trash.op != opcode::TRASH || !pushes_address(addr))
+    return false;
+  if (!(dup.op == opcode::DUP32 && store.op == opcode::STINT && trash.i == 4) &&
+      !(dup.op == opcode::DUP64 && store.op == opcode::STDOUBLE && trash.i == 8))
+    return false;
+
+  _code.erase(_code.end() - 4);
+  _code.pop_back();
+  return true;
+}
+
+// push (and load) of a value that is immediately discarded
+bool til::peephole_emitter::push_then_trash() {
+  size_t n = _code.size();
+  if (n < 2 || _code[n - 1].op != opcode::TRASH)
+    return false;
+
+  auto &push = _code[n - 2];
+  int size = 0, length = 1;
+  switch (push.op) {
+    case opcode::INT: case opcode::LOCAL: case opcode::ADDR: case opcode::DUP32: size = 4; break;
+    case opcode::DOUBLE: case opcode::DUP64: size = 8; break;
+    case opcode::LDINT: size = 4; length = 2; break;
+    case opcode::LDDOUBLE: size = 8; length = 2; break;
+    default: return false;
+  }
+  if (length == 2 && (n < 3 || !pushes_address(_code[n - 3])))
+    return false;
+  if (_code[n - 1].i < size)
+    return false;
+
+  int remaining = _code[n - 1].i - size;
+  drop(1 + length);
+  if (remaining > 0)
+    _code.push_back({ opcode::TRASH, remaining });
+  return true;
+}
+
+// TRASH a; TRASH b -> TRASH a+b, and TRASH 0 -> nothing
+bool til::peephole_emitter::merge_trash() {
+  size_t n = _code.size();
+  if (n < 1 || _code[n - 1].op != opcode::TRASH)
+    return false;
+  if (_code[n - 1].i == 0) {
+    _code.pop_back();
+    return true;
+  }
+  if (n < 2 || _code[n - 2].op != opcode::TRASH)
+    return false;
+  _code[n - 2].i += _code[n - 1].i;
+  _code.pop_back();
+  return true;
+}
+
+// INT 0; EQ; JZ l -> JNZ l (and friends: tests against zero need no compare)
+bool til::peephole_emitter::branch_on_zero_test() {
+  size_t n = _code.size();
+  if (n < 2)
+    return false;
+
+  auto &jump = _code[n - 1];
+  if (n >= 3 && _code[n - 3].op == opcode::INT && _code[n - 3].i == 0 &&
+      (jump.op == opcode::JZ || jump.op == opcode::JNZ)) {
+    auto test = _code[n - 2].op;
+    if (test != opcode::EQ && test != opcode::NE)
+      return false;
+    // (x == 0) is false exactly when x is not zero
+    bool negate = test == opcode::EQ;
+    opcode op = (jump.op == opcode::JZ) != negate ? opcode::JZ : opcode::JNZ;
+    std::string label = jump.s;
+    drop(3);
+    _code.push_back({ op, 0, 0, label });
+    return true;
+  }
+
+  // INT 0; JEQ l -> JZ l and INT 0; JNE l -> JNZ l
+  if (_code[n - 2].op == opcode::INT && _code[n - 2].i == 0 &&
+      (jump.op == opcode::JEQ || jump.op == opcode::JNE)) {
+    opcode op = jump.op == opcode::JEQ ? opcode::JZ : opcode::JNZ;
+    std::string label = jump.s;
+    drop(2);
+    _code.push_back({ op, 0, 0, label });
+    return true;
+  }
+  return false;
+}
+
+// LT; JZ l -> JGE l (a comparison consumed by a branch)
+bool til::peephole_emitter::compare_then_branch() {
+  size_t n = _code.size();
+  if (n < 2 || (_code[n - 1].op != opcode::JZ && _code[n - 1].op != opcode::JNZ))
+    return false;
+
+  opcode when_true, when_false;
+  switch (_code[n - 2].op) {
+    case opcode::EQ: when_true = opcode::JEQ; when_false = opcode::JNE; break;
+    case opcode::NE: when_true = opcode::JNE; when_false = opcode::JEQ; break;
+    case opcode::LT: when_true = opcode::JLT; when_false = opcode::JGE; break;
+    case opcode::LE: when_true = opcode::JLE; when_false = opcode::JGT; break;
+    case opcode::GT: when_true = opcode::JGT; when_false = opcode::JLE; break;
+    case opcode::GE: when_true = opcode::JGE; when_false = opcode::JLT; break;
+    default: return false;
+  }
+
+  opcode op = _code[n - 1].op == opcode::JNZ ? when_true : when_false;
+  std::string label = _code[n - 1].s;
+  drop(2);
+  _code.push_back({ op, 0, 0, label });
+  return true;
+}
+
+// JMP l; [ALIGN;] LABEL l -> [ALIGN;] LABEL l
+bool til::peephole_emitter::jump_to_next() {
+  size_t n = _code.size();
+  if (n < 2 || _code[n - 1].op != opcode::LABEL)
+    return false;
+
+  size_t jump = _code[n - 2].op == opcode::ALIGN ? n - 3 : n - 2;
+  if (jump >= n || _code[jump].op != opcode::JMP || _code[jump].s != _code[n - 1].s)
+    return false;
+  _code.erase(_code.begin() + jump);
+  return true;
+}
+
+// INT 0; ADD -> nothing and INT 1; MUL -> nothing (e.g., scaling by 1)
+bool til::peephole_emitter::identity_operation() {
+  size_t n = _code.size();
+  if (n < 2 || _code[n - 2].op != opcode::INT)
+    return false;
+
+  auto op = _code[n - 1].op;
+  int value = _code[n - 2].i;
+  if (!(value == 0 && (op == opcode::ADD || op == opcode::SUB)) &&
+      !(value == 1 && (op == opcode::MUL || op == opcode::DIV)))
+    return false;
+  drop(2);
+  return true;
+}
+
+// LOCAL n; STINT; LOCAL n; LDINT -> DUP32; LOCAL n; STINT (reuse the value)
+bool til::peephole_emitter::store_then_reload() {
+  size_t n = _code.size();
+  if (n < 4)
+    return false;
+  auto &addr = _code[n - 4], &store = _code[n - 3], &again = _code[n - 2], &load = _code[n - 1];
+  if (!pushes_address(addr) || !same_address(addr, again))
+    return false;
+
+  opcode dup;
+  if (store.op == opcode::STINT && load.op == opcode::LDINT)
+    dup = opcode::DUP32;
+  else if (store.op == opcode::STDOUBLE && load.op == opcode::LDDOUBLE)
+    dup = opcode::DUP64;
+  else
+    return false;
+
+  drop(2);
+  _code.insert(_code.end() - 2, instruction(dup));
+  return true;
+}
@@ -0,0 +1,140 @@
+#ifndef __TIL_TARGETS_PEEPHOLE_EMITTER_H__
+#define __TIL_TARGETS_PEEPHOLE_EMITTER_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cdk/emitters/postfix_ix86_emitter.h>
+
+// instructions buffered by the peephole emitter, by argument kind
+#define TIL_POSTFIX_OPS(X) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(NEG) \
+  X(DADD) X(DSUB) X(DMUL) X(DDIV) X(DNEG) X(DCMP) X(I2D) X(D2I) \
+  X(EQ) X(NE) X(LT) X(LE) X(GE) X(GT) X(AND) X(OR) X(XOR) X(NOT) \
+  X(SHTL) X(SHTRU) X(SHTRS) X(DUP32) X(DUP64) X(SWAP32) X(SWAP64) \
+  X(LDINT) X(STINT) X(LDDOUBLE) X(STDOUBLE) \
+  X(LDFVAL32) X(LDFVAL64) X(STFVAL32) X(STFVAL64) \
+  X(LEAVE) X(RET) X(BRANCH) X(ALLOC) X(SP) X(NOP) \
+  X(TEXT) X(DATA) X(RODATA) X(BSS) X(ALIGN)
+#define TIL_POSTFIX_LABEL_OPS(X) \
+  X(JMP) X(JZ) X(JNZ) X(JEQ) X(JNE) X(JLT) X(JLE) X(JGT) X(JGE) \
+  X(LABEL) X(CALL) X(ADDR) X(SADDR) X(EXTERN)
+#define TIL_POSTFIX_INT_OPS(X) \
+  X(INT) X(SINT) X(ENTER) X(TRASH) X(LOCAL) X(SALLOC)
+#define TIL_POSTFIX_DOUBLE_OPS(X) \
+  X(DOUBLE) X(SDOUBLE)
+
+namespace til {
+
+  /**
+   * Postfix emitter that rewrites the instruction stream before emitting it.
+   *
+   * Instructions are kept until the end of each function (RET) or an explicit
+   * flush. As each one arrives, the rules in the peephole table are tried on
+   * the last few instructions of the buffer, until none applies. The result is
+   * then replayed, in order, on the output emitter.
+   *
+   * Set TIL_NO_PEEPHOLE in the environment to emit every instruction as is.
+   */
+  class peephole_emitter: public cdk::postfix_ix86_emitter {
+  public:
+    enum class opcode {
+#define TIL_OPCODE(op) op,
+      TIL_POSTFIX_OPS(TIL_OPCODE)
+      TIL_POSTFIX_LABEL_OPS(TIL_OPCODE)
+      TIL_POSTFIX_INT_OPS(TIL_OPCODE)
+      TIL_POSTFIX_DOUBLE_OPS(TIL_OPCODE)
+#undef TIL_OPCODE
+      SSTRING, TEXT_NAMED, GLOBAL
+    };
+
+    struct instruction {
+      opcode op;
+      int i;
+      double d;
+      std::string s, t; // label, string or section name; symbol type
+
+      instruction(opcode op, int i = 0, double d = 0, const std::string &s = "", const std::string &t = "") :
+          op(op), i(i), d(d), s(s), t(t) {
+      }
+    };
+
+  private:
+    cdk::basic_postfix_emitter &_out;
+    bool _enabled;
+
+    std::vector<instruction> _code;
+    size_t _received = 0;
+    size_t _emitted = 0;
+    std::vector<size_t> _hits; // per rule
+
+  public:
+    /**
+     * @param out emitter receiving the rewritten instructions.
+     */
+    peephole_emitter(std::shared_ptr<cdk::compiler> compiler, cdk::basic_postfix_emitter &out);
+    ~peephole_emitter();
+
+  public:
+    /** Rewrite and emit everything buffered so far. */
+    void flush();
+
+    size_t received() const {
+      return _received;
+    }
+    size_t emitted() const {
+      return _emitted;
+    }
+
+    /** Print the number of times each rule was applied. */
+    void report(std::ostream &os) const;
+
+  public:
+#define TIL_DECLARE(op) void op() override { record({ opcode::op }); }
+    TIL_POSTFIX_OPS(TIL_DECLARE)
+#undef TIL_DECLARE
+#define TIL_DECLARE(op) void op(const std::string &label) override { record({ opcode::op, 0, 0, label }); }
+    TIL_POSTFIX_LABEL_OPS(TIL_DECLARE)
+#undef TIL_DECLARE
+#define TIL_DECLARE(op) void op(int value) override { record({ opcode::op, value }); }
+    TIL_POSTFIX_INT_OPS(TIL_DECLARE)
+#undef TIL_DECLARE
+#define TIL_DECLARE(op) void op(double value) override { record({ opcode::op, 0, value }); }
+    TIL_POSTFIX_DOUBLE_OPS(TIL_DECLARE)
+#undef TIL_DECLARE
+
+    void SSTRING(const std::string &value) override {
+      record({ opcode::SSTRING, 0, 0, value });
+    }
+    void TEXT(const std::string &section) override {
+      record({ opcode::TEXT_NAMED, 0, 0, section });
+    }
+    void GLOBAL(const std::string &label, const std::string &type) override {
+      record({ opcode::GLOBAL, 0, 0, label, type });
+    }
+
+  private:
+    void record(instruction &&instr);
+    void emit(const instruction &instr);
+
+    /** Remove the last instructions of the buffer. */
+    void drop(size_t count);
+
+    /** Try every rule on the end of the buffer (true if one applied). */
+    bool rewrite();
+
+    // rules (each looks at the end of the buffer)
+    bool store_then_trash();
+    bool push_then_trash();
+    bool merge_trash();
+    bool branch_on_zero_test();
+    bool compare_then_branch();
+    bool jump_to_next();
+    bool identity_operation();
+    bool store_then_reload();
+
+  };
+
+} // til
+
+#endif
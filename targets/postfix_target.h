@@ -4,8 +4,19 @@
 #include <cdk/targets/basic_target.h>
 #include <cdk/ast/basic_node.h>
 #include "targets/postfix_writer.h"
+#include "targets/front_end.h"
+#include "targets/inliner.h"
+#include "targets/literal_pool.h"
+#include "targets/loop_invariants.h"
+#include "targets/peephole_emitter.h"
+#include "targets/sse2_emitter.h"
+#include "targets/ir_postfix_backend.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
 
 #include <cdk/emitters/postfix_ix86_emitter.h>
+#include <cstdlib>
+#include <memory>
 
 namespace til {
 
@@ -19,17 +30,103 @@ namespace til {
 
   public:
     bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
+      // check, fold and prune the tree and resolve its calls
+      front_end front(compiler);
+      if (!front.analyse()) {
+        report.print_if_requested(std::cerr);
+        return false;
+      }
+      auto &folder = front.folder();
+      auto &resolver = front.resolver();
+
+      // expressions computed once per loop
+      loop_invariants invariants(compiler, folder);
+      {
+        til::scoped_pass pass("loop invariants");
+        invariants.analyse(compiler->ast());
+      }
+
+      // small callees are expanded at the call site (and lay out the frames)
+      inliner inliner(compiler, resolver, invariants);
+
+      // read-only literals are emitted once, at the end
+      literal_pool pool(compiler);
+      {
+        til::scoped_pass pass("literal pool");
+        pool.collect(compiler->ast());
+      }
+
       // this symbol table will be used to check identifiers
       // during code generation
-      cdk::symbol_table<til::symbol> symtab;
+      til::symbol_table symtab;
+
+      // this is the backend postfix machine (behind the peephole optimizer)
+      // TIL_SSE2: doubles computed with SSE2 instead of x87
+      std::unique_ptr<cdk::postfix_ix86_emitter> pf;
+      if (std::getenv("TIL_SSE2") != nullptr)
+        pf = std::make_unique<sse2_emitter>(compiler);
+      else
+        pf = std::make_unique<cdk::postfix_ix86_emitter>(compiler);
+      peephole_emitter peephole(compiler, *pf);
 
-      // this is the backend postfix machine
-      cdk::postfix_ix86_emitter pf(compiler);
+      // TIL_IR: generate the code from the intermediate representation
+      if (std::getenv("TIL_IR") != nullptr)
+        return generate_from_ir(compiler, front, pool, peephole);
 
       // generate assembly code from the syntax tree
-      postfix_writer writer(compiler, symtab, pf);
-      compiler->ast()->accept(&writer, 0);
+      postfix_writer writer(compiler, symtab, peephole, folder, resolver, inliner, pool, invariants);
+      {
+        til::scoped_pass pass("code generation");
+        compiler->ast()->accept(&writer, 0);
+        pool.emit(peephole); // also for modules without a program
+        peephole.flush();
+        pass.visits(writer.visits());
+      }
+      if (compiler->debug()) {
+        inliner.report(std::cerr);
+        std::cerr << "tail calls: " << writer.tail_calls() << std::endl;
+        invariants.report(std::cerr);
+        pool.report(std::cerr);
+        peephole.report(std::cerr);
+      }
+      {
+        til::scoped_pass pass("output");
+        compiler->ostream()->flush();
+      }
+
+      report.print_if_requested(std::cerr);
+      return true;
+    }
+
+  private:
+    bool generate_from_ir(std::shared_ptr<cdk::compiler> compiler, front_end &front, literal_pool &pool,
+                          peephole_emitter &peephole) {
+      auto &report = til::pass_report::instance();
+
+      auto module = front.build_ir(4);
+      if (module == nullptr)
+        return false;
+
+      ir_postfix_backend backend(peephole, pool);
+      {
+        til::scoped_pass pass("code generation");
+        backend.emit(*module);
+        peephole.flush();
+      }
+      if (compiler->debug()) {
+        backend.report(std::cerr);
+        peephole.report(std::cerr);
+      }
+      {
+        til::scoped_pass pass("output");
+        compiler->ostream()->flush();
+      }
 
+      report.print_if_requested(std::cerr);
       return true;
     }
 
@@ -1,14 +1,106 @@
+#include <algorithm>
 #include <string>
 #include <sstream>
-#include "targets/type_checker.h"
 #include "targets/postfix_writer.h"
 #include "targets/frame_size_calculator.h"
+#include "targets/pass_report.h"
+#include "targets/tree_walker.h"
+#include "interned_nodes.h"
+#include "type_table.h"
 #include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
 
 #include "til_parser.tab.h"
 
 //---------------------------------------------------------------------------
 
+namespace {
+
+  /** Whether addresses into the frame may escape (address-of, objects). */
+  class frame_escape_finder: public til::tree_walker {
+  public:
+    bool found = false;
+
+    frame_escape_finder(std::shared_ptr<cdk::compiler> compiler) :
+        til::tree_walker(compiler) {
+    }
+
+    void do_address_of_node(til::address_of_node *const node, int lvl) {
+      found = true;
+    }
+    void do_stack_alloc_node(til::stack_alloc_node *const node, int lvl) {
+      found = true;
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      // another frame
+    }
+  };
+
+}
+
+bool til::postfix_writer::frame_escapes(til::function_node *const node) {
+  frame_escape_finder finder(_compiler);
+  node->block()->accept(&finder, 0);
+  return finder.found;
+}
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  /** Whether evaluating an expression may change state or produce output. */
+  class side_effect_finder: public til::tree_walker {
+  public:
+    bool found = false;
+
+    side_effect_finder(std::shared_ptr<cdk::compiler> compiler) :
+        til::tree_walker(compiler) {
+    }
+
+    void do_function_call_node(til::function_call_node *const node, int lvl) {
+      found = true;
+    }
+    void do_read_node(til::read_node *const node, int lvl) {
+      found = true;
+    }
+    void do_assignment_node(cdk::assignment_node *const node, int lvl) {
+      found = true;
+    }
+    void do_function_node(til::function_node *const node, int lvl) {
+      // not run here
+    }
+  };
+
+}
+
+bool til::postfix_writer::has_side_effects(cdk::basic_node *const node) {
+  side_effect_finder finder(_compiler);
+  node->accept(&finder, 0);
+  return finder.found;
+}
+
+//---------------------------------------------------------------------------
+
+bool til::postfix_writer::emit_folded(cdk::expression_node *const node) {
+  auto value = _folder.value(node);
+  if (value == nullptr)
+    return false;
+
+  if (node->is_typed(cdk::TYPE_DOUBLE)) {
+    if (in_function())
+      push_double(value->as_double());
+    else
+      _pf.SDOUBLE(value->as_double());
+  } else {
+    if (in_function())
+      _pf.INT(value->i);
+    else
+      _pf.SINT(value->i);
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
 void til::postfix_writer::do_nil_node(cdk::nil_node * const node, int lvl) {
   // EMPTY
 }
@@ -17,14 +109,14 @@ void til::postfix_writer::do_data_node(cdk::data_node * const node, int lvl) {
 }
 
 void til::postfix_writer::do_not_node(cdk::not_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
+  if (emit_folded(node)) return;
   node->argument()->accept(this, lvl + 2);
   _pf.INT(0);
   _pf.EQ();
 }
 
 void til::postfix_writer::do_unary_minus_node(cdk::unary_minus_node* const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
+  if (emit_folded(node)) return;
   node->argument()->accept(this, lvl + 2);
   if (node->is_typed(cdk::TYPE_INT)) {
     _pf.NEG();
@@ -34,40 +126,94 @@ void til::postfix_writer::do_unary_minus_node(cdk::unary_minus_node* const node,
 }
 
 void til::postfix_writer::do_unary_plus_node(cdk::unary_plus_node* const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
+  if (emit_folded(node)) return;
   node->argument()->accept(this, lvl + 2);
 }
 
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_and_node(cdk::and_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-  auto lbl = mklbl(++_lbl);
-  node->left()->accept(this, lvl + 2);
-  _pf.DUP32();
-  _pf.JZ(lbl);
-  node->right()->accept(this, lvl + 2);
-  _pf.AND();
-  _pf.ALIGN();
-  _pf.LABEL(lbl);
+  if (emit_folded(node)) return;
+  emit_condition_value(node, lvl);
 }
 
 void til::postfix_writer::do_or_node(cdk::or_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-  auto lbl = mklbl(++_lbl);
-  node->left()->accept(this, lvl + 2);
-  _pf.DUP32();
-  _pf.JNZ(lbl);
-  node->right()->accept(this, lvl + 2);
-  _pf.OR();
-  _pf.ALIGN();
-  _pf.LABEL(lbl);
+  if (emit_folded(node)) return;
+  emit_condition_value(node, lvl);
+}
+
+//---------------------------------------------------------------------------
+
+void til::postfix_writer::branch_if(cdk::expression_node *const condition, bool when,
+                                    const std::string &lbl, int lvl) {
+  if (auto value = _folder.value(condition)) {
+    if ((value->i != 0) == when)
+      _pf.JMP(lbl);
+    return;
+  }
+
+  if (auto node = dynamic_cast<cdk::not_node *>(condition)) {
+    branch_if(node->argument(), !when, lbl, lvl + 2);
+  } else if (auto node = dynamic_cast<cdk::and_node *>(condition)) {
+    if (!when) {
+      branch_if(node->left(), false, lbl, lvl + 2);
+      branch_if(node->right(), false, lbl, lvl + 2);
+    } else {
+      auto skip = mklbl(++_lbl);
+      branch_if(node->left(), false, skip, lvl + 2);
+      branch_if(node->right(), true, lbl, lvl + 2);
+      _pf.LABEL(skip);
+    }
+  } else if (auto node = dynamic_cast<cdk::or_node *>(condition)) {
+    if (when) {
+      branch_if(node->left(), true, lbl, lvl + 2);
+      branch_if(node->right(), true, lbl, lvl + 2);
+    } else {
+      auto skip = mklbl(++_lbl);
+      branch_if(node->left(), true, skip, lvl + 2);
+      branch_if(node->right(), false, lbl, lvl + 2);
+      _pf.LABEL(skip);
+    }
+  } else if (auto node = dynamic_cast<cdk::lt_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JLT(lbl); else _pf.JGE(lbl);
+  } else if (auto node = dynamic_cast<cdk::le_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JLE(lbl); else _pf.JGT(lbl);
+  } else if (auto node = dynamic_cast<cdk::gt_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JGT(lbl); else _pf.JLE(lbl);
+  } else if (auto node = dynamic_cast<cdk::ge_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JGE(lbl); else _pf.JLT(lbl);
+  } else if (auto node = dynamic_cast<cdk::eq_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JEQ(lbl); else _pf.JNE(lbl);
+  } else if (auto node = dynamic_cast<cdk::ne_node *>(condition)) {
+    pre_process_logical_binary_expr(node, lvl);
+    if (when) _pf.JNE(lbl); else _pf.JEQ(lbl);
+  } else {
+    condition->accept(this, lvl);
+    if (when) _pf.JNZ(lbl); else _pf.JZ(lbl);
+  }
+}
+
+void til::postfix_writer::emit_condition_value(cdk::expression_node *const condition, int lvl) {
+  auto false_lbl = mklbl(++_lbl);
+  auto end_lbl = mklbl(++_lbl);
+  branch_if(condition, false, false_lbl, lvl);
+  _pf.INT(1);
+  _pf.JMP(end_lbl);
+  _pf.LABEL(false_lbl);
+  _pf.INT(0);
+  _pf.LABEL(end_lbl);
 }
 
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_sequence_node(cdk::sequence_node * const node, int lvl) {
   for (size_t i = 0; i < node->size(); i++) {
+    _visits++;
     node->node(i)->accept(this, lvl);
   }
 }
@@ -84,63 +230,118 @@ void til::postfix_writer::do_integer_node(cdk::integer_node * const node, int lv
 
 void til::postfix_writer::do_double_node(cdk::double_node * const node, int lvl) {
   if (in_function()) {
-    _pf.DOUBLE(node->value());
+    push_double(node->value());
   } else {
     _pf.SDOUBLE(node->value());
   }
 }
 
 void til::postfix_writer::do_string_node(cdk::string_node * const node, int lvl) {
-  int lbl = ++_lbl;
-
-  /* generate the string */
-  _pf.RODATA(); // strings are DATA readonly
-  _pf.ALIGN(); // make sure we are aligned
-  _pf.LABEL(mklbl(lbl)); // give the string a name
-  _pf.SSTRING(node->value()); // output string characters
-
+  // the characters are in the literal pool (emitted with the program)
+  auto address = _pool.string_address(node->value());
   if (!in_function()) {
     _pf.DATA();
-    _pf.SADDR(mklbl(lbl));
+    _pf.SADDR(address);
   } else {
-    /* put the address in the stack */
-    _pf.TEXT(_function_lbls.top());
-    _pf.ADDR(mklbl(lbl));
+    _pf.ADDR(address); // put the address in the stack
   }
 }
 
+bool til::postfix_writer::load_hoisted(cdk::typed_node *const node) {
+  if (node == _hoisting || !_inlining.empty() || !_invariants.is_hoisted(node))
+    return false;
+  _pf.LOCAL(_temporaries.at(node));
+  if (!til::loop_invariants::is_address(node) && node->is_typed(cdk::TYPE_DOUBLE))
+    _pf.LDDOUBLE();
+  else
+    _pf.LDINT(); // values and element addresses
+  return true;
+}
+
+void til::postfix_writer::push_double(double value) {
+  _pf.ADDR(_pool.double_label(value));
+  _pf.LDDOUBLE();
+}
+
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::pre_process_int_double_pointer_binary_expr(
     cdk::binary_operation_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-  node->left()->accept(this, lvl + 2);
-  if (node->is_typed(cdk::TYPE_DOUBLE) &&
-      !node->left()->is_typed(cdk::TYPE_DOUBLE))
-    _pf.I2D();
-  else if (node->is_typed(cdk::TYPE_POINTER) &&
-           !node->left()->is_typed(cdk::TYPE_POINTER)) {
+  if (node->is_typed(cdk::TYPE_POINTER) &&
+      !node->left()->is_typed(cdk::TYPE_POINTER)) {
     const auto ref_right =
         cdk::reference_type::cast(node->right()->type())->referenced();
-    _pf.INT(std::max(
-        1, static_cast<int>(ref_right->size())));
-    _pf.MUL();
+    push_scaled(node->left(), ref_right->size(), lvl + 2);
+  } else {
+    node->left()->accept(this, lvl + 2);
+    if (node->is_typed(cdk::TYPE_DOUBLE) &&
+        !node->left()->is_typed(cdk::TYPE_DOUBLE))
+      _pf.I2D();
   }
 
-  node->right()->accept(this, lvl + 2);
-  if (node->is_typed(cdk::TYPE_DOUBLE) &&
-      !node->right()->is_typed(cdk::TYPE_DOUBLE))
-    _pf.I2D();
-  else if (node->is_typed(cdk::TYPE_POINTER) &&
-           !node->right()->is_typed(cdk::TYPE_POINTER)) {
+  if (node->is_typed(cdk::TYPE_POINTER) &&
+      !node->right()->is_typed(cdk::TYPE_POINTER)) {
     const auto ref_left =
         cdk::reference_type::cast(node->left()->type())->referenced();
-    _pf.INT(std::max(
-        1, static_cast<int>(ref_left->size())));
+    push_scaled(node->right(), ref_left->size(), lvl + 2);
+  } else {
+    node->right()->accept(this, lvl + 2);
+    if (node->is_typed(cdk::TYPE_DOUBLE) &&
+        !node->right()->is_typed(cdk::TYPE_DOUBLE))
+      _pf.I2D();
+  }
+}
+
+//---------------------------------------------------------------------------
+
+int til::postfix_writer::log2_of(cdk::expression_node *const node) {
+  if (!node->is_typed(cdk::TYPE_INT))
+    return -1;
+  auto value = _folder.value(node);
+  if (value == nullptr || value->i <= 0 || (value->i & (value->i - 1)) != 0)
+    return -1;
+  int k = 0;
+  while ((1 << k) != value->i)
+    k++;
+  return k;
+}
+
+void til::postfix_writer::scale(size_t size) {
+  if (size <= 1)
+    return;
+  if ((size & (size - 1)) == 0) {
+    int k = 0;
+    while ((size_t(1) << k) != size)
+      k++;
+    _pf.INT(k);
+    _pf.SHTL();
+  } else {
+    _pf.INT(size);
     _pf.MUL();
   }
 }
+
+void til::postfix_writer::push_scaled(cdk::expression_node *const node, size_t size, int lvl) {
+  if (auto value = _folder.value(node)) {
+    _pf.INT(static_cast<int>(static_cast<unsigned>(value->i) * std::max(size_t(1), size)));
+  } else {
+    node->accept(this, lvl);
+    scale(size);
+  }
+}
+
+// signed division by 2^k rounds towards zero: negative dividends are biased
+// by 2^k - 1 (the sign bits shifted right, unsigned) before the shift
+void til::postfix_writer::push_biased(int k) {
+  _pf.DUP32();
+  _pf.INT(31);
+  _pf.SHTRS();
+  _pf.INT(32 - k);
+  _pf.SHTRU();
+  _pf.ADD();
+}
 void til::postfix_writer::do_add_node(cdk::add_node *const node, int lvl) {
+  if (emit_folded(node) || load_hoisted(node)) return;
   pre_process_int_double_pointer_binary_expr(node, lvl);
 
   if (!node->is_typed(cdk::TYPE_DOUBLE))
@@ -150,6 +351,7 @@ void til::postfix_writer::do_add_node(cdk::add_node *const node, int lvl) {
 }
 
 void til::postfix_writer::do_sub_node(cdk::sub_node *const node, int lvl) {
+  if (emit_folded(node) || load_hoisted(node)) return;
   pre_process_int_double_pointer_binary_expr(node, lvl);
 
   if (!node->is_typed(cdk::TYPE_DOUBLE)) {
@@ -159,10 +361,20 @@ void til::postfix_writer::do_sub_node(cdk::sub_node *const node, int lvl) {
          node->right()->is_typed(cdk::TYPE_POINTER)) &&
         cdk::reference_type::cast(node->left()->type())->referenced()->name() !=
             cdk::TYPE_VOID) {
-      _pf.INT(cdk::reference_type::cast(node->left()->type())
-                  ->referenced()
-                  ->size());
-      _pf.DIV();
+      // the difference is a multiple of the size: no rounding needed
+      auto size = cdk::reference_type::cast(node->left()->type())->referenced()->size();
+      if ((size & (size - 1)) == 0) {
+        int k = 0;
+        while ((size_t(1) << k) != size)
+          k++;
+        if (k > 0) {
+          _pf.INT(k);
+          _pf.SHTRS();
+        }
+      } else {
+        _pf.INT(size);
+        _pf.DIV();
+      }
     }
   } else {
     _pf.DSUB();
@@ -173,7 +385,6 @@ void til::postfix_writer::do_sub_node(cdk::sub_node *const node, int lvl) {
 
 void til::postfix_writer::pre_process_int_double_binary_expr(
     cdk::binary_operation_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   node->left()->accept(this, lvl + 2);
   if (node->is_typed(cdk::TYPE_DOUBLE) &&
       !node->left()->is_typed(cdk::TYPE_DOUBLE))
@@ -186,6 +397,24 @@ void til::postfix_writer::pre_process_int_double_binary_expr(
 }
 
 void til::postfix_writer::do_mul_node(cdk::mul_node *const node, int lvl) {
+  if (emit_folded(node) || load_hoisted(node)) return;
+  if (node->is_typed(cdk::TYPE_INT)) {
+    // multiplication by 2^k is a shift
+    int k = log2_of(node->right());
+    auto other = node->left();
+    if (k < 0) {
+      k = log2_of(node->left());
+      other = node->right();
+    }
+    if (k >= 0) {
+      other->accept(this, lvl + 2);
+      if (k > 0) {
+        _pf.INT(k);
+        _pf.SHTL();
+      }
+      return;
+    }
+  }
   pre_process_int_double_binary_expr(node, lvl);
 
   if (!node->is_typed(cdk::TYPE_DOUBLE))
@@ -195,6 +424,17 @@ void til::postfix_writer::do_mul_node(cdk::mul_node *const node, int lvl) {
 }
 
 void til::postfix_writer::do_div_node(cdk::div_node *const node, int lvl) {
+  if (emit_folded(node)) return;
+  int k = node->is_typed(cdk::TYPE_INT) ? log2_of(node->right()) : -1;
+  if (k >= 0) {
+    node->left()->accept(this, lvl + 2);
+    if (k > 0) {
+      push_biased(k);
+      _pf.INT(k);
+      _pf.SHTRS();
+    }
+    return;
+  }
   pre_process_int_double_binary_expr(node, lvl);
 
   if (!node->is_typed(cdk::TYPE_DOUBLE))
@@ -204,7 +444,18 @@ void til::postfix_writer::do_div_node(cdk::div_node *const node, int lvl) {
 }
 
 void til::postfix_writer::do_mod_node(cdk::mod_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
+  if (emit_folded(node)) return;
+  int k = log2_of(node->right());
+  if (k > 0) {
+    // x % 2^k == x - ((x + bias) & -2^k), with the sign of x
+    node->left()->accept(this, lvl);
+    _pf.DUP32();
+    push_biased(k);
+    _pf.INT(-(1 << k));
+    _pf.AND();
+    _pf.SUB();
+    return;
+  }
   node->left()->accept(this, lvl);
   node->right()->accept(this, lvl);
   _pf.MOD();
@@ -214,7 +465,6 @@ void til::postfix_writer::do_mod_node(cdk::mod_node *const node, int lvl) {
 
 void til::postfix_writer::pre_process_logical_binary_expr(
     cdk::binary_operation_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   node->left()->accept(this, lvl + 2);
   if (!node->left()->is_typed(cdk::TYPE_DOUBLE) &&
       node->right()->is_typed(cdk::TYPE_DOUBLE))
@@ -233,31 +483,37 @@ void til::postfix_writer::pre_process_logical_binary_expr(
 }
 
 void til::postfix_writer::do_lt_node(cdk::lt_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.LT();
 }
 
 void til::postfix_writer::do_le_node(cdk::le_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.LE();
 }
 
 void til::postfix_writer::do_ge_node(cdk::ge_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.GE();
 }
 
 void til::postfix_writer::do_gt_node(cdk::gt_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.GT();
 }
 
 void til::postfix_writer::do_ne_node(cdk::ne_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.NE();
 }
 
 void til::postfix_writer::do_eq_node(cdk::eq_node *const node, int lvl) {
+  if (emit_folded(node)) return;
   pre_process_logical_binary_expr(node, lvl);
   _pf.EQ();
 }
@@ -265,10 +521,7 @@ void til::postfix_writer::do_eq_node(cdk::eq_node *const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_variable_node(cdk::variable_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-
-  const std::string &id = node->name();
-  auto symbol = _symtab.find(id);
+  auto symbol = _symtab.find(til::handle_of(node));
   if (symbol->is_global()) {
     _pf.ADDR(symbol->name());
   } else {
@@ -277,7 +530,16 @@ void til::postfix_writer::do_variable_node(cdk::variable_node * const node, int
 }
 
 void til::postfix_writer::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
+  // an external function has no variable: its value is its address
+  if (auto variable = dynamic_cast<cdk::variable_node *>(node->lvalue())) {
+    auto symbol = _symtab.find(til::handle_of(variable));
+    if (symbol && symbol->qualifier() == tEXTERNAL) {
+      _external_funcs.insert(symbol->name());
+      _pf.ADDR(symbol->name());
+      return;
+    }
+  }
+
   node->lvalue()->accept(this, lvl);
 
   if (node->is_typed(cdk::TYPE_DOUBLE)) {
@@ -288,7 +550,6 @@ void til::postfix_writer::do_rvalue_node(cdk::rvalue_node * const node, int lvl)
 }
 
 void til::postfix_writer::do_assignment_node(cdk::assignment_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   node->rvalue()->accept(this, lvl); // determine the new value
   if (node->is_typed(cdk::TYPE_DOUBLE)) {
     if (node->rvalue()->is_typed(cdk::TYPE_INT))
@@ -307,12 +568,13 @@ void til::postfix_writer::do_assignment_node(cdk::assignment_node * const node,
 }
 
 void til::postfix_writer::do_index_node(til::index_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-
+  if (load_hoisted(node)) return;
   node->base()->accept(this, lvl + 2);
-  node->index()->accept(this, lvl + 2);
-  _pf.INT(node->type()->size());
-  _pf.MUL();
+  // constant indices become a constant offset (none for the first element)
+  auto index = _folder.value(node->index());
+  if (index != nullptr && index->i == 0)
+    return;
+  push_scaled(node->index(), node->type()->size(), lvl + 2);
   _pf.ADD();
 }
 
@@ -327,20 +589,28 @@ void til::postfix_writer::do_program_node(til::program_node * const node, int lv
 
   _function_lbls.push("_main");
   // treated as just line any other function
-  auto prog_symbol = til::make_symbol("_main", cdk::functional_type::create(cdk::primitive_type::create(4, cdk::TYPE_INT)), tPRIVATE);
-  if (!_symtab.insert("_main", prog_symbol)) {
-    _symtab.replace("_main", prog_symbol);
+  auto prog_symbol = til::make_symbol(til::symbol_table::program_name(),
+                                      til::make_functional_type(til::make_primitive_type(4, cdk::TYPE_INT)), tPRIVATE);
+  if (!_symtab.insert(prog_symbol->handle(), prog_symbol)) {
+    _symtab.replace(prog_symbol->handle(), prog_symbol);
   }
 
-  frame_size_calculator fsc(_compiler, _symtab);
-  node->accept(&fsc, lvl);
-  _pf.ENTER(fsc.localsize());
+  frame_size_calculator fsc(_compiler, _symtab, &_invariants);
+  {
+    til::scoped_pass pass("frame size");
+    node->accept(&fsc, lvl);
+    pass.visits(fsc.visits());
+  }
+  _local_offsets.insert(fsc.offsets().begin(), fsc.offsets().end());
+  _temporaries.insert(fsc.temporaries().begin(), fsc.temporaries().end());
+  _frame_base = 0;
+  _frame_peak = fsc.localsize();
+  _pf.ENTER(fsc.localsize() + _inliner.inline_area(node->block()));
 
   _symtab.push();
   auto ret_lbl = mklbl(++_lbl);
   _current_function_ret_lbl = ret_lbl;
 
-  _offset = 0;
   node->block()->accept(this, lvl + 2);
 
   // end the main function
@@ -360,13 +630,22 @@ void til::postfix_writer::do_program_node(til::program_node * const node, int lv
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_function_node(til::function_node *const node, int lvl) {
-  auto func_lbl = mklbl(++_lbl);
+  auto func_lbl = function_label(node);
+
+  // the code of a nested function is emitted in place: jump over it
+  const bool nested = in_function();
+  std::string skip_lbl;
+  if (nested) {
+    skip_lbl = mklbl(++_lbl);
+    _pf.JMP(skip_lbl);
+  }
+
   _function_lbls.push(func_lbl);
 
   // create function symbol in this context
-  auto function_sym = til::make_symbol("@", node->type(), tPRIVATE);
-  if (!_symtab.insert("@", function_sym)) {
-    _symtab.replace("@", function_sym);
+  auto function_sym = til::make_symbol(til::symbol_table::function_name(), node->type(), tPRIVATE);
+  if (!_symtab.insert(function_sym->handle(), function_sym)) {
+    _symtab.replace(function_sym->handle(), function_sym);
   }
   
   _functions.push(function_sym);
@@ -385,15 +664,24 @@ void til::postfix_writer::do_function_node(til::function_node *const node, int l
   _pf.LABEL(func_lbl);
 
   auto ret_lbl = mklbl(++_lbl);
-  auto prev_function_ret_lbl = _current_func_lbl;
+  auto prev_function_ret_lbl = _current_function_ret_lbl;
   _current_function_ret_lbl = ret_lbl;
-  /** Local variables handling */
-  frame_size_calculator fsc(_compiler, _symtab);
-  node->block()->accept(&fsc, lvl);
-  _pf.ENTER(fsc.localsize());
+  /** Local variables handling (the layout is shared with the expansions) */
+  const til::inliner::frame_layout *frame;
+  {
+    til::scoped_pass pass("frame size");
+    frame = &_inliner.frame(node);
+  }
+  _local_offsets.insert(frame->offsets.begin(), frame->offsets.end());
+  _temporaries.insert(frame->temporaries.begin(), frame->temporaries.end());
+  const int prev_frame_base = _frame_base, prev_frame_peak = _frame_peak;
+  _frame_base = 0;
+  _frame_peak = frame->size;
+  _pf.ENTER(frame->size + _inliner.inline_area(node->block()));
+  const bool prev_tail_calls_allowed = _tail_calls_allowed;
+  _tail_calls_allowed = !frame_escapes(node);
   _symtab.push();
 
-  _offset = 0; // local variables
   node->block()->accept(this, lvl + 2);
   _offset = prev_offset; // reset offset
 
@@ -407,21 +695,37 @@ void til::postfix_writer::do_function_node(til::function_node *const node, int l
   _function_lbls.pop();
   _functions.pop();
   _current_function_ret_lbl = prev_function_ret_lbl;
+  _frame_base = prev_frame_base;
+  _frame_peak = prev_frame_peak;
+  _tail_calls_allowed = prev_tail_calls_allowed;
+
+  // the value of a function literal is its address
+  if (nested) {
+    _pf.LABEL(skip_lbl);
+    _pf.ADDR(func_lbl);
+  } else {
+    _pf.DATA();
+    _pf.SADDR(func_lbl);
+  }
 }
 
 void til::postfix_writer::do_return_node(til::return_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-  auto symbol = _symtab.find("@"); // type checker ensures it exists 
-  if (symbol == nullptr) {
-    symbol = _symtab.find("_main");
+  // the function being generated (or expanded); "_main" outside functions
+  auto symbol = _functions.empty() ? _symtab.find(til::symbol_table::program_name()) : _functions.top();
+  auto output = cdk::functional_type::cast(symbol->type())->output(0);
+
+  if (auto call = dynamic_cast<til::function_call_node *>(node->ret_val())) {
+    if (emit_tail_call(call, lvl))
+      return;
   }
 
-  if (!symbol->is_typed(cdk::TYPE_VOID)) {
+  if (output->name() != cdk::TYPE_VOID && node->ret_val() != nullptr) {
     node->ret_val()->accept(this, lvl + 2);
-    if (!symbol->is_typed(cdk::TYPE_DOUBLE)) {
+    if (output->name() != cdk::TYPE_DOUBLE) {
       _pf.STFVAL32();
     } else {
-      _pf.I2D();
+      if (node->ret_val()->is_typed(cdk::TYPE_INT))
+        _pf.I2D();
       _pf.STFVAL64();
     }
   }
@@ -429,10 +733,59 @@ void til::postfix_writer::do_return_node(til::return_node *const node, int lvl)
   _pf.JMP(_current_function_ret_lbl);
 }
 
+// a call in tail position reuses the frame: the arguments overwrite the
+// caller's own (same size), the frame is left and the callee is entered with
+// a jump, so it returns directly to the caller's caller
+bool til::postfix_writer::emit_tail_call(til::function_call_node *const call, int lvl) {
+  if (!_tail_calls_allowed || !_inlining.empty())
+    return false;
+
+  auto caller_type = cdk::functional_type::cast(_functions.top()->type());
+  auto callee_type = caller_type;
+  std::string callee_lbl;
+  if (!call->func()) {
+    callee_lbl = _function_lbls.top(); // "@"
+  } else {
+    auto target = _resolver.target(call);
+    if (target == nullptr || target->function == nullptr)
+      return false;
+    auto callee = _inliner.candidate(call);
+    if (callee != nullptr && can_inline(callee))
+      return false; // expanding it is better still
+    callee_lbl = function_label(target->function);
+    callee_type = cdk::functional_type::cast(target->function->type());
+  }
+
+  // types are unique (type_table): identical types are the same object
+  if (caller_type->output(0) != callee_type->output(0))
+    return false;
+  size_t caller_args = 0, callee_args = 0;
+  for (size_t i = 0; i < caller_type->input()->length(); i++)
+    caller_args += caller_type->input(i)->size();
+  for (size_t i = 0; i < callee_type->input()->length(); i++)
+    callee_args += callee_type->input(i)->size();
+  if (caller_args != callee_args)
+    return false;
+
+  push_arguments(call, callee_type, lvl);
+  int offset = 8; // arguments start above the return address
+  for (size_t i = 0; i < callee_type->input()->length(); i++) {
+    _pf.LOCAL(offset);
+    if (callee_type->input(i)->name() == cdk::TYPE_DOUBLE)
+      _pf.STDOUBLE();
+    else
+      _pf.STINT();
+    offset += callee_type->input(i)->size();
+  }
+  _pf.LEAVE();
+  _pf.JMP(callee_lbl);
+  _tail_calls++;
+  return true;
+}
+
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_evaluation_node(til::evaluation_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   node->argument()->accept(this, lvl); // determine the value
   _pf.TRASH(node->argument()->type()->size());
 }
@@ -445,10 +798,33 @@ void til::postfix_writer::do_block_node(til::block_node *const node, int lvl) {
 }
 
 void til::postfix_writer::do_print_node(til::print_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-  auto args_vec = node->arguments()->nodes();
-  for (auto it = args_vec.rbegin(); it != args_vec.rend(); ++it) {
-    auto expr_node = dynamic_cast<cdk::expression_node *> (*it);
+  if (_bulk_print && !has_side_effects(node->arguments())) {
+    // one call for the whole instruction: tilprint(kinds, arg0, arg1, ...)
+    std::string kinds;
+    size_t args_size = 0;
+    auto &args = node->arguments()->nodes();
+    for (size_t i = args.size(); i-- > 0;) {
+      auto expr_node = dynamic_cast<cdk::expression_node *>(args[i]);
+      expr_node->accept(this, lvl);
+      args_size += expr_node->type()->size();
+      if (expr_node->is_typed(cdk::TYPE_INT))
+        kinds.insert(0, 1, 'i');
+      else if (expr_node->is_typed(cdk::TYPE_DOUBLE))
+        kinds.insert(0, 1, 'd');
+      else
+        kinds.insert(0, 1, 's');
+    }
+    if (node->newline())
+      kinds += 'n';
+    _pf.ADDR(_pool.string_address(kinds));
+    _external_funcs.insert("tilprint");
+    _pf.CALL("tilprint");
+    _pf.TRASH(args_size + 4);
+    return;
+  }
+
+  for (auto arg : node->arguments()->nodes()) {
+    auto expr_node = dynamic_cast<cdk::expression_node *> (arg);
 
     expr_node->accept(this, lvl); // determine the value to print
     if (expr_node->is_typed(cdk::TYPE_INT)) {
@@ -475,7 +851,6 @@ void til::postfix_writer::do_print_node(til::print_node * const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_read_node(til::read_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   if (node->is_typed(cdk::TYPE_INT)) {
     _external_funcs.insert("readi");
     _pf.CALL("readi");
@@ -493,13 +868,10 @@ void til::postfix_writer::do_read_node(til::read_node * const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_address_of_node(til::address_of_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   node->lvalue()->accept(this, lvl + 2);
 }
 
 void til::postfix_writer::do_stack_alloc_node(til::stack_alloc_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-
   auto ref = cdk::reference_type::cast(node->type())->referenced();
   node->argument()->accept(this, lvl);
   _pf.INT(std::max(static_cast<size_t>(1), ref->size()));
@@ -518,21 +890,45 @@ void til::postfix_writer::do_nullptr_node(til::nullptr_node *const node, int lvl
 
 //---------------------------------------------------------------------------
 
+// loops are rotated: the condition is tested once before entering and then
+// at the bottom, so each iteration takes a single (conditional) branch
+//
+//        cond; JZ end
+//   body:  instruction
+//   next:  cond; JNZ body
+//   end:
 void til::postfix_writer::do_loop_node(til::loop_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-  int loop_start_lbl = ++_lbl;
+  int loop_body_lbl = ++_lbl;
+  int loop_next_lbl = ++_lbl;
   int loop_end_lbl = ++_lbl;
 
-  _loop_start_lbls.push_back(loop_start_lbl);
+  _loop_start_lbls.push_back(loop_next_lbl); // "next" re-evaluates the condition
   _loop_end_lbls.push_back(loop_end_lbl);
   _symtab.push();
 
-  _pf.LABEL(mklbl(loop_start_lbl));
+  branch_if(node->condition(), false, mklbl(loop_end_lbl), lvl);
+
+  // loop invariants are computed once the loop is known to run
+  // (inlined bodies have no temporaries: they compute everything in place)
+  if (_inlining.empty()) {
+    for (auto expression : _invariants.hoisted(node)) {
+      _hoisting = expression;
+      expression->accept(this, lvl + 2);
+      _hoisting = nullptr;
+      _pf.LOCAL(_temporaries.at(expression));
+      if (!til::loop_invariants::is_address(expression) && expression->is_typed(cdk::TYPE_DOUBLE))
+        _pf.STDOUBLE();
+      else
+        _pf.STINT();
+    }
+  }
 
-  node->condition()->accept(this, lvl);
-  _pf.JZ(mklbl(loop_end_lbl));
+  _pf.ALIGN();
+  _pf.LABEL(mklbl(loop_body_lbl));
   node->instruction()->accept(this, lvl + 2);
-  _pf.JMP(mklbl(loop_start_lbl));
+
+  _pf.LABEL(mklbl(loop_next_lbl));
+  branch_if(node->condition(), true, mklbl(loop_body_lbl), lvl);
   _pf.LABEL(mklbl(loop_end_lbl));
 
   _symtab.pop();
@@ -567,10 +963,8 @@ void til::postfix_writer::do_next_node(til::next_node *const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_if_node(til::if_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
-  int lbl1 = ++_lbl;
-  node->condition()->accept(this, lvl);
-  _pf.JZ(mklbl(lbl1 = ++_lbl));
+  int lbl1;
+  branch_if(node->condition(), false, mklbl(lbl1 = ++_lbl), lvl);
   node->block()->accept(this, lvl + 2);
   _pf.LABEL(mklbl(lbl1));
 }
@@ -578,10 +972,8 @@ void til::postfix_writer::do_if_node(til::if_node * const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_if_else_node(til::if_else_node * const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS;
   int lbl1, lbl2;
-  node->condition()->accept(this, lvl);
-  _pf.JZ(mklbl(lbl1 = ++_lbl));
+  branch_if(node->condition(), false, mklbl(lbl1 = ++_lbl), lvl);
   node->thenblock()->accept(this, lvl + 2);
   _pf.JMP(mklbl(lbl2 = ++_lbl));
   _pf.LABEL(mklbl(lbl1));
@@ -591,14 +983,9 @@ void til::postfix_writer::do_if_else_node(til::if_else_node * const node, int lv
 
 //---------------------------------------------------------------------------
 
-void til::postfix_writer::do_function_call_node(til::function_call_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-  auto func_type = node->func()->type();
-  std::vector<std::shared_ptr<cdk::basic_type>> arg_types;
-  if (node->func()) { // normal function call
-    arg_types = 
-        cdk::functional_type::cast(func_type)->input()->components();
-  }
+size_t til::postfix_writer::push_arguments(til::function_call_node *const node,
+                                           std::shared_ptr<cdk::functional_type> type, int lvl) {
+  auto arg_types = type->input()->components();
 
   size_t args_size = 0;
   for (int i = node->arguments()->size() - 1; i >= 0; --i) {
@@ -612,8 +999,109 @@ void til::postfix_writer::do_function_call_node(til::function_call_node *const n
         _pf.I2D();
       }
   }
+  return args_size;
+}
+
+bool til::postfix_writer::can_inline(til::function_node *const callee) {
+  if (std::find(_inlining.begin(), _inlining.end(), callee) != _inlining.end())
+    return false;
+  // the callee's globals must not be hidden by the caller's locals
+  for (auto name : _inliner.info(callee).free_names) {
+    auto symbol = _symtab.find(name);
+    if (symbol == nullptr || !symbol->is_global())
+      return false;
+  }
+  return true;
+}
+
+void til::postfix_writer::inline_call(til::function_call_node *const node, til::function_node *const callee,
+                                      int lvl) {
+  auto &info = _inliner.info(callee);
+  auto func_type = cdk::functional_type::cast(callee->type());
+
+  // arguments are evaluated as for a call, then moved to the parameter slots
+  push_arguments(node, func_type, lvl);
+  const int area = _frame_base + _frame_peak;
+  auto params = callee->arguments();
+  std::vector<std::shared_ptr<til::symbol>> param_symbols;
+  for (size_t i = 0; i < params->size(); i++) {
+    auto param = dynamic_cast<til::declaration_node *>(params->node(i));
+    auto symbol = til::make_symbol(param->identifier_handle(), param->type(), param->qualifier());
+    symbol->offset(info.param_offsets[i] - area);
+    _pf.LOCAL(symbol->offset());
+    if (param->is_typed(cdk::TYPE_DOUBLE))
+      _pf.STDOUBLE();
+    else
+      _pf.STINT();
+    param_symbols.push_back(symbol);
+  }
+
+  // the callee's body runs in a frame of its own inside the caller's
+  const int prev_frame_base = _frame_base, prev_frame_peak = _frame_peak;
+  auto prev_function_ret_lbl = _current_function_ret_lbl;
+  auto prev_loop_start_lbls = std::move(_loop_start_lbls);
+  auto prev_loop_end_lbls = std::move(_loop_end_lbls);
+  _loop_start_lbls.clear();
+  _loop_end_lbls.clear();
+  auto &frame = _inliner.frame(callee); // the layout the callee is generated with
+  _frame_base = area + info.params;
+  _frame_peak = frame.size;
+  auto end_lbl = mklbl(++_lbl);
+  _current_function_ret_lbl = end_lbl; // returns store the value and come here
+  _local_offsets.insert(frame.offsets.begin(), frame.offsets.end());
+
+  _symtab.push();
+  auto function_sym = til::make_symbol(til::symbol_table::function_name(), callee->type(), tPRIVATE);
+  _symtab.insert(function_sym->handle(), function_sym);
+  for (auto &symbol : param_symbols)
+    _symtab.insert(symbol->handle(), symbol);
+  _functions.push(function_sym);
+  _inlining.push_back(callee);
+
+  callee->block()->accept(this, lvl + 2);
+  _pf.LABEL(end_lbl);
+
+  _inlining.pop_back();
+  _functions.pop();
+  _symtab.pop();
+  _current_function_ret_lbl = prev_function_ret_lbl;
+  _loop_start_lbls = std::move(prev_loop_start_lbls);
+  _loop_end_lbls = std::move(prev_loop_end_lbls);
+  _frame_base = prev_frame_base;
+  _frame_peak = prev_frame_peak;
+
+  if (node->is_typed(cdk::TYPE_DOUBLE)) {
+    _pf.LDFVAL64();
+  } else if (!node->is_typed(cdk::TYPE_VOID)) {
+    _pf.LDFVAL32();
+  }
+  _inliner.inlined(node, callee);
+}
 
+void til::postfix_writer::do_function_call_node(til::function_call_node *const node, int lvl) {
   if (node->func()) {
+    auto callee = _inliner.candidate(node);
+    if (callee != nullptr && can_inline(callee)) {
+      inline_call(node, callee, lvl);
+      return;
+    }
+  }
+
+  // "@" is the function being generated
+  auto func_type = node->func() ? node->func()->type() : _functions.top()->type();
+  size_t args_size = push_arguments(node, cdk::functional_type::cast(func_type), lvl);
+
+  if (!node->func()) {
+    _pf.CALL(_function_lbls.top()); // recursion
+  } else if (auto target = _resolver.target(node)) {
+    // callee known at compile time: call it directly
+    if (target->function != nullptr) {
+      _pf.CALL(function_label(target->function));
+    } else {
+      _external_funcs.insert(target->external);
+      _pf.CALL(target->external);
+    }
+  } else {
     node->func()->accept(this, lvl); // call func expr
     _pf.BRANCH(); // because functions are just variables with addresses
   }
@@ -631,7 +1119,6 @@ void til::postfix_writer::do_function_call_node(til::function_call_node *const n
 
 //---------------------------------------------------------------------------
 void til::postfix_writer::do_declaration_node(til::declaration_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
   
   int typesize = node->type()->size();
   int offset = 0;
@@ -640,14 +1127,14 @@ void til::postfix_writer::do_declaration_node(til::declaration_node *const node,
     offset = _offset;      // func args start 8 and go up (_offset is 8 if here)
     _offset += typesize;
   } else if (in_function()) {
-    _offset -= typesize;   // local variables start at 0 and go down 
-    offset = _offset;
+    offset = _local_offsets.at(node) - _frame_base; // slot assigned by the frame size calculator
   }
 
-  auto symbol = new_symbol();
-  if (symbol) {
-    symbol->offset(offset);
-    reset_new_symbol();
+  // types were annotated by the type checker: just make the name visible
+  auto symbol = til::make_symbol(node->identifier_handle(), node->type(), node->qualifier());
+  symbol->offset(offset);
+  if (!_symtab.insert(symbol->handle(), symbol)) {
+    _symtab.replace(symbol->handle(), symbol);
   }
 
   /* Private declaration */
@@ -671,6 +1158,12 @@ void til::postfix_writer::do_declaration_node(til::declaration_node *const node,
 
   /* Global declaration */
 
+  // external functions are defined elsewhere: only import them
+  if (node->qualifier() == tEXTERNAL) {
+    _external_funcs.insert(symbol->name());
+    return;
+  }
+
   // Unitialized declaration
   if (node->initializer() == nullptr) {
     _pf.BSS();
@@ -686,18 +1179,24 @@ void til::postfix_writer::do_declaration_node(til::declaration_node *const node,
   _pf.ALIGN();
   _pf.LABEL(symbol->name());
 
-  if (node->is_typed(cdk::TYPE_DOUBLE) && node->initializer()->is_typed(cdk::TYPE_INT)) {
-    cdk::integer_node *int_node = dynamic_cast<cdk::integer_node *>(node->initializer());
-    _pf.SDOUBLE(int_node->value());
-  } else {
+  // constant expressions are computed at compile time (ints promoted to double)
+  if (auto value = _folder.value(node->initializer())) {
+    if (node->is_typed(cdk::TYPE_DOUBLE))
+      _pf.SDOUBLE(value->as_double());
+    else
+      _pf.SINT(value->i);
+  } else if (dynamic_cast<cdk::string_node *>(node->initializer()) ||
+             dynamic_cast<til::nullptr_node *>(node->initializer()) ||
+             dynamic_cast<til::function_node *>(node->initializer())) {
     node->initializer()->accept(this, lvl);
+  } else {
+    THROW_ERROR(node, "initializer of '" << node->identifier() << "' is not a constant");
   }
 }
 
 //---------------------------------------------------------------------------
 
 void til::postfix_writer::do_sizeof_node(til::sizeof_node *const node, int lvl) {
-  ASSERT_SAFE_EXPRESSIONS
-
+  if (emit_folded(node)) return;
   _pf.INT(node->argument()->type()->size());
 }
\ No newline at end of file
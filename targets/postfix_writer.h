@@ -2,11 +2,19 @@
 #define __SIMPLE_TARGETS_POSTFIX_WRITER_H__
 
 #include "targets/basic_ast_visitor.h"
+#include "targets/constant_folder.h"
+#include "targets/call_resolver.h"
+#include "targets/inliner.h"
+#include "targets/literal_pool.h"
+#include "targets/loop_invariants.h"
 
+#include <cstdlib>
 #include <sstream>
 #include <stack>
+#include <unordered_map>
 #include <unordered_set>
 #include <cdk/emitters/basic_postfix_emitter.h>
+#include <cdk/types/types.h>
 
 namespace til {
 
@@ -14,8 +22,13 @@ namespace til {
   //! Traverse syntax tree and generate the corresponding assembly code.
   //!
   class postfix_writer: public basic_ast_visitor {
-    cdk::symbol_table<til::symbol> &_symtab;
+    til::symbol_table &_symtab;
     cdk::basic_postfix_emitter &_pf;
+    const til::constant_folder &_folder;
+    const til::call_resolver &_resolver;
+    til::inliner &_inliner;
+    til::literal_pool &_pool;
+    const til::loop_invariants &_invariants;
 
     std::stack<std::string> _function_lbls;
 
@@ -26,19 +39,34 @@ namespace til {
     std::vector<int> _loop_end_lbls;
 
     std::unordered_set<std::string> _external_funcs; // external funcs to be imported
+    std::unordered_map<const til::function_node *, std::string> _function_labels;
 
     std::stack<std::shared_ptr<til::symbol>> _functions; // functions
 
 
     bool _func_args_decl = false;
-    int _offset = 0; // current frame pointer offset (0 -> global)
+    int _offset = 0; // next argument offset
+    std::unordered_map<const til::declaration_node *, int> _local_offsets; // from frame_size_calculator
+    std::unordered_map<const cdk::typed_node *, int> _temporaries; // hoisted out of loops
+    const cdk::typed_node *_hoisting = nullptr; // being evaluated into its temporary
+    int _frame_base = 0; // bytes above the frame of the (possibly inlined) body being generated
+    int _frame_peak = 0; // bytes of that body's locals (its inline area is below)
+    std::vector<const til::function_node *> _inlining; // callees being expanded
+    bool _tail_calls_allowed = false; // no pointers into the current frame
+    size_t _tail_calls = 0;
+    bool _bulk_print; // print instructions call tilprint (buffered runtime)
 
     int _lbl;
 
+    size_t _visits = 0; // sequence items visited
+
   public:
-    postfix_writer(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<til::symbol> &symtab,
-                   cdk::basic_postfix_emitter &pf) :
-        basic_ast_visitor(compiler), _symtab(symtab), _pf(pf), _lbl(0) {
+    postfix_writer(std::shared_ptr<cdk::compiler> compiler, til::symbol_table &symtab,
+                   cdk::basic_postfix_emitter &pf, const til::constant_folder &folder,
+                   const til::call_resolver &resolver, til::inliner &inliner, til::literal_pool &pool,
+                   const til::loop_invariants &invariants) :
+        basic_ast_visitor(compiler), _symtab(symtab), _pf(pf), _folder(folder), _resolver(resolver),
+        _inliner(inliner), _pool(pool), _invariants(invariants), _bulk_print(std::getenv("TIL_BUFFERED_RTS") != nullptr), _lbl(0) {
     }
 
   public:
@@ -46,16 +74,76 @@ namespace til {
       os().flush();
     }
 
+    size_t visits() const {
+      return _visits;
+    }
+    size_t tail_calls() const {
+      return _tail_calls;
+    }
+
     inline bool in_function() {
       return _function_lbls.size() > 0;
     }
 
   protected:
+    /** Emit the node as a single literal, if it is a constant expression. */
+    bool emit_folded(cdk::expression_node *const node);
+
+    /** Jump to the label if the condition is (or is not) true; otherwise, fall through. */
+    void branch_if(cdk::expression_node *const condition, bool when, const std::string &lbl, int lvl);
+
+    /** Compute a condition as 0 or 1 (through branch_if). */
+    void emit_condition_value(cdk::expression_node *const condition, int lvl);
+
+    /** Push the arguments of a call (last to first); returns their size. */
+    size_t push_arguments(til::function_call_node *const node, std::shared_ptr<cdk::functional_type> type, int lvl);
+
+    /** Whether the callee can be expanded here (no recursion, its globals not shadowed). */
+    bool can_inline(til::function_node *const callee);
+
+    /** Exponent of an integer constant that is a power of two (else -1). */
+    int log2_of(cdk::expression_node *const node);
+
+    /** Multiply the top of the stack by a type size (a shift if possible). */
+    void scale(size_t size);
+
+    /** Push an integer expression multiplied by a type size. */
+    void push_scaled(cdk::expression_node *const node, size_t size, int lvl);
+
+    /** Replace the top of the stack, x, by x + 2^k - 1 if x is negative. */
+    void push_biased(int k);
+
+    /** Push the value of an expression hoisted out of a loop (false if not hoisted). */
+    bool load_hoisted(cdk::typed_node *const node);
+
+    /** Push a double constant (loaded from the literal pool). */
+    void push_double(double value);
+
+    /** Emit a call in tail position as a jump (false if it must be a real call). */
+    bool emit_tail_call(til::function_call_node *const call, int lvl);
+
+    /** Whether evaluating the node may call, read or assign. */
+    bool has_side_effects(cdk::basic_node *const node);
+
+    /** Whether the function takes addresses inside its own frame. */
+    bool frame_escapes(til::function_node *const node);
+
+    /** Expand the body of the callee in place of the call. */
+    void inline_call(til::function_call_node *const node, til::function_node *const callee, int lvl);
+
     void pre_process_logical_binary_expr(cdk::binary_operation_node *const node, int lvl);
     void pre_process_int_double_pointer_binary_expr(cdk::binary_operation_node *const node, int lvl);
     void pre_process_int_double_binary_expr(cdk::binary_operation_node *const node, int lvl);
 
   private:
+    /** Label of a function literal (assigned on first use: calls may come first). */
+    const std::string &function_label(const til::function_node *node) {
+      auto it = _function_labels.find(node);
+      if (it == _function_labels.end())
+        it = _function_labels.emplace(node, mklbl(++_lbl)).first;
+      return it->second;
+    }
+
     /** Method used to generate sequential labels. */
     inline std::string mklbl(int lbl) {
       std::ostringstream oss;
@@ -0,0 +1,79 @@
+#include "targets/sse2_emitter.h"
+
+//---------------------------------------------------------------------------
+
+// left operand below the right one: [esp+8] op [esp]
+void til::sse2_emitter::binary(const char *operation) {
+  os() << "\tmovsd xmm0, qword [esp+8]" << std::endl
+       << "\t" << operation << " xmm0, qword [esp]" << std::endl
+       << "\tadd esp, byte 8" << std::endl
+       << "\tmovsd qword [esp], xmm0" << std::endl;
+}
+
+void til::sse2_emitter::DADD() {
+  binary("addsd");
+}
+
+void til::sse2_emitter::DSUB() {
+  binary("subsd");
+}
+
+void til::sse2_emitter::DMUL() {
+  binary("mulsd");
+}
+
+void til::sse2_emitter::DDIV() {
+  binary("divsd");
+}
+
+// flip the sign bit (in the upper half)
+void til::sse2_emitter::DNEG() {
+  os() << "\txor dword [esp+4], 0x80000000" << std::endl;
+}
+
+// -1, 0 or 1 as the left operand is below, equal to or above the right one
+// (unordered compares below)
+void til::sse2_emitter::DCMP() {
+  os() << "\tmovsd xmm0, qword [esp+8]" << std::endl
+       << "\txor eax, eax" << std::endl
+       << "\tucomisd xmm0, qword [esp]" << std::endl
+       << "\tseta al" << std::endl
+       << "\tsbb eax, byte 0" << std::endl
+       << "\tadd esp, byte 12" << std::endl
+       << "\tmov dword [esp], eax" << std::endl;
+}
+
+void til::sse2_emitter::I2D() {
+  os() << "\tcvtsi2sd xmm0, dword [esp]" << std::endl
+       << "\tsub esp, byte 4" << std::endl
+       << "\tmovsd qword [esp], xmm0" << std::endl;
+}
+
+// rounds to nearest, like fistp in the default x87 mode
+void til::sse2_emitter::D2I() {
+  os() << "\tcvtsd2si eax, qword [esp]" << std::endl
+       << "\tadd esp, byte 4" << std::endl
+       << "\tmov dword [esp], eax" << std::endl;
+}
+
+void til::sse2_emitter::DUP64() {
+  os() << "\tmovsd xmm0, qword [esp]" << std::endl
+       << "\tsub esp, byte 8" << std::endl
+       << "\tmovsd qword [esp], xmm0" << std::endl;
+}
+
+// address on top: replaced by the double it points to
+void til::sse2_emitter::LDDOUBLE() {
+  os() << "\tmov eax, dword [esp]" << std::endl
+       << "\tmovsd xmm0, qword [eax]" << std::endl
+       << "\tsub esp, byte 4" << std::endl
+       << "\tmovsd qword [esp], xmm0" << std::endl;
+}
+
+// address on top of the value: both are popped
+void til::sse2_emitter::STDOUBLE() {
+  os() << "\tmov eax, dword [esp]" << std::endl
+       << "\tmovsd xmm0, qword [esp+4]" << std::endl
+       << "\tmovsd qword [eax], xmm0" << std::endl
+       << "\tadd esp, byte 12" << std::endl;
+}
@@ -0,0 +1,46 @@
+#ifndef __TIL_TARGETS_SSE2_EMITTER_H__
+#define __TIL_TARGETS_SSE2_EMITTER_H__
+
+#include <cdk/emitters/postfix_ix86_emitter.h>
+
+namespace til {
+
+  /**
+   * i386 postfix emitter doing double arithmetic with SSE2 instead of x87.
+   *
+   * Doubles stay 8-byte values on the postfix stack: each instruction loads
+   * its operands into XMM registers, computes and stores the result back.
+   * Function results are still returned in st(0) (LDFVAL64 and STFVAL64 are
+   * inherited), so code built this way links with the RTS and with code
+   * built without it.
+   *
+   * Selected by setting TIL_SSE2 in the environment (needs an SSE2 CPU).
+   */
+  class sse2_emitter: public cdk::postfix_ix86_emitter {
+  public:
+    sse2_emitter(std::shared_ptr<cdk::compiler> compiler) :
+        cdk::postfix_ix86_emitter(compiler) {
+    }
+
+  public:
+    void DADD() override;
+    void DSUB() override;
+    void DMUL() override;
+    void DDIV() override;
+    void DNEG() override;
+    void DCMP() override;
+    void I2D() override;
+    void D2I() override;
+    void DUP64() override;
+    void LDDOUBLE() override;
+    void STDOUBLE() override;
+
+  private:
+    /** Replace the two doubles on top of the stack by the result of the operation. */
+    void binary(const char *operation);
+
+  };
+
+} // til
+
+#endif
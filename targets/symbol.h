@@ -8,14 +8,14 @@
 namespace til {
 
   class symbol {
-    std::string _name;
+    const std::string *_name; // interned (see string_table)
     std::shared_ptr<cdk::basic_type> _type;
     int _qualifier;
     long _value = 0; 
     int _offset;
 
   public:
-    symbol(const std::string &name, std::shared_ptr<cdk::basic_type> type, int qualifier) :
+    symbol(const std::string *name, std::shared_ptr<cdk::basic_type> type, int qualifier) :
         _name(name), _type(type), _qualifier(qualifier) {
     }
 
@@ -30,8 +30,14 @@ namespace til {
       return _type->name() == name;
     }
     const std::string &name() const {
+      return *_name;
+    }
+    const std::string *handle() const {
       return _name;
     }
+    int qualifier() const {
+      return _qualifier;
+    }
     long value() const {
       return _value;
     }
@@ -49,7 +55,7 @@ namespace til {
     }
   };
 
-  inline auto make_symbol(const std::string &name, std::shared_ptr<cdk::basic_type> type, int qualifier = 0) {
+  inline auto make_symbol(const std::string *name, std::shared_ptr<cdk::basic_type> type, int qualifier = 0) {
     return std::make_shared<symbol>(name, type, qualifier);
   }
 
@@ -0,0 +1,72 @@
+#ifndef __TIL_TARGETS_SYMBOL_TABLE_H__
+#define __TIL_TARGETS_SYMBOL_TABLE_H__
+
+#include "targets/symbol.h"
+#include "string_table.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Scoped symbol table keyed by interned names (see string_table): lookups
+   * hash and compare handles, never the characters. The interface is that of
+   * cdk::symbol_table, with handles for names.
+   */
+  class symbol_table {
+    using context = std::unordered_map<const std::string *, std::shared_ptr<symbol>>;
+
+    std::vector<context> _contexts = std::vector<context>(1); // the first is global
+
+  public:
+    void push() {
+      _contexts.emplace_back();
+    }
+    void pop() {
+      _contexts.pop_back();
+    }
+
+    /** Declare in the innermost context (false if already declared there). */
+    bool insert(const std::string *name, std::shared_ptr<symbol> symbol) {
+      return _contexts.back().emplace(name, symbol).second;
+    }
+
+    /** Replace the innermost declaration of a name (false if there is none). */
+    bool replace(const std::string *name, std::shared_ptr<symbol> symbol) {
+      for (auto context = _contexts.rbegin(); context != _contexts.rend(); ++context) {
+        auto it = context->find(name);
+        if (it != context->end()) {
+          it->second = symbol;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    std::shared_ptr<symbol> find(const std::string *name) const {
+      for (auto context = _contexts.rbegin(); context != _contexts.rend(); ++context) {
+        auto it = context->find(name);
+        if (it != context->end())
+          return it->second;
+      }
+      return nullptr;
+    }
+
+  public:
+    /** Names of the implicit symbols: the current function and the program. */
+    static const std::string *function_name() {
+      static const std::string *name = string_table::instance().intern("@");
+      return name;
+    }
+    static const std::string *program_name() {
+      static const std::string *name = string_table::instance().intern("_main");
+      return name;
+    }
+  };
+
+} // til
+
+#endif
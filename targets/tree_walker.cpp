@@ -0,0 +1,178 @@
+#include "targets/tree_walker.h"
+#include ".auto/all_nodes.h"  // all_nodes.h is automatically generated
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_nil_node(cdk::nil_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_data_node(cdk::data_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_integer_node(cdk::integer_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_double_node(cdk::double_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_string_node(cdk::string_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_nullptr_node(til::nullptr_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_read_node(til::read_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_variable_node(cdk::variable_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_stop_node(til::stop_node *const node, int lvl) {
+  // EMPTY
+}
+void til::tree_walker::do_next_node(til::next_node *const node, int lvl) {
+  // EMPTY
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_sequence_node(cdk::sequence_node *const node, int lvl) {
+  for (size_t i = 0; i < node->size(); i++)
+    walk(node->node(i), lvl);
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_not_node(cdk::not_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+void til::tree_walker::do_unary_minus_node(cdk::unary_minus_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+void til::tree_walker::do_unary_plus_node(cdk::unary_plus_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+void til::tree_walker::do_sizeof_node(til::sizeof_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+void til::tree_walker::do_stack_alloc_node(til::stack_alloc_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_add_node(cdk::add_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_sub_node(cdk::sub_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_mul_node(cdk::mul_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_div_node(cdk::div_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_mod_node(cdk::mod_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_lt_node(cdk::lt_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_le_node(cdk::le_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_ge_node(cdk::ge_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_gt_node(cdk::gt_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_ne_node(cdk::ne_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_eq_node(cdk::eq_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_and_node(cdk::and_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+void til::tree_walker::do_or_node(cdk::or_node *const node, int lvl) {
+  walk(node->left(), lvl + 2);
+  walk(node->right(), lvl + 2);
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_rvalue_node(cdk::rvalue_node *const node, int lvl) {
+  walk(node->lvalue(), lvl + 2);
+}
+void til::tree_walker::do_assignment_node(cdk::assignment_node *const node, int lvl) {
+  walk(node->lvalue(), lvl + 2);
+  walk(node->rvalue(), lvl + 2);
+}
+void til::tree_walker::do_index_node(til::index_node *const node, int lvl) {
+  walk(node->base(), lvl + 2);
+  walk(node->index(), lvl + 2);
+}
+void til::tree_walker::do_address_of_node(til::address_of_node *const node, int lvl) {
+  walk(node->lvalue(), lvl + 2);
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_program_node(til::program_node *const node, int lvl) {
+  walk(node->block(), lvl + 2);
+}
+void til::tree_walker::do_function_node(til::function_node *const node, int lvl) {
+  walk(node->arguments(), lvl + 2);
+  walk(node->block(), lvl + 2);
+}
+void til::tree_walker::do_function_call_node(til::function_call_node *const node, int lvl) {
+  walk(node->func(), lvl + 2);
+  walk(node->arguments(), lvl + 2);
+}
+void til::tree_walker::do_return_node(til::return_node *const node, int lvl) {
+  walk(node->ret_val(), lvl + 2);
+}
+void til::tree_walker::do_declaration_node(til::declaration_node *const node, int lvl) {
+  walk(node->initializer(), lvl + 2);
+}
+
+//---------------------------------------------------------------------------
+
+void til::tree_walker::do_evaluation_node(til::evaluation_node *const node, int lvl) {
+  walk(node->argument(), lvl + 2);
+}
+void til::tree_walker::do_block_node(til::block_node *const node, int lvl) {
+  walk(node->declarations(), lvl + 2);
+  walk(node->instructions(), lvl + 2);
+}
+void til::tree_walker::do_print_node(til::print_node *const node, int lvl) {
+  walk(node->arguments(), lvl + 2);
+}
+void til::tree_walker::do_loop_node(til::loop_node *const node, int lvl) {
+  walk(node->condition(), lvl + 2);
+  walk(node->instruction(), lvl + 2);
+}
+void til::tree_walker::do_if_node(til::if_node *const node, int lvl) {
+  walk(node->condition(), lvl + 2);
+  walk(node->block(), lvl + 2);
+}
+void til::tree_walker::do_if_else_node(til::if_else_node *const node, int lvl) {
+  walk(node->condition(), lvl + 2);
+  walk(node->thenblock(), lvl + 2);
+  walk(node->elseblock(), lvl + 2);
+}
@@ -0,0 +1,42 @@
+#ifndef __TIL_TARGETS_TREE_WALKER_H__
+#define __TIL_TARGETS_TREE_WALKER_H__
+
+#include "targets/basic_ast_visitor.h"
+
+namespace til {
+
+  /**
+   * Visit every node of the tree, children first to last, doing nothing else.
+   *
+   * Base class for analyses and rewrites that only care about a few node
+   * kinds: override those and call the walker's method to keep descending.
+   */
+  class tree_walker: public basic_ast_visitor {
+  protected:
+    tree_walker(std::shared_ptr<cdk::compiler> compiler) :
+        basic_ast_visitor(compiler) {
+    }
+
+  public:
+    ~tree_walker() {
+    }
+
+  protected:
+    /** Visit a child, if present. */
+    void walk(cdk::basic_node *const node, int lvl) {
+      if (node != nullptr)
+        node->accept(this, lvl);
+    }
+
+  public:
+    // do not edit these lines
+#define __IN_VISITOR_HEADER__
+#include ".auto/visitor_decls.h"       // automatically generated
+#undef __IN_VISITOR_HEADER__
+    // do not edit these lines: end
+
+  };
+
+} // til
+
+#endif
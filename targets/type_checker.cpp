@@ -1,8 +1,17 @@
 #include "targets/type_checker.h"
 #include ".auto/all_nodes.h" // automatically generated
+#include "til_parser.tab.h"
+#include "interned_nodes.h"
+#include "type_table.h"
 #include <cdk/types/primitive_type.h>
 #include <string>
 
+#define ASSERT_UNCHECKED                                                       \
+  {                                                                            \
+    if (!mark_checked(node))                                                   \
+      return;                                                                  \
+  }
+
 #define ASSERT_UNSPEC                                                          \
   {                                                                            \
     if (node->type() != nullptr && !node->is_typed(cdk::TYPE_UNSPEC))          \
@@ -14,11 +23,17 @@
  *
  * If relax is set to true it returns true for compatible types, which are int
  * and double, also for functional types with compatible arguments and/or return
- * values. If relax is set to false it does strict comparison of types
+ * values. If relax is set to false it does strict comparison of types: since
+ * types are interned (see type_table.h), that is just a pointer comparison.
  */
 bool til::type_checker::deep_compare_types(
     std::shared_ptr<cdk::basic_type> left,
     std::shared_ptr<cdk::basic_type> right, bool relax) {
+  if (left == right)
+    return true;
+  if (!relax)
+    return false;
+
   if (left->name() == cdk::TYPE_FUNCTIONAL) {
     if (right->name() != cdk::TYPE_FUNCTIONAL)
       return false;
@@ -38,8 +53,8 @@ bool til::type_checker::deep_compare_types(
     }
 
     // Compare functions returns
-    for (size_t i = 0; i < left_type->input_length(); i++) {
-      if (!deep_compare_types(left_type->input(i), right_type->input(i), relax))
+    for (size_t i = 0; i < left_type->output_length(); i++) {
+      if (!deep_compare_types(left_type->output(i), right_type->output(i), relax))
         return false;
     }
 
@@ -77,8 +92,21 @@ bool til::type_checker::deep_compare_types(
 
 void til::type_checker::do_sequence_node(cdk::sequence_node *const node,
                                          int lvl) {
+  ASSERT_UNCHECKED;
   for (auto &child : node->nodes()) {
-    child->accept(this, lvl + 2);
+    if (dynamic_cast<cdk::expression_node *>(child) != nullptr) {
+      child->accept(this, lvl + 2); // problems belong to the enclosing node
+      continue;
+    }
+
+    // instructions and declarations are checked independently, so that a
+    // single pass reports every faulty one
+    try {
+      child->accept(this, lvl + 2);
+    } catch (const std::string &problem) {
+      std::cerr << child->lineno() << ": " << problem << std::endl;
+      _errors++;
+    }
   }
 }
 
@@ -86,13 +114,14 @@ void til::type_checker::do_sequence_node(cdk::sequence_node *const node,
 
 void til::type_checker::processUnaryExpression(
     cdk::unary_operation_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
   node->argument()->accept(this, lvl + 2);
   if (!node->argument()->is_typed(cdk::TYPE_INT))
     throw std::string("wrong type in argument of unary expression");
 
   // in Simple, expressions are always int
-  node->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+  node->type(til::make_primitive_type(4, cdk::TYPE_INT));
 }
 
 void til::type_checker::do_not_node(cdk::not_node *const node, int lvl) {
@@ -109,25 +138,29 @@ void til::type_checker::do_or_node(cdk::or_node *const node, int lvl) {
 
 void til::type_checker::do_integer_node(cdk::integer_node *const node,
                                         int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
-  node->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+  node->type(til::make_primitive_type(4, cdk::TYPE_INT));
 }
 
 void til::type_checker::do_string_node(cdk::string_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
-  node->type(cdk::primitive_type::create(4, cdk::TYPE_STRING));
+  node->type(til::make_primitive_type(4, cdk::TYPE_STRING));
 }
 
 void til::type_checker::do_double_node(cdk::double_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
-  node->type(cdk::primitive_type::create(8, cdk::TYPE_DOUBLE));
+  node->type(til::make_primitive_type(8, cdk::TYPE_DOUBLE));
 }
 
 void til::type_checker::do_nullptr_node(til::nullptr_node *const node,
                                         int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
-  node->type(cdk::reference_type::create(
-      4, cdk::primitive_type::create(0, cdk::TYPE_UNSPEC)));
+  node->type(til::make_reference_type(
+      4, til::make_primitive_type(0, cdk::TYPE_UNSPEC)));
 }
 
 //---------------------------------------------------------------------------
@@ -146,6 +179,7 @@ void til::type_checker::do_unary_plus_node(cdk::unary_plus_node *const node,
 
 void til::type_checker::processBinaryExpression(
     cdk::binary_operation_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
   node->left()->accept(this, lvl + 2);
   if (!node->left()->is_typed(cdk::TYPE_INT))
@@ -155,7 +189,7 @@ void til::type_checker::processBinaryExpression(
   if (!node->right()->is_typed(cdk::TYPE_INT))
     throw std::string("wrong type in right argument of binary expression");
 
-  node->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+  node->type(til::make_primitive_type(4, cdk::TYPE_INT));
 }
 
 void til::type_checker::do_add_node(cdk::add_node *const node, int lvl) {
@@ -199,8 +233,9 @@ void til::type_checker::do_eq_node(cdk::eq_node *const node, int lvl) {
 
 void til::type_checker::do_variable_node(cdk::variable_node *const node,
                                          int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
-  auto symbol = _symtab.find(node->name());
+  auto symbol = _symtab.find(til::handle_of(node));
 
   if (symbol == nullptr)
     throw std::string("undeclared variable '" + node->name() + "'");
@@ -209,6 +244,7 @@ void til::type_checker::do_variable_node(cdk::variable_node *const node,
 }
 
 void til::type_checker::do_rvalue_node(cdk::rvalue_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
   node->lvalue()->accept(this, lvl);
   node->type(node->lvalue()->type());
@@ -216,6 +252,7 @@ void til::type_checker::do_rvalue_node(cdk::rvalue_node *const node, int lvl) {
 
 void til::type_checker::do_assignment_node(cdk::assignment_node *const node,
                                            int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
 
   node->lvalue()->accept(this, lvl + 2);
@@ -223,8 +260,8 @@ void til::type_checker::do_assignment_node(cdk::assignment_node *const node,
   // (var x (read))
   if (node->lvalue()->is_typed(cdk::TYPE_UNSPEC) &&
       node->rvalue()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->lvalue()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
-    node->rvalue()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->lvalue()->type(til::make_primitive_type(4, cdk::TYPE_INT));
+    node->rvalue()->type(til::make_primitive_type(4, cdk::TYPE_INT));
     return;
   }
 
@@ -238,6 +275,7 @@ void til::type_checker::do_assignment_node(cdk::assignment_node *const node,
 }
 
 void til::type_checker::do_index_node(til::index_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   node->base()->accept(this, lvl + 2);
 
   if (!node->base()->is_typed(cdk::TYPE_POINTER)) {
@@ -247,7 +285,7 @@ void til::type_checker::do_index_node(til::index_node *const node, int lvl) {
   node->index()->accept(this, lvl + 2);
   // unspec, assume it's a read node, type infer it to int
   if (node->index()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->index()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->index()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (!node->index()->is_typed(cdk::TYPE_INT)) {
     throw std::string("expected integer type in index operator index");
   }
@@ -257,8 +295,8 @@ void til::type_checker::do_index_node(til::index_node *const node, int lvl) {
 
   // unspec, assume pointer to int
   if (basetype->referenced()->name() == cdk::TYPE_UNSPEC) {
-    basetype = cdk::reference_type::create(
-        4, cdk::primitive_type::create(4, cdk::TYPE_INT));
+    basetype = til::make_reference_type(
+        4, til::make_primitive_type(4, cdk::TYPE_INT));
     node->base()->type(basetype);
   }
 
@@ -270,21 +308,43 @@ void til::type_checker::do_index_node(til::index_node *const node, int lvl) {
 
 void til::type_checker::do_program_node(til::program_node *const node,
                                         int lvl) {
+  ASSERT_UNCHECKED;
+  _symtab.push();
+  // the program is treated as just any other (int) function
+  auto prog_symbol = til::make_symbol(
+      til::symbol_table::program_name(),
+      til::make_functional_type(
+          til::make_primitive_type(4, cdk::TYPE_INT)),
+      tPRIVATE);
+  _symtab.insert(prog_symbol->handle(), prog_symbol);
+
   node->block()->accept(this, lvl + 2);
+  _symtab.pop();
 }
 
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_function_node(til::function_node *const node,
                                          int lvl) {
-  // TODO
+  ASSERT_UNCHECKED;
+  // the function type was set by the parser: check arguments and body in a
+  // context where "@" names the function itself
+  _symtab.push();
+  auto function_sym =
+      til::make_symbol(til::symbol_table::function_name(), node->type(), tPRIVATE);
+  _symtab.insert(function_sym->handle(), function_sym);
+
+  node->arguments()->accept(this, lvl + 2);
+  node->block()->accept(this, lvl + 2);
+  _symtab.pop();
 }
 
 void til::type_checker::do_return_node(til::return_node *const node, int lvl) {
-  auto symbol = _symtab.find("@");
+  ASSERT_UNCHECKED;
+  auto symbol = _symtab.find(til::symbol_table::function_name());
   if (symbol == nullptr) {
     // probably inside program func
-    auto prog_symbol = _symtab.find("_main");
+    auto prog_symbol = _symtab.find(til::symbol_table::program_name());
 
     if (prog_symbol == nullptr)
       throw std::string("return statement outside function definition");
@@ -322,24 +382,26 @@ void til::type_checker::do_return_node(til::return_node *const node, int lvl) {
 //---------------------------------------------------------------------------
 void til::type_checker::do_evaluation_node(til::evaluation_node *const node,
                                            int lvl) {
+  ASSERT_UNCHECKED;
   // evaluate the node by type checking it's expression
   node->argument()->accept(this, lvl + 2);
   // if unspec, assume it's a read node, type infer it to int
   if (node->argument()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->argument()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->argument()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (node->argument()->is_typed(cdk::TYPE_POINTER)) {
     auto ref = cdk::reference_type::cast(node->argument()->type());
 
     if (ref != nullptr && ref->referenced()->name() == cdk::TYPE_UNSPEC) {
       // (double !p (objects 5)) this is where update the referenced type to
       // double
-      node->argument()->type(cdk::reference_type::create(
-          4, cdk::primitive_type::create(4, cdk::TYPE_INT)));
+      node->argument()->type(til::make_reference_type(
+          4, til::make_primitive_type(4, cdk::TYPE_INT)));
     }
   }
 }
 
 void til::type_checker::do_print_node(til::print_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   node->arguments()->accept(this, lvl + 2);
 
   for (auto &arg : node->arguments()->nodes()) {
@@ -351,7 +413,7 @@ void til::type_checker::do_print_node(til::print_node *const node, int lvl) {
 
     // if unspec, assume it's a read node, type infer it to int
     if (typed_node->is_typed(cdk::TYPE_UNSPEC)) {
-      typed_node->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+      typed_node->type(til::make_primitive_type(4, cdk::TYPE_INT));
     } else if (!typed_node->is_typed(cdk::TYPE_INT) &&
                !typed_node->is_typed(cdk::TYPE_STRING) &&
                !typed_node->is_typed(cdk::TYPE_DOUBLE)) {
@@ -363,15 +425,17 @@ void til::type_checker::do_print_node(til::print_node *const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_read_node(til::read_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
   // gets type infered by parent nodes
-  node->type(cdk::primitive_type::create(0, cdk::TYPE_UNSPEC));
+  node->type(til::make_primitive_type(0, cdk::TYPE_UNSPEC));
 }
 
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_address_of_node(til::address_of_node *const node,
                                            int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
   node->lvalue()->accept(this, lvl + 2);
   if (node->lvalue()->is_typed(cdk::TYPE_POINTER)) {
@@ -382,33 +446,35 @@ void til::type_checker::do_address_of_node(til::address_of_node *const node,
       node->type(node->lvalue()->type()); // it's address is also a void pointer
                                           // (!void == !!void == ...)
   }
-  node->type(cdk::reference_type::create(4, node->lvalue()->type()));
+  node->type(til::make_reference_type(4, node->lvalue()->type()));
 }
 
 void til::type_checker::do_stack_alloc_node(til::stack_alloc_node *const node,
                                             int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
   node->argument()->accept(this, lvl + 2);
 
   // if unspec, assume it's a read node, type infer it to int
   if (node->argument()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->argument()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->argument()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (!node->argument()->is_typed(cdk::TYPE_INT)) {
     throw std::string(
         "expected integer type in stack allocation operator argument");
   }
 
-  node->type(cdk::reference_type::create(
-      4, cdk::primitive_type::create(0, cdk::TYPE_UNSPEC)));
+  node->type(til::make_reference_type(
+      4, til::make_primitive_type(0, cdk::TYPE_UNSPEC)));
 }
 
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_loop_node(til::loop_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   node->condition()->accept(this, lvl + 2);
 
   if (node->condition()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->condition()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->condition()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (!node->condition()->is_typed(cdk::TYPE_INT)) {
     throw std::string("expected integer type in loop instruction condition");
   }
@@ -419,32 +485,37 @@ void til::type_checker::do_loop_node(til::loop_node *const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_block_node(til::block_node *const node, int lvl) {
-  // EMPTY
+  ASSERT_UNCHECKED;
+  _symtab.push();
+  node->declarations()->accept(this, lvl + 2);
+  node->instructions()->accept(this, lvl + 2);
+  _symtab.pop();
 }
 
 void til::type_checker::do_stop_node(til::stop_node *const node, int lvl) {
-  // EMPTY
+  ASSERT_UNCHECKED;
 }
 
 void til::type_checker::do_next_node(til::next_node *const node, int lvl) {
-  // EMPTY
+  ASSERT_UNCHECKED;
 }
 
 void til::type_checker::do_nil_node(cdk::nil_node *const node, int lvl) {
-  // EMPTY
+  ASSERT_UNCHECKED;
 }
 
 void til::type_checker::do_data_node(cdk::data_node *const node, int lvl) {
-  // EMPTY
+  ASSERT_UNCHECKED;
 }
 
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_if_node(til::if_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   node->condition()->accept(this, lvl + 2);
 
   if (node->condition()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->condition()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->condition()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (!node->condition()->is_typed(cdk::TYPE_INT)) {
     throw std::string(
         "expected integer type in conditional instruction condition");
@@ -455,10 +526,11 @@ void til::type_checker::do_if_node(til::if_node *const node, int lvl) {
 
 void til::type_checker::do_if_else_node(til::if_else_node *const node,
                                         int lvl) {
+  ASSERT_UNCHECKED;
   node->condition()->accept(this, lvl + 2);
 
   if (node->condition()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->condition()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->condition()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   } else if (!node->condition()->is_typed(cdk::TYPE_INT)) {
     throw std::string(
         "expected integer type in conditoinal instruction condition");
@@ -472,6 +544,7 @@ void til::type_checker::do_if_else_node(til::if_else_node *const node,
 
 void til::type_checker::do_function_call_node(
     til::function_call_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC
   std::shared_ptr<cdk::functional_type> func_type;
   if (node->func()) { // regular call
@@ -488,8 +561,18 @@ void til::type_checker::do_function_call_node(
     }
 
     node->type(func_type->output(0));
-  } else {
-    throw std::string("not implemented");
+  } else { // recursive call ("@")
+    auto function = _symtab.find(til::symbol_table::function_name());
+    if (function == nullptr) {
+      throw std::string("recursive call outside a function");
+    }
+
+    func_type = cdk::functional_type::cast(function->type());
+    if (func_type->input()->length() != node->arguments()->size()) {
+      throw std::string("wrong number of arguments in function call");
+    }
+
+    node->type(func_type->output(0));
   }
 
   for (size_t i = 0; i < node->arguments()->size(); i++) {
@@ -499,9 +582,9 @@ void til::type_checker::do_function_call_node(
     auto param_type = func_type->input(i);
     if (arg->is_typed(cdk::TYPE_UNSPEC)) {
       if (param_type->name() == cdk::TYPE_INT) {
-        arg->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+        arg->type(til::make_primitive_type(4, cdk::TYPE_INT));
       } else if (param_type->name() == cdk::TYPE_DOUBLE) {
-        arg->type(cdk::primitive_type::create(8, cdk::TYPE_DOUBLE));
+        arg->type(til::make_primitive_type(8, cdk::TYPE_DOUBLE));
       } else {
         throw std::string("wrong argument type provided in function call");
       }
@@ -528,19 +611,20 @@ void til::type_checker::do_function_call_node(
 
 void til::type_checker::do_declaration_node(til::declaration_node *const node,
                                             int lvl) {
+  ASSERT_UNCHECKED;
   if (node->type() == nullptr) { // var
     node->initializer()->accept(this, lvl + 2);
     if (node->initializer()->is_typed(cdk::TYPE_VOID)) {
       throw std::string("cannot declare variable of type void");
     } else if (node->initializer()->is_typed(
                    cdk::TYPE_UNSPEC)) { // (var x (read))
-      node->initializer()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+      node->initializer()->type(til::make_primitive_type(4, cdk::TYPE_INT));
     } else if (node->initializer()->is_typed(cdk::TYPE_POINTER)) {
       auto ref = cdk::reference_type::cast(node->initializer()->type());
       if (ref->referenced()->name() ==
           cdk::TYPE_UNSPEC) { // (var x (objects 5))
-        node->initializer()->type(cdk::reference_type::create(
-            4, cdk::primitive_type::create(4, cdk::TYPE_INT)));
+        node->initializer()->type(til::make_reference_type(
+            4, til::make_primitive_type(4, cdk::TYPE_INT)));
       }
     }
     node->type(node->initializer()->type());
@@ -551,10 +635,10 @@ void til::type_checker::do_declaration_node(til::declaration_node *const node,
       if (node->initializer()->is_typed(cdk::TYPE_UNSPEC)) { // (read)
         if (node->is_typed(cdk::TYPE_DOUBLE)) {
           node->initializer()->type(
-              cdk::primitive_type::create(8, cdk::TYPE_DOUBLE));
+              til::make_primitive_type(8, cdk::TYPE_DOUBLE));
         } else if (node->is_typed(cdk::TYPE_INT)) {
           node->initializer()->type(
-              cdk::primitive_type::create(4, cdk::TYPE_INT));
+              til::make_primitive_type(4, cdk::TYPE_INT));
         } else {
           throw std::string(
               "conflicting initializer expression type for variable'" +
@@ -581,32 +665,30 @@ void til::type_checker::do_declaration_node(til::declaration_node *const node,
     }
   }
 
-  auto new_symbol =
-      til::make_symbol(node->identifier(), node->type(), node->qualifier());
-  if (!_symtab.insert(new_symbol->name(), new_symbol)) {
+  auto new_symbol = til::make_symbol(node->identifier_handle(), node->type(),
+                                     node->qualifier());
+  if (!_symtab.insert(new_symbol->handle(), new_symbol)) {
     // Redeclaration of variable
-    const auto previous_symbol = _symtab.find(node->identifier());
+    const auto previous_symbol = _symtab.find(new_symbol->handle());
     if (deep_compare_types(previous_symbol->type(), new_symbol->type(),
                            false)) {
       throw std::string("redeclaration of variable '" + node->identifier() +
                         "' with conflicting type");
     }
-    _symtab.replace(new_symbol->name(), new_symbol);
-    _parent->set_new_symbol(new_symbol);
-    return;
+    _symtab.replace(new_symbol->handle(), new_symbol);
   }
-  _parent->set_new_symbol(new_symbol);
 }
 
 //---------------------------------------------------------------------------
 
 void til::type_checker::do_sizeof_node(til::sizeof_node *const node, int lvl) {
+  ASSERT_UNCHECKED;
   ASSERT_UNSPEC;
   node->argument()->accept(this, lvl + 2);
 
   if (node->argument()->is_typed(cdk::TYPE_UNSPEC)) {
-    node->argument()->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+    node->argument()->type(til::make_primitive_type(4, cdk::TYPE_INT));
   }
 
-  node->type(cdk::primitive_type::create(4, cdk::TYPE_INT));
+  node->type(til::make_primitive_type(4, cdk::TYPE_INT));
   }
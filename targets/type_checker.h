@@ -3,19 +3,27 @@
 
 #include "targets/basic_ast_visitor.h"
 
+#include <unordered_set>
+
 namespace til {
 
   /**
-   * Print nodes as XML elements to the output stream.
+   * Annotate the whole syntax tree with types.
+   *
+   * The checker runs once, over the complete tree, before any code generation
+   * visitor: every node is visited (and checked) exactly once and the writers
+   * only consume the types left on the nodes.
    */
   class type_checker: public basic_ast_visitor {
-    cdk::symbol_table<til::symbol> &_symtab;
+    til::symbol_table &_symtab;
 
-    basic_ast_visitor *_parent;
+    std::unordered_set<const cdk::basic_node *> _checked; // nodes already checked
+    size_t _visits = 0; // number of do_* calls (should match _checked.size())
+    size_t _errors = 0;
 
   public:
-    type_checker(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<til::symbol> &symtab, basic_ast_visitor *parent) :
-        basic_ast_visitor(compiler), _symtab(symtab), _parent(parent) {
+    type_checker(std::shared_ptr<cdk::compiler> compiler, til::symbol_table &symtab) :
+        basic_ast_visitor(compiler), _symtab(symtab) {
     }
 
   public:
@@ -23,7 +31,27 @@ namespace til {
       os().flush();
     }
 
+  public:
+    size_t visits() const {
+      return _visits;
+    }
+    size_t checked() const {
+      return _checked.size();
+    }
+    bool checked(const cdk::basic_node *node) const {
+      return _checked.count(node) > 0;
+    }
+    size_t errors() const {
+      return _errors;
+    }
+
   protected:
+    /** Count the visit and mark the node as checked (false if it already was). */
+    bool mark_checked(const cdk::basic_node *node) {
+      _visits++;
+      return _checked.insert(node).second;
+    }
+
     bool deep_compare_types(std::shared_ptr<cdk::basic_type> left, std::shared_ptr<cdk::basic_type> right, bool relax);
     void processUnaryExpression(cdk::unary_operation_node *const node, int lvl);
     void processBinaryExpression(cdk::binary_operation_node *const node, int lvl);
@@ -42,21 +70,4 @@ namespace til {
 
 } // til
 
-//---------------------------------------------------------------------------
-//     HELPER MACRO FOR TYPE CHECKING
-//---------------------------------------------------------------------------
-
-#define CHECK_TYPES(compiler, symtab, node) { \
-  try { \
-    til::type_checker checker(compiler, symtab, this); \
-    (node)->accept(&checker, 0); \
-  } \
-  catch (const std::string &problem) { \
-    std::cerr << (node)->lineno() << ": " << problem << std::endl; \
-    return; \
-  } \
-}
-
-#define ASSERT_SAFE_EXPRESSIONS CHECK_TYPES(_compiler, _symtab, node)
-
 #endif
@@ -0,0 +1,896 @@
+#include "targets/x64_backend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+  enum {
+    RAX, RCX, RDX, RBX, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15, GP_COUNT
+  };
+
+  const char *const names64[] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsi", "%rdi", "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"
+  };
+  const char *const names32[] = {
+    "%eax", "%ecx", "%edx", "%ebx", "%esi", "%edi", "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"
+  };
+
+  // rax, rcx and rdx are scratch; xmm0 and xmm1 too
+  const int callee_saved[] = { RBX, R12, R13, R14, R15 };
+  const int caller_saved[] = { RSI, RDI, R8, R9, R10, R11 };
+  const int argument_registers[] = { RDI, RSI, RDX, RCX, R8, R9 };
+  const int first_xmm = 2, xmm_count = 16, xmm_arguments = 8;
+
+  std::string gp(int reg, til::ir::type type) {
+    return type == til::ir::type::PTR ? names64[reg] : names32[reg];
+  }
+
+  std::string xmm(int reg) {
+    return "%xmm" + std::to_string(reg);
+  }
+
+  const char *suffix(til::ir::type type) {
+    return type == til::ir::type::PTR ? "q" : "l";
+  }
+
+  std::string frame(int offset) {
+    return std::to_string(offset) + "(%rbp)";
+  }
+
+  bool is_register(const std::string &operand) {
+    return operand[0] == '%';
+  }
+
+  bool is_fusable(til::ir::opcode op) {
+    switch (op) {
+      case til::ir::opcode::EQ: case til::ir::opcode::NE: case til::ir::opcode::LT:
+      case til::ir::opcode::LE: case til::ir::opcode::GT: case til::ir::opcode::GE:
+      case til::ir::opcode::DLT: case til::ir::opcode::DLE: case til::ir::opcode::DGT: case til::ir::opcode::DGE:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  std::string inverse(const std::string &cc) {
+    static const char *const pairs[][2] = {
+      { "e", "ne" }, { "l", "ge" }, { "le", "g" }, { "a", "be" }, { "ae", "b" }
+    };
+    for (auto &pair : pairs) {
+      if (cc == pair[0]) return pair[1];
+      if (cc == pair[1]) return pair[0];
+    }
+    return cc;
+  }
+
+}
+
+//---------------------------------------------------------------------------
+
+bool til::x64_backend::rematerialized(const ir::instruction *value) {
+  switch (value->op) {
+    case ir::opcode::CONST:
+    case ir::opcode::DCONST:
+    case ir::opcode::STRING:
+    case ir::opcode::SYMBOL:
+    case ir::opcode::UNDEF:
+    case ir::opcode::SLOT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool til::x64_backend::is_external(const std::string &name) const {
+  return _module->externals.count(name) > 0;
+}
+
+std::string til::x64_backend::double_label(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  auto it = _doubles.find(bits);
+  if (it == _doubles.end())
+    it = _doubles.emplace(bits, ".LD" + std::to_string(_doubles.size())).first;
+  return it->second;
+}
+
+std::string til::x64_backend::string_label(const std::string &value) {
+  auto it = _strings.find(value);
+  if (it == _strings.end())
+    it = _strings.emplace(value, ".LS" + std::to_string(_strings.size())).first;
+  return it->second;
+}
+
+//---------------------------------------------------------------------------
+
+void til::x64_backend::emit(const ir::module &m) {
+  _module = &m;
+  for (auto &g : m.globals)
+    emit_global(g);
+  for (auto &f : m.functions)
+    emit_function(*f);
+
+  if (!_doubles.empty() || !_strings.empty()) {
+    _os << "\t.section .rodata" << std::endl;
+    for (auto &d : _doubles)
+      _os << "\t.align 8" << std::endl << d.second << ":\n\t.quad 0x" << std::hex << d.first << std::dec << std::endl;
+    for (auto &s : _strings) {
+      _os << s.second << ":\n\t.string \"";
+      for (unsigned char c : s.first) {
+        if (c == '"' || c == '\\')
+          _os << '\\' << c;
+        else if (c < 32 || c >= 127)
+          _os << '\\' << std::oct << std::setw(3) << std::setfill('0') << (int)c << std::dec;
+        else
+          _os << c;
+      }
+      _os << "\"" << std::endl;
+    }
+  }
+  _os << "\t.section .note.GNU-stack,\"\",@progbits" << std::endl;
+  _module = nullptr;
+}
+
+void til::x64_backend::emit_global(const ir::global &g) {
+  size_t size = g.type == ir::type::INT ? 4 : 8;
+  _os << (g.kind == ir::global::init::ZERO ? "\t.bss" : "\t.data") << std::endl;
+  _os << "\t.align " << size << std::endl;
+  if (g.exported)
+    _os << "\t.globl " << g.name << std::endl;
+  _os << "\t.type " << g.name << ", @object\n\t.size " << g.name << ", " << size << std::endl;
+  _os << g.name << ":" << std::endl;
+  switch (g.kind) {
+    case ir::global::init::ZERO:
+      _os << "\t.zero " << size << std::endl;
+      break;
+    case ir::global::init::INT:
+      _os << (size == 4 ? "\t.long " : "\t.quad ") << g.i << std::endl;
+      break;
+    case ir::global::init::DOUBLE: {
+      uint64_t bits;
+      std::memcpy(&bits, &g.d, sizeof bits);
+      _os << "\t.quad 0x" << std::hex << bits << std::dec << std::endl;
+      break;
+    }
+    case ir::global::init::STRING:
+      _os << "\t.quad " << string_label(g.s) << std::endl;
+      break;
+    case ir::global::init::SYMBOL:
+      _os << "\t.quad " << g.s << std::endl;
+      break;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::x64_backend::allocate(const ir::function &f) {
+  _locations.clear();
+  _uses.clear();
+  _positions.clear();
+  _labels.clear();
+  _fused.clear();
+  _params.clear();
+  _homing.clear();
+  _saved.clear();
+  _frame = 0;
+
+  auto order = f.reverse_postorder();
+  for (auto &b : f.blocks)
+    for (auto &instr : b->code)
+      for (auto arg : instr->args)
+        _uses[arg]++;
+  auto allocated = [&](const ir::instruction *v) {
+    return !rematerialized(v) && v->type != ir::type::VOID && _uses[v] > 0;
+  };
+
+  // a comparison used only by the branch that follows sets the flags for it
+  for (auto b : order) {
+    auto n = b->code.size();
+    auto term = b->terminator();
+    if (n >= 2 && term->op == ir::opcode::BR && term->args[0] == b->code[n - 2].get() &&
+        is_fusable(b->code[n - 2]->op) && _uses[term->args[0]] == 1)
+      _fused.insert(term->args[0]);
+  }
+
+  // positions: two per instruction, and one after each block (edge copies)
+  std::unordered_map<const ir::block *, int> first, last;
+  std::vector<int> calls;
+  int n = 0;
+  for (auto b : order) {
+    _labels[b] = mklbl();
+    first[b] = n;
+    for (auto &instr : b->code) {
+      _positions[instr.get()] = n;
+      if (instr->op == ir::opcode::CALL || instr->op == ir::opcode::CALLI)
+        calls.push_back(n);
+      n += 2;
+    }
+    last[b] = n;
+    n += 2;
+  }
+
+  // liveness (PHI operands are live at the end of their predecessors)
+  std::unordered_map<const ir::block *, std::unordered_set<const ir::instruction *>> live_in, live_out;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto b = order.rbegin(); b != order.rend(); ++b) {
+      std::unordered_set<const ir::instruction *> out;
+      for (auto s : (*b)->successors()) {
+        for (auto v : live_in[s])
+          if (!(v->op == ir::opcode::PHI && v->parent == s))
+            out.insert(v);
+        for (auto &phi : s->code) {
+          if (phi->op != ir::opcode::PHI)
+            break;
+          for (size_t k = 0; k < phi->blocks.size(); k++)
+            if (phi->blocks[k] == *b && allocated(phi->args[k]))
+              out.insert(phi->args[k]);
+        }
+      }
+      auto in = out;
+      for (auto instr = (*b)->code.rbegin(); instr != (*b)->code.rend(); ++instr) {
+        in.erase(instr->get());
+        if ((*instr)->op == ir::opcode::PHI) {
+          if (allocated(instr->get()))
+            in.insert(instr->get());
+          continue;
+        }
+        for (auto arg : (*instr)->args)
+          if (allocated(arg))
+            in.insert(arg);
+      }
+      if (in != live_in[*b] || out != live_out[*b]) {
+        live_in[*b] = std::move(in);
+        live_out[*b] = std::move(out);
+        changed = true;
+      }
+    }
+  }
+
+  // one interval per value, from its first to its last live position
+  std::unordered_map<const ir::instruction *, interval> intervals;
+  auto touch = [&](const ir::instruction *v, int p) {
+    auto it = intervals.find(v);
+    if (it == intervals.end()) {
+      intervals.emplace(v, interval { v, p, p, false });
+    } else {
+      it->second.start = std::min(it->second.start, p);
+      it->second.end = std::max(it->second.end, p);
+    }
+  };
+  for (auto b : order) {
+    for (auto &instr : b->code) {
+      if (allocated(instr.get()))
+        touch(instr.get(), _positions[instr.get()]);
+      if (instr->op == ir::opcode::PHI) {
+        if (allocated(instr.get()))
+          for (auto pred : instr->blocks)
+            touch(instr.get(), last[pred]); // written on the edge
+        continue;
+      }
+      for (auto arg : instr->args)
+        if (allocated(arg))
+          touch(arg, _positions[instr.get()]);
+    }
+    for (auto v : live_in[b])
+      touch(v, first[b]);
+    for (auto v : live_out[b])
+      touch(v, last[b]);
+  }
+
+  std::vector<interval> sorted;
+  for (auto &i : intervals) {
+    auto &iv = i.second;
+    iv.crosses_call = std::any_of(calls.begin(), calls.end(), [&](int c) { return iv.start < c && c < iv.end; });
+    sorted.push_back(iv);
+  }
+  std::sort(sorted.begin(), sorted.end(), [&](const interval &a, const interval &b) {
+    return a.start != b.start ? a.start < b.start : _positions[a.value] < _positions[b.value];
+  });
+
+  // linear scan
+  std::vector<bool> gp_free(GP_COUNT, false), xmm_free(xmm_count, false);
+  for (int r : callee_saved) gp_free[r] = true;
+  for (int r : caller_saved) gp_free[r] = true;
+  for (int r = first_xmm; r < xmm_count; r++) xmm_free[r] = true;
+  std::vector<bool> used(GP_COUNT, false);
+  std::vector<const interval *> active;
+  std::vector<const ir::instruction *> spilled;
+
+  auto is_callee_saved = [](int r) {
+    return std::find(std::begin(callee_saved), std::end(callee_saved), r) != std::end(callee_saved);
+  };
+  auto release = [&](const interval *iv) {
+    int r = _locations[iv->value].reg;
+    (iv->value->type == ir::type::DOUBLE ? xmm_free : gp_free)[r] = true;
+  };
+
+  for (auto &iv : sorted) {
+    for (auto a = active.begin(); a != active.end();) {
+      if ((*a)->end < iv.start) {
+        release(*a);
+        a = active.erase(a);
+      } else {
+        ++a;
+      }
+    }
+
+    bool x = iv.value->type == ir::type::DOUBLE;
+    int reg = -1;
+    if (x) {
+      for (int r = first_xmm; r < xmm_count && reg < 0 && !iv.crosses_call; r++)
+        if (xmm_free[r]) reg = r;
+    } else {
+      if (!iv.crosses_call)
+        for (int r : caller_saved)
+          if (reg < 0 && gp_free[r]) reg = r;
+      for (int r : callee_saved)
+        if (reg < 0 && gp_free[r]) reg = r;
+    }
+
+    if (reg < 0) {
+      // spill the interval ending last (this one, or one whose register fits)
+      const interval *victim = nullptr;
+      bool usable = !(x && iv.crosses_call);
+      for (auto a : active) {
+        if ((a->value->type == ir::type::DOUBLE) != x || a->end <= iv.end || !usable)
+          continue;
+        if (!x && iv.crosses_call && !is_callee_saved(_locations[a->value].reg))
+          continue;
+        if (victim == nullptr || a->end > victim->end)
+          victim = a;
+      }
+      if (victim == nullptr) {
+        spilled.push_back(iv.value);
+        continue;
+      }
+      reg = _locations[victim->value].reg;
+      _locations[victim->value].reg = -1;
+      spilled.push_back(victim->value);
+      active.erase(std::find(active.begin(), active.end(), victim));
+    }
+
+    (x ? xmm_free : gp_free)[reg] = false;
+    if (!x) used[reg] = true;
+    _locations[iv.value].reg = reg;
+    active.push_back(&iv);
+  }
+
+  for (int r : callee_saved)
+    if (used[r]) _saved.push_back(r);
+  int base = 8 * _saved.size();
+  auto reserve = [&](int size) {
+    _frame += (size + 7) / 8 * 8;
+    return -(base + _frame);
+  };
+
+  // frame: SLOTs, the arguments passed in registers, spills
+  for (auto &b : f.blocks)
+    for (auto &instr : b->code)
+      if (instr->op == ir::opcode::SLOT)
+        _locations[instr.get()].spill = reserve(instr->i);
+
+  size_t ngp = 0, nxmm = 0, nstack = 0;
+  for (auto type : f.params) {
+    if (type == ir::type::DOUBLE ? nxmm < xmm_arguments : ngp < std::size(argument_registers)) {
+      auto home = frame(reserve(8));
+      if (type == ir::type::DOUBLE)
+        _homing.push_back("movsd " + xmm(nxmm++) + ", " + home);
+      else
+        _homing.push_back(std::string("mov") + suffix(type) + " " + gp(argument_registers[ngp++], type) + ", " + home);
+      _params.push_back(home);
+    } else {
+      _params.push_back(frame(16 + 8 * nstack++));
+    }
+  }
+
+  for (auto v : spilled)
+    _locations[v].spill = reserve(8);
+  _registers += sorted.size() - spilled.size();
+  _spills += spilled.size();
+
+  if ((base + _frame) % 16 != 0)
+    _frame += 8;
+}
+
+//---------------------------------------------------------------------------
+
+void til::x64_backend::emit_function(const ir::function &f) {
+  allocate(f);
+
+  _os << "\t.text\n\t.p2align 4" << std::endl;
+  if (f.exported)
+    _os << "\t.globl " << f.name << std::endl;
+  _os << "\t.type " << f.name << ", @function" << std::endl;
+  _os << f.name << ":" << std::endl;
+  _os << "\tpushq %rbp\n\tmovq %rsp, %rbp" << std::endl;
+  for (int r : _saved)
+    _os << "\tpushq " << names64[r] << std::endl;
+  if (_frame > 0)
+    _os << "\tsubq $" << _frame << ", %rsp" << std::endl;
+  for (auto &home : _homing)
+    _os << "\t" << home << std::endl;
+
+  auto order = f.reverse_postorder();
+  for (size_t k = 0; k < order.size(); k++) {
+    auto b = order[k];
+    _next = k + 1 < order.size() ? order[k + 1] : nullptr;
+    _os << _labels[b] << ":" << std::endl;
+    for (auto &instr : b->code)
+      if (!rematerialized(instr.get()) && instr->op != ir::opcode::PHI && _fused.count(instr.get()) == 0)
+        emit_instruction(instr.get());
+  }
+  _os << "\t.size " << f.name << ", .-" << f.name << std::endl;
+}
+
+void til::x64_backend::emit_return() {
+  if (_saved.empty()) {
+    _os << "\tleave\n\tret" << std::endl;
+    return;
+  }
+  _os << "\tleaq " << -8 * (int)_saved.size() << "(%rbp), %rsp" << std::endl;
+  for (auto r = _saved.rbegin(); r != _saved.rend(); ++r)
+    _os << "\tpopq " << names64[*r] << std::endl;
+  _os << "\tpopq %rbp\n\tret" << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+std::string til::x64_backend::source(const ir::instruction *value, int scratch) {
+  switch (value->op) {
+    case ir::opcode::CONST:
+      return "$" + std::to_string(value->i);
+    case ir::opcode::UNDEF:
+      return "$0";
+    case ir::opcode::SYMBOL:
+    case ir::opcode::STRING:
+    case ir::opcode::SLOT:
+      load_address(value, scratch);
+      return names64[scratch];
+    default: {
+      auto &loc = _locations.at(value);
+      return loc.reg >= 0 ? gp(loc.reg, value->type) : frame(loc.spill);
+    }
+  }
+}
+
+std::string til::x64_backend::xsource(const ir::instruction *value, int scratch) {
+  switch (value->op) {
+    case ir::opcode::DCONST:
+      return double_label(value->d) + "(%rip)";
+    case ir::opcode::UNDEF:
+      _os << "\tpxor " << xmm(scratch) << ", " << xmm(scratch) << std::endl;
+      return xmm(scratch);
+    default: {
+      auto &loc = _locations.at(value);
+      return loc.reg >= 0 ? xmm(loc.reg) : frame(loc.spill);
+    }
+  }
+}
+
+void til::x64_backend::into(const ir::instruction *value, int reg) {
+  auto operand = source(value, reg);
+  if (operand != gp(reg, value->type))
+    _os << "\tmov" << suffix(value->type) << " " << operand << ", " << gp(reg, value->type) << std::endl;
+}
+
+void til::x64_backend::xinto(const ir::instruction *value, int reg) {
+  auto operand = xsource(value, reg);
+  if (operand != xmm(reg))
+    _os << "\tmovsd " << operand << ", " << xmm(reg) << std::endl;
+}
+
+void til::x64_backend::load_address(const ir::instruction *value, int reg) {
+  if (value->op == ir::opcode::SLOT)
+    _os << "\tleaq " << frame(_locations.at(value).spill) << ", " << names64[reg] << std::endl;
+  else if (value->op == ir::opcode::STRING)
+    _os << "\tleaq " << string_label(value->s) << "(%rip), " << names64[reg] << std::endl;
+  else if (is_external(value->s))
+    _os << "\tmovq " << value->s << "@GOTPCREL(%rip), " << names64[reg] << std::endl;
+  else
+    _os << "\tleaq " << value->s << "(%rip), " << names64[reg] << std::endl;
+}
+
+// a memory operand for LOAD and STORE (may use rcx)
+std::string til::x64_backend::memory(const ir::instruction *address) {
+  if (address->op == ir::opcode::SLOT)
+    return frame(_locations.at(address).spill);
+  if (address->op == ir::opcode::SYMBOL && !is_external(address->s))
+    return address->s + "(%rip)";
+  if (!rematerialized(address) && _locations.at(address).reg >= 0)
+    return std::string("(") + names64[_locations.at(address).reg] + ")";
+  into(address, RCX);
+  return "(%rcx)";
+}
+
+// a register to compute the value in: its own, unless the operand (read
+// after the first) is there
+int til::x64_backend::target(const ir::instruction *value, const ir::instruction *operand) const {
+  auto it = _locations.find(value);
+  if (it == _locations.end() || it->second.reg < 0)
+    return RAX;
+  if (operand != nullptr && !rematerialized(operand) && _locations.at(operand).reg == it->second.reg)
+    return RAX;
+  return it->second.reg;
+}
+
+void til::x64_backend::store_result(const ir::instruction *value, int reg) {
+  auto it = _locations.find(value);
+  if (it == _locations.end())
+    return; // unused
+  if (it->second.reg == reg)
+    return;
+  _os << "\tmov" << suffix(value->type) << " " << gp(reg, value->type) << ", "
+      << (it->second.reg >= 0 ? gp(it->second.reg, value->type) : frame(it->second.spill)) << std::endl;
+}
+
+void til::x64_backend::xstore_result(const ir::instruction *value, int reg) {
+  auto it = _locations.find(value);
+  if (it == _locations.end() || it->second.reg == reg)
+    return;
+  _os << "\tmovsd " << xmm(reg) << ", " << (it->second.reg >= 0 ? xmm(it->second.reg) : frame(it->second.spill))
+      << std::endl;
+}
+
+void til::x64_backend::push(const ir::instruction *value) {
+  if (value->type == ir::type::DOUBLE) {
+    auto operand = xsource(value, 1);
+    if (is_register(operand))
+      _os << "\tsubq $8, %rsp\n\tmovsd " << operand << ", (%rsp)" << std::endl;
+    else
+      _os << "\tpushq " << operand << std::endl;
+    return;
+  }
+  std::string operand;
+  if (rematerialized(value)) {
+    operand = source(value, RAX); // an immediate or rax
+  } else {
+    auto &loc = _locations.at(value);
+    operand = loc.reg >= 0 ? names64[loc.reg] : frame(loc.spill);
+  }
+  _os << "\tpushq " << operand << std::endl;
+}
+
+//---------------------------------------------------------------------------
+
+// PHIs of the target take their values for this edge: copied in turn if no
+// copy overwrites another's source, else all pushed and then popped
+void til::x64_backend::emit_edge(const ir::block *from, const ir::block *to) {
+  std::vector<std::pair<const ir::instruction *, const ir::instruction *>> copies; // (phi, value)
+  for (auto &instr : to->code) {
+    if (instr->op != ir::opcode::PHI)
+      break;
+    if (_locations.count(instr.get()) == 0)
+      continue; // unused
+    auto k = std::find(instr->blocks.begin(), instr->blocks.end(), from) - instr->blocks.begin();
+    copies.emplace_back(instr.get(), instr->args[k]);
+  }
+
+  auto same = [&](const ir::instruction *a, const ir::instruction *b) {
+    if (rematerialized(a) || rematerialized(b) || (a->type == ir::type::DOUBLE) != (b->type == ir::type::DOUBLE))
+      return false;
+    auto &la = _locations.at(a), &lb = _locations.at(b);
+    return la.reg >= 0 ? la.reg == lb.reg : la.spill == lb.spill;
+  };
+  bool overlap = false;
+  for (size_t i = 0; i < copies.size(); i++)
+    for (size_t j = 0; j < copies.size(); j++)
+      if (i != j && same(copies[i].first, copies[j].second))
+        overlap = true;
+
+  if (!overlap) {
+    for (auto &copy : copies) {
+      if (same(copy.first, copy.second))
+        continue;
+      if (copy.first->type == ir::type::DOUBLE) {
+        xinto(copy.second, 0);
+        xstore_result(copy.first, 0);
+      } else {
+        int reg = target(copy.first);
+        into(copy.second, reg);
+        store_result(copy.first, reg);
+      }
+    }
+  } else {
+    for (auto &copy : copies)
+      push(copy.second);
+    for (auto copy = copies.rbegin(); copy != copies.rend(); ++copy) {
+      auto &loc = _locations.at(copy->first);
+      if (loc.reg < 0)
+        _os << "\tpopq " << frame(loc.spill) << std::endl;
+      else if (copy->first->type == ir::type::DOUBLE)
+        _os << "\tmovsd (%rsp), " << xmm(loc.reg) << "\n\taddq $8, %rsp" << std::endl;
+      else
+        _os << "\tpopq " << names64[loc.reg] << std::endl;
+    }
+  }
+  if (to != _next)
+    _os << "\tjmp " << _labels.at(to) << std::endl;
+}
+
+bool til::x64_backend::has_copies(const ir::block *to) const {
+  for (auto &instr : to->code)
+    if (instr->op == ir::opcode::PHI && _locations.count(instr.get()) > 0)
+      return true;
+  return false;
+}
+
+std::string til::x64_backend::compare(const ir::instruction *condition) {
+  auto a = condition->args[0], b = condition->args[1];
+  switch (condition->op) {
+    case ir::opcode::DLT: case ir::opcode::DLE: // b > a, b >= a
+      xinto(b, 0);
+      _os << "\tucomisd " << xsource(a, 1) << ", %xmm0" << std::endl;
+      return condition->op == ir::opcode::DLT ? "a" : "ae";
+    case ir::opcode::DGT: case ir::opcode::DGE: case ir::opcode::DEQ: case ir::opcode::DNE:
+      xinto(a, 0);
+      _os << "\tucomisd " << xsource(b, 1) << ", %xmm0" << std::endl;
+      return condition->op == ir::opcode::DGT ? "a" : condition->op == ir::opcode::DGE ? "ae" : "e";
+    default:
+      break;
+  }
+  into(a, RAX);
+  _os << "\tcmp" << suffix(a->type) << " " << source(b, RCX) << ", " << gp(RAX, a->type) << std::endl;
+  switch (condition->op) {
+    case ir::opcode::EQ: return "e";
+    case ir::opcode::NE: return "ne";
+    case ir::opcode::LT: return "l";
+    case ir::opcode::LE: return "le";
+    case ir::opcode::GT: return "g";
+    default: return "ge";
+  }
+}
+
+void til::x64_backend::emit_call(const ir::instruction *call) {
+  bool indirect = call->op == ir::opcode::CALLI;
+  std::vector<const ir::instruction *> in_registers, on_stack;
+  std::vector<int> registers;
+  size_t ngp = 0, nxmm = 0;
+  for (size_t k = indirect ? 1 : 0; k < call->args.size(); k++) {
+    auto arg = call->args[k];
+    if (arg->type == ir::type::DOUBLE && nxmm < xmm_arguments) {
+      in_registers.push_back(arg);
+      registers.push_back(nxmm++);
+    } else if (arg->type != ir::type::DOUBLE && ngp < std::size(argument_registers)) {
+      in_registers.push_back(arg);
+      registers.push_back(argument_registers[ngp++]);
+    } else {
+      on_stack.push_back(arg);
+    }
+  }
+
+  // the values are pushed and then popped into the argument registers, so
+  // that no argument overwrites another one's register
+  size_t pad = on_stack.size() % 2 ? 8 : 0;
+  if (pad > 0)
+    _os << "\tsubq $8, %rsp" << std::endl;
+  for (auto arg = on_stack.rbegin(); arg != on_stack.rend(); ++arg)
+    push(*arg);
+  if (indirect)
+    push(call->args[0]);
+  for (auto arg : in_registers)
+    push(arg);
+  for (size_t k = in_registers.size(); k-- > 0;) {
+    if (in_registers[k]->type == ir::type::DOUBLE)
+      _os << "\tmovsd (%rsp), " << xmm(registers[k]) << "\n\taddq $8, %rsp" << std::endl;
+    else
+      _os << "\tpopq " << names64[registers[k]] << std::endl;
+  }
+  if (indirect)
+    _os << "\tpopq %r11" << std::endl;
+
+  _os << "\tmovl $" << nxmm << ", %eax" << std::endl; // for variadic C functions
+  if (indirect)
+    _os << "\tcall *%r11" << std::endl;
+  else
+    _os << "\tcall " << call->s << (is_external(call->s) ? "@PLT" : "") << std::endl;
+  if (!on_stack.empty() || pad > 0)
+    _os << "\taddq $" << 8 * on_stack.size() + pad << ", %rsp" << std::endl;
+
+  if (call->type == ir::type::DOUBLE)
+    xstore_result(call, 0);
+  else if (call->type != ir::type::VOID)
+    store_result(call, RAX);
+}
+
+//---------------------------------------------------------------------------
+
+void til::x64_backend::emit_instruction(const ir::instruction *instr) {
+  auto a = instr->args.empty() ? nullptr : instr->args[0];
+  auto b = instr->args.size() < 2 ? nullptr : instr->args[1];
+
+  switch (instr->op) {
+    case ir::opcode::PARAM:
+      if (instr->type == ir::type::DOUBLE) {
+        _os << "\tmovsd " << _params.at(instr->i) << ", %xmm0" << std::endl;
+        xstore_result(instr, 0);
+      } else {
+        int reg = target(instr);
+        _os << "\tmov" << suffix(instr->type) << " " << _params.at(instr->i) << ", " << gp(reg, instr->type)
+            << std::endl;
+        store_result(instr, reg);
+      }
+      break;
+
+    case ir::opcode::ADD: case ir::opcode::SUB: case ir::opcode::MUL: {
+      const char *op = instr->op == ir::opcode::ADD ? "addl" : instr->op == ir::opcode::SUB ? "subl" : "imull";
+      int reg = target(instr, b);
+      into(a, reg);
+      _os << "\t" << op << " " << source(b, RCX) << ", " << gp(reg, ir::type::INT) << std::endl;
+      store_result(instr, reg);
+      break;
+    }
+    case ir::opcode::DIV: case ir::opcode::MOD:
+      into(a, RAX);
+      _os << "\tcltd" << std::endl;
+      into(b, RCX);
+      _os << "\tidivl %ecx" << std::endl;
+      store_result(instr, instr->op == ir::opcode::DIV ? RAX : RDX);
+      break;
+    case ir::opcode::NEG: {
+      int reg = target(instr);
+      into(a, reg);
+      _os << "\tnegl " << gp(reg, ir::type::INT) << std::endl;
+      store_result(instr, reg);
+      break;
+    }
+
+    case ir::opcode::DADD: case ir::opcode::DSUB: case ir::opcode::DMUL: case ir::opcode::DDIV: {
+      const char *op = instr->op == ir::opcode::DADD ? "addsd" : instr->op == ir::opcode::DSUB ? "subsd"
+                       : instr->op == ir::opcode::DMUL ? "mulsd" : "divsd";
+      xinto(a, 0);
+      _os << "\t" << op << " " << xsource(b, 1) << ", %xmm0" << std::endl;
+      xstore_result(instr, 0);
+      break;
+    }
+    case ir::opcode::DNEG:
+      xinto(a, 0);
+      _os << "\tmovq %xmm0, %rax\n\tbtcq $63, %rax\n\tmovq %rax, %xmm0" << std::endl;
+      xstore_result(instr, 0);
+      break;
+    case ir::opcode::I2D: {
+      auto operand = source(a, RAX);
+      if (operand[0] == '$') {
+        into(a, RAX);
+        operand = "%eax";
+      }
+      _os << "\tcvtsi2sdl " << operand << ", %xmm0" << std::endl;
+      xstore_result(instr, 0);
+      break;
+    }
+
+    case ir::opcode::DEQ: case ir::opcode::DNE:
+      compare(instr);
+      if (instr->op == ir::opcode::DEQ)
+        _os << "\tsete %al\n\tsetnp %cl\n\tandb %cl, %al" << std::endl; // unordered is not equal
+      else
+        _os << "\tsetne %al\n\tsetp %cl\n\torb %cl, %al" << std::endl;
+      _os << "\tmovzbl %al, %eax" << std::endl;
+      store_result(instr, RAX);
+      break;
+    case ir::opcode::EQ: case ir::opcode::NE: case ir::opcode::LT: case ir::opcode::LE:
+    case ir::opcode::GT: case ir::opcode::GE: case ir::opcode::DLT: case ir::opcode::DLE:
+    case ir::opcode::DGT: case ir::opcode::DGE:
+      _os << "\tset" << compare(instr) << " %al\n\tmovzbl %al, %eax" << std::endl;
+      store_result(instr, RAX);
+      break;
+
+    case ir::opcode::PTRADD: {
+      int reg = target(instr, b);
+      into(a, reg);
+      if (b->op == ir::opcode::CONST) {
+        if (b->i != 0)
+          _os << "\taddq $" << b->i << ", " << names64[reg] << std::endl;
+      } else {
+        into(b, RCX); // movslq has no immediate form (b may be UNDEF)
+        _os << "\tmovslq %ecx, %rcx\n\taddq %rcx, " << names64[reg] << std::endl;
+      }
+      store_result(instr, reg);
+      break;
+    }
+    case ir::opcode::PTRDIFF:
+      into(a, RAX);
+      _os << "\tsubq " << source(b, RCX) << ", %rax" << std::endl;
+      store_result(instr, RAX);
+      break;
+
+    case ir::opcode::ALLOCA:
+      into(a, RAX);
+      _os << "\tcltq\n\taddq $15, %rax\n\tandq $-16, %rax\n\tsubq %rax, %rsp\n\tmovq %rsp, %rax" << std::endl;
+      store_result(instr, RAX);
+      break;
+    case ir::opcode::LOAD: {
+      auto address = memory(a);
+      if (instr->type == ir::type::DOUBLE) {
+        _os << "\tmovsd " << address << ", %xmm0" << std::endl;
+        xstore_result(instr, 0);
+      } else {
+        int reg = target(instr);
+        _os << "\tmov" << suffix(instr->type) << " " << address << ", " << gp(reg, instr->type) << std::endl;
+        store_result(instr, reg);
+      }
+      break;
+    }
+    case ir::opcode::STORE: {
+      auto address = memory(b);
+      if (a->type == ir::type::DOUBLE) {
+        auto operand = xsource(a, 0);
+        if (!is_register(operand)) {
+          _os << "\tmovsd " << operand << ", %xmm0" << std::endl;
+          operand = "%xmm0";
+        }
+        _os << "\tmovsd " << operand << ", " << address << std::endl;
+      } else {
+        auto operand = source(a, RAX);
+        if (!is_register(operand) && operand[0] != '$') {
+          into(a, RAX);
+          operand = gp(RAX, a->type);
+        }
+        _os << "\tmov" << suffix(a->type) << " " << operand << ", " << address << std::endl;
+      }
+      break;
+    }
+
+    case ir::opcode::CALL:
+    case ir::opcode::CALLI:
+      emit_call(instr);
+      break;
+
+    case ir::opcode::JMP:
+      emit_edge(instr->parent, instr->blocks[0]);
+      break;
+    case ir::opcode::BR: {
+      std::string cc = "ne";
+      if (_fused.count(a) > 0) {
+        cc = compare(a);
+      } else {
+        auto operand = source(a, RAX);
+        if (operand[0] == '$') {
+          into(a, RAX);
+          operand = "%eax";
+        }
+        _os << "\tcmpl $0, " << operand << std::endl;
+      }
+      auto then = instr->blocks[0], otherwise = instr->blocks[1];
+      if (otherwise == _next && !has_copies(then) && !has_copies(otherwise)) {
+        _os << "\tj" << cc << " " << _labels.at(then) << std::endl; // falls through
+        break;
+      }
+      bool copies = has_copies(otherwise);
+      auto edge = copies ? mklbl() : _labels.at(otherwise);
+      _os << "\tj" << inverse(cc) << " " << edge << std::endl;
+      emit_edge(instr->parent, then);
+      if (copies) {
+        _os << edge << ":" << std::endl;
+        auto next = _next;
+        _next = nullptr; // the edge block is not followed by the target
+        emit_edge(instr->parent, otherwise);
+        _next = next;
+      }
+      break;
+    }
+    case ir::opcode::RET:
+      if (a != nullptr) {
+        if (a->type == ir::type::DOUBLE)
+          xinto(a, 0);
+        else
+          into(a, RAX);
+      }
+      emit_return();
+      break;
+
+    default:
+      break;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void til::x64_backend::report(std::ostream &os) const {
+  os << "x64 backend: " << _registers << " values in registers, " << _spills << " spilled" << std::endl;
+}
@@ -0,0 +1,113 @@
+#ifndef __TIL_TARGETS_X64_BACKEND_H__
+#define __TIL_TARGETS_X64_BACKEND_H__
+
+#include "targets/ir.h"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace til {
+
+  /**
+   * Emit x86-64 assembly (GNU as, AT&T syntax) for an IR module.
+   *
+   * Values get registers by linear scan (Poletto and Sarkar, 1999) over the
+   * blocks in reverse post-order: each value has a single live interval and,
+   * when registers run out, the interval ending last is spilled to the frame.
+   * Values live across a call only get callee-saved registers (doubles are
+   * spilled: System V has no callee-saved XMM registers). Constants and
+   * addresses are computed where used. Every call follows the System V AMD64
+   * convention, so TIL functions and external C functions are called alike.
+   * Doubles use SSE2.
+   *
+   * The module must be built with 8-byte addresses.
+   */
+  class x64_backend {
+    struct location {
+      int reg = -1;  // general purpose or XMM register (by the value's type)
+      int spill = 0; // frame offset, if not in a register
+    };
+
+    struct interval {
+      const ir::instruction *value;
+      int start, end;
+      bool crosses_call;
+    };
+
+    std::ostream &_os;
+    const ir::module *_module = nullptr;
+
+    // per function
+    std::unordered_map<const ir::instruction *, location> _locations;
+    std::unordered_map<const ir::instruction *, int> _uses;
+    std::unordered_map<const ir::instruction *, int> _positions;
+    std::unordered_map<const ir::block *, std::string> _labels;
+    const ir::block *_next = nullptr; // emitted after the current block
+    std::unordered_set<const ir::instruction *> _fused; // comparisons emitted with their branch
+    std::vector<std::string> _params;                  // where the arguments are
+    std::vector<std::string> _homing;                  // argument registers stored on entry
+    std::vector<int> _saved;                           // callee-saved registers used
+    int _frame = 0;                                    // below the saved registers
+
+    std::map<uint64_t, std::string> _doubles; // by bit pattern
+    std::map<std::string, std::string> _strings;
+    int _lbl = 0;
+    size_t _registers = 0, _spills = 0;
+
+  public:
+    x64_backend(std::ostream &os) :
+        _os(os) {
+    }
+
+  public:
+    void emit(const ir::module &m);
+
+    /** Print how many values got registers. */
+    void report(std::ostream &os) const;
+
+  private:
+    void emit_global(const ir::global &g);
+    void emit_function(const ir::function &f);
+    void emit_instruction(const ir::instruction *instr);
+    void emit_return();
+
+    // register allocation
+    void allocate(const ir::function &f);
+    static bool rematerialized(const ir::instruction *value);
+
+    // operands
+    std::string source(const ir::instruction *value, int scratch);
+    std::string xsource(const ir::instruction *value, int scratch);
+    void into(const ir::instruction *value, int reg);
+    void xinto(const ir::instruction *value, int reg);
+    void load_address(const ir::instruction *value, int reg);
+    std::string memory(const ir::instruction *address);
+    int target(const ir::instruction *value, const ir::instruction *operand = nullptr) const;
+    void store_result(const ir::instruction *value, int reg);
+    void xstore_result(const ir::instruction *value, int reg);
+    void push(const ir::instruction *value);
+
+    // control flow
+    void emit_edge(const ir::block *from, const ir::block *to);
+    bool has_copies(const ir::block *to) const;
+    std::string compare(const ir::instruction *condition); // the condition code
+    void emit_call(const ir::instruction *call);
+
+    std::string double_label(double value);
+    std::string string_label(const std::string &value);
+    bool is_external(const std::string &name) const;
+
+    std::string mklbl() {
+      return ".LX" + std::to_string(++_lbl);
+    }
+
+  };
+
+} // til
+
+#endif
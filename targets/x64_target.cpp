@@ -0,0 +1,7 @@
+#include "targets/x64_target.h"
+
+/**
+ * Native code for x86-64.
+ * @var create and register an evaluator for X64 targets.
+ */
+til::x64_target til::x64_target::_self;
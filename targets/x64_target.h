@@ -0,0 +1,57 @@
+#ifndef __TIL_TARGETS_X64_TARGET_H__
+#define __TIL_TARGETS_X64_TARGET_H__
+
+#include <cdk/targets/basic_target.h>
+#include <cdk/ast/basic_node.h>
+#include "targets/front_end.h"
+#include "targets/x64_backend.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
+
+namespace til {
+
+  /**
+   * Native x86-64 code (GNU assembler), through the intermediate representation.
+   *
+   *   til --target x64 prog.til -o prog.s
+   *   gcc -o prog prog.s runtime/libtilrt64.a
+   */
+  class x64_target: public cdk::basic_target {
+    static x64_target _self;
+
+  private:
+    x64_target() :
+        cdk::basic_target("x64") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
+      front_end front(compiler);
+      auto module = front.analyse() ? front.build_ir(8) : nullptr;
+      if (module == nullptr) {
+        report.print_if_requested(std::cerr);
+        return false;
+      }
+
+      x64_backend backend(*compiler->ostream());
+      {
+        til::scoped_pass pass("code generation");
+        backend.emit(*module);
+        compiler->ostream()->flush();
+      }
+      if (compiler->debug())
+        backend.report(std::cerr);
+
+      report.print_if_requested(std::cerr);
+      return true;
+    }
+
+  };
+
+} // til
+
+#endif
@@ -4,6 +4,8 @@
 #include <cdk/targets/basic_target.h>
 #include <cdk/ast/basic_node.h>
 #include "targets/xml_writer.h"
+#include "targets/pass_report.h"
+#include "node_arena.h"
 
 namespace til {
 
@@ -17,12 +19,26 @@ namespace til {
 
   public:
     bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      auto &report = til::pass_report::instance();
+      report.stop_if_running("parse", til::node_arena::of(compiler.get()).allocations());
+      til::node_arena::scoped_release release(compiler); // the tree goes with the arena
+
       // this symbol table will be used to check identifiers
       // an exception will be thrown if identifiers are used before declaration
-      cdk::symbol_table<til::symbol> symtab;
+      til::symbol_table symtab;
 
       xml_writer writer(compiler, symtab);
-      compiler->ast()->accept(&writer, 0);
+      {
+        til::scoped_pass pass("xml output");
+        compiler->ast()->accept(&writer, 0);
+        compiler->ostream()->flush();
+        pass.visits(writer.visits());
+      }
+
+      if (compiler->debug()) {
+        til::node_arena::of(compiler.get()).report(std::cerr);
+      }
+      report.print_if_requested(std::cerr);
       return true;
     }
 
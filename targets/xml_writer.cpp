@@ -26,6 +26,7 @@ void til::xml_writer::do_nil_node(cdk::nil_node *node, int lvl) {}
 void til::xml_writer::do_sequence_node(cdk::sequence_node * const node, int lvl) {
   os() << std::string(lvl, ' ') << "<sequence_node size='" << node->size() << "'>" << std::endl;
   for (size_t i = 0; i < node->size(); i++) {
+    _visits++;
     node->node(i)->accept(this, lvl + 2);
   }
   closeTag(node, lvl);
@@ -10,10 +10,11 @@ namespace til {
    * Print nodes as XML elements to the output stream.
    */
   class xml_writer: public basic_ast_visitor {
-    cdk::symbol_table<til::symbol> &_symtab;
+    til::symbol_table &_symtab;
+    size_t _visits = 0; // sequence items visited
 
   public:
-    xml_writer(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<til::symbol> &symtab) :
+    xml_writer(std::shared_ptr<cdk::compiler> compiler, til::symbol_table &symtab) :
         basic_ast_visitor(compiler), _symtab(symtab) {
     }
 
@@ -22,6 +23,10 @@ namespace til {
       os().flush();
     }
 
+    size_t visits() const {
+      return _visits;
+    }
+
   private:
     void openTag(const std::string &tag, int lvl) {
       os() << std::string(lvl, ' ') + "<" + tag + ">" << std::endl;
@@ -0,0 +1,86 @@
+#!/bin/sh
+# Differential tests: compile each program with the postfix (asm) target and
+# with the other targets, run every build (with NAME.in as input, if there is
+# one) and compare its output with the postfix build's. Prints one line per
+# program and target; exits with 1 if any output differs or a build fails.
+#
+# usage: tests/run.sh [test.til...]   (default: tests/*.til)
+#   TIL=path/to/til           compiler under test (default ./til)
+#   TARGETS="llvm x64 c"      targets compared with asm (default llvm)
+#   ASM=yasm  OPT=opt  LLC=llc  CC=cc
+#
+# The runtime libraries must be built first (make runtime).
+
+TIL=${TIL:-./til}
+TARGETS=${TARGETS:-llvm}
+ASM=${ASM:-yasm}
+OPT=${OPT:-opt}
+LLC=${LLC:-llc}
+CC=${CC:-cc}
+TESTS=${*:-$(ls tests/*.til)}
+
+TMP=${TMPDIR:-/tmp}/til-tests.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# build "$TMP/$name.$target" from $src
+build() {
+  out="$TMP/$name.$1"
+  case $1 in
+    asm)
+      "$TIL" --target asm -o "$out.asm" "$src" &&
+      "$ASM" -felf32 "$out.asm" -o "$out.o" &&
+      "$CC" -m32 -o "$out" "$out.o" runtime/libtilrt.a ;;
+    llvm)
+      "$TIL" --target llvm -o "$out.ll" "$src" &&
+      "$OPT" -O2 "$out.ll" -o "$out.bc" &&
+      "$LLC" -O2 -relocation-model=pic "$out.bc" -o "$out.s" &&
+      "$CC" -o "$out" "$out.s" runtime/libtilrt64.a ;;
+    x64)
+      "$TIL" --target x64 -o "$out.s" "$src" &&
+      "$CC" -o "$out" "$out.s" runtime/libtilrt64.a ;;
+    c)
+      "$TIL" --target c -o "$out.c" "$src" &&
+      "$CC" -O2 -o "$out" "$out.c" runtime/libtilrt64.a ;;
+    *)
+      echo "unknown target $1" >&2
+      return 1 ;;
+  esac
+}
+
+# run "$TMP/$name.$target", output in "$TMP/$name.$target.out"
+run() {
+  input=${src%.til}.in
+  [ -f "$input" ] || input=/dev/null
+  "$TMP/$name.$1" < "$input" > "$TMP/$name.$1.out" 2>&1
+  echo "exit $?" >> "$TMP/$name.$1.out"
+}
+
+failed=0
+for src in $TESTS; do
+  name=$(basename "$src" .til)
+  if ! build asm > "$TMP/$name.asm.log" 2>&1; then
+    echo "FAIL $name asm (build)"
+    cat "$TMP/$name.asm.log"
+    failed=$((failed + 1))
+    continue
+  fi
+  run asm
+  for target in $TARGETS; do
+    if ! build "$target" > "$TMP/$name.$target.log" 2>&1; then
+      echo "FAIL $name $target (build)"
+      cat "$TMP/$name.$target.log"
+      failed=$((failed + 1))
+    else
+      run "$target"
+      if diff -u "$TMP/$name.asm.out" "$TMP/$name.$target.out"; then
+        echo "ok   $name $target"
+      else
+        echo "FAIL $name $target"
+        failed=$((failed + 1))
+      fi
+    fi
+  done
+done
+
+[ $failed -eq 0 ] || { echo "$failed failed"; exit 1; }
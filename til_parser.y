@@ -26,7 +26,7 @@
 
   int                                           i;           /* integer value */
   double                                        d;           /* double value */
-  std::string                                   *s;          /* symbol name or string literal */
+  const std::string                             *s;          /* interned symbol name or string literal */
   cdk::basic_node                               *node;       /* node pointer */
   cdk::sequence_node                            *sequence;
   cdk::expression_node                          *expression; /* expression nodes */
@@ -70,43 +70,53 @@
 
 %{
 //-- The rules below will be included in yyparse, the main parsing function.
+#include "interned_nodes.h"
+#include "node_arena.h"
+#include "type_table.h"
+#include "targets/pass_report.h"
+
+// syntax tree nodes are allocated in the arena owned by the compiler
+#define NEW new (til::node_arena::of(compiler.get()))
 %}
 
+%initial-action { til::pass_report::instance().start("parse"); }
+
 %%
 
-file : gdecls program { compiler->ast(new cdk::sequence_node(LINE, $2, $1)); }
+file : gdecls program { compiler->ast(NEW cdk::sequence_node(LINE, $2, $1)); }
      | gdecls         { compiler->ast($1); }
-     |        program { compiler->ast(new cdk::sequence_node(LINE, $1)); }
-     | /* empty */    { compiler->ast(new cdk::sequence_node(LINE)); }
+     |        program { compiler->ast(NEW cdk::sequence_node(LINE, $1)); }
+     | /* empty */    { compiler->ast(NEW cdk::sequence_node(LINE)); }
      ;
 
-gdecls : gdecls gdecl { $$ = new cdk::sequence_node(LINE, $2, $1);}
-       | gdecl        { $$ = new cdk::sequence_node(LINE, $1); }
+/* lists are left-recursive and grow in place: linear in their length */
+gdecls : gdecls gdecl { $$ = $1; $$->nodes().push_back($2); }
+       | gdecl        { $$ = NEW cdk::sequence_node(LINE, $1); }
        ;
 
-gdecl : '(' tEXTERNAL     func_type tIDENTIFIER ')'      { $$ = new til::declaration_node(LINE, tEXTERNAL, $3,      *$4, nullptr); }
-      | '(' tFORWARD      type      tIDENTIFIER ')'      { $$ = new til::declaration_node(LINE, tFORWARD,  $3,      *$4, nullptr); }
-      | '(' tPUBLIC       type      tIDENTIFIER ')'      { $$ = new til::declaration_node(LINE, tPUBLIC,   $3,      *$4, nullptr); }
-      | '(' tPUBLIC       type      tIDENTIFIER expr ')' { $$ = new til::declaration_node(LINE, tPUBLIC,   $3,      *$4, $5); }
-      | '(' tPUBLIC tVAR            tIDENTIFIER expr ')' { $$ = new til::declaration_node(LINE, tPUBLIC,   nullptr, *$4, $5); }
-      | '(' tPUBLIC                 tIDENTIFIER expr ')' { $$ = new til::declaration_node(LINE, tPUBLIC,   nullptr, *$3, $4); }
+gdecl : '(' tEXTERNAL     func_type tIDENTIFIER ')'      { $$ = NEW til::declaration_node(LINE, tEXTERNAL, $3,      $4, nullptr); }
+      | '(' tFORWARD      type      tIDENTIFIER ')'      { $$ = NEW til::declaration_node(LINE, tFORWARD,  $3,      $4, nullptr); }
+      | '(' tPUBLIC       type      tIDENTIFIER ')'      { $$ = NEW til::declaration_node(LINE, tPUBLIC,   $3,      $4, nullptr); }
+      | '(' tPUBLIC       type      tIDENTIFIER expr ')' { $$ = NEW til::declaration_node(LINE, tPUBLIC,   $3,      $4, $5); }
+      | '(' tPUBLIC tVAR            tIDENTIFIER expr ')' { $$ = NEW til::declaration_node(LINE, tPUBLIC,   nullptr, $4, $5); }
+      | '(' tPUBLIC                 tIDENTIFIER expr ')' { $$ = NEW til::declaration_node(LINE, tPUBLIC,   nullptr, $3, $4); }
       |  decl                                            { $$ = $1; } // private by default
       ;
 
-decls : decls decl { $$ = new cdk::sequence_node(LINE, $2, $1); }
-      | decl       { $$ = new cdk::sequence_node(LINE, $1); }
+decls : decls decl { $$ = $1; $$->nodes().push_back($2); }
+      | decl       { $$ = NEW cdk::sequence_node(LINE, $1); }
       ;
 
-decl : '(' type tIDENTIFIER ')'      { $$ = new til::declaration_node(LINE, tPRIVATE, $2,      *$3, nullptr); }
-     | '(' type tIDENTIFIER expr ')' { $$ = new til::declaration_node(LINE, tPRIVATE, $2,      *$3, $4); }
-     | '(' tVAR tIDENTIFIER expr ')' { $$ = new til::declaration_node(LINE, tPRIVATE, nullptr, *$3, $4); }
+decl : '(' type tIDENTIFIER ')'      { $$ = NEW til::declaration_node(LINE, tPRIVATE, $2,      $3, nullptr); }
+     | '(' type tIDENTIFIER expr ')' { $$ = NEW til::declaration_node(LINE, tPRIVATE, $2,      $3, $4); }
+     | '(' tVAR tIDENTIFIER expr ')' { $$ = NEW til::declaration_node(LINE, tPRIVATE, nullptr, $3, $4); }
      ;
 
-program : '(' tPROGRAM block ')' { $$ = new til::program_node(LINE, $3); }
+program : '(' tPROGRAM block ')' { $$ = NEW til::program_node(LINE, $3); }
         ;
 
-function : '(' tFUNCTION '(' type ')' block ')'       { $$ = new til::function_node(LINE, $4, new cdk::sequence_node(LINE), $6); }
-         | '(' tFUNCTION '(' type decls ')' block ')' { $$ = new til::function_node(LINE, $4, $5, $7); }
+function : '(' tFUNCTION '(' type ')' block ')'       { $$ = NEW til::function_node(LINE, $4, NEW cdk::sequence_node(LINE), $6); }
+         | '(' tFUNCTION '(' type decls ')' block ')' { $$ = NEW til::function_node(LINE, $4, $5, $7); }
          ;
 
 type : data_type { $$ = $1; }
@@ -114,94 +124,94 @@ type : data_type { $$ = $1; }
      | func_type { $$ = $1; }
      ;
 
-data_type : tTYPE_INT    { $$ = cdk::primitive_type::create(4, cdk::TYPE_INT); }
-          | tTYPE_DOUBLE { $$ = cdk::primitive_type::create(8, cdk::TYPE_DOUBLE); }
-          | tTYPE_STRING { $$ = cdk::primitive_type::create(4, cdk::TYPE_STRING); }
-          | tTYPE_VOID   { $$ = cdk::primitive_type::create(0, cdk::TYPE_VOID); }
+data_type : tTYPE_INT    { $$ = til::make_primitive_type(4, cdk::TYPE_INT); }
+          | tTYPE_DOUBLE { $$ = til::make_primitive_type(8, cdk::TYPE_DOUBLE); }
+          | tTYPE_STRING { $$ = til::make_primitive_type(4, cdk::TYPE_STRING); }
+          | tTYPE_VOID   { $$ = til::make_primitive_type(0, cdk::TYPE_VOID); }
           ;
 
-ref_type :  type '!'  { $$ = cdk::reference_type::create(4, $1); };
+ref_type :  type '!'  { $$ = til::make_reference_type(4, $1); };
          ;
 
-func_type : '(' type ')'               { $$ = cdk::functional_type::create($2); }
-          | '(' type '(' types ')' ')' { $$ = cdk::functional_type::create(*$4, $2); }
+func_type : '(' type ')'               { $$ = til::make_functional_type($2); }
+          | '(' type '(' types ')' ')' { $$ = til::make_functional_type(*$4, $2); }
           ;
 
 types : type       { $$ = new std::vector<std::shared_ptr<cdk::basic_type>>(); $$->push_back($1); }
       | types type { $$ = $1; $$->push_back($2); }
       ;
 
-block : decls instrs  { $$ = new til::block_node(LINE, $1, $2); }
-      |       instrs  { $$ = new til::block_node(LINE, new cdk::sequence_node(LINE), $1); }
-      | decls         { $$ = new til::block_node(LINE, $1, new cdk::sequence_node(LINE)); }
-      | /* empty */   { $$ = new til::block_node(LINE, new cdk::sequence_node(LINE), new cdk::sequence_node(LINE)); }
+block : decls instrs  { $$ = NEW til::block_node(LINE, $1, $2); }
+      |       instrs  { $$ = NEW til::block_node(LINE, NEW cdk::sequence_node(LINE), $1); }
+      | decls         { $$ = NEW til::block_node(LINE, $1, NEW cdk::sequence_node(LINE)); }
+      | /* empty */   { $$ = NEW til::block_node(LINE, NEW cdk::sequence_node(LINE), NEW cdk::sequence_node(LINE)); }
       ;
 
-instrs : instr         { $$ = new cdk::sequence_node(LINE, $1); }
-       | instrs instr  { $$ = new cdk::sequence_node(LINE, $2, $1); }
+instrs : instr         { $$ = NEW cdk::sequence_node(LINE, $1); }
+       | instrs instr  { $$ = $1; $$->nodes().push_back($2); }
        ;
 
-instr :  expr                              { $$ = new til::evaluation_node(LINE, $1); }
-      | '(' tPRINT exprs ')'               { $$ = new til::print_node(LINE, $3, false); }
-      | '(' tPRINTLN exprs ')'             { $$ = new til::print_node(LINE, $3, true); }
-      | '(' tSTOP tINTEGER ')'             { $$ = new til::stop_node(LINE, $3); }
-      | '(' tSTOP ')'                      { $$ = new til::stop_node(LINE); }
-      | '(' tNEXT tINTEGER ')'             { $$ = new til::stop_node(LINE, $3); }
-      | '(' tNEXT ')'                      { $$ = new til::stop_node(LINE); }
-      | '(' tRETURN expr ')'               { $$ = new til::return_node(LINE, $3); }
-      | '(' tRETURN ')'                    { $$ = new til::return_node(LINE, nullptr); }
-      | '(' tLOOP expr instr ')'           { $$ = new til::loop_node(LINE, $3, $4); }
-      | '(' tIF expr instr ')'             { $$ = new til::if_node(LINE, $3, $4); }
-      | '(' tIF expr instr instr ')'       { $$ = new til::if_else_node(LINE, $3, $4, $5); }
+instr :  expr                              { $$ = NEW til::evaluation_node(LINE, $1); }
+      | '(' tPRINT exprs ')'               { $$ = NEW til::print_node(LINE, $3, false); }
+      | '(' tPRINTLN exprs ')'             { $$ = NEW til::print_node(LINE, $3, true); }
+      | '(' tSTOP tINTEGER ')'             { $$ = NEW til::stop_node(LINE, $3); }
+      | '(' tSTOP ')'                      { $$ = NEW til::stop_node(LINE); }
+      | '(' tNEXT tINTEGER ')'             { $$ = NEW til::stop_node(LINE, $3); }
+      | '(' tNEXT ')'                      { $$ = NEW til::stop_node(LINE); }
+      | '(' tRETURN expr ')'               { $$ = NEW til::return_node(LINE, $3); }
+      | '(' tRETURN ')'                    { $$ = NEW til::return_node(LINE, nullptr); }
+      | '(' tLOOP expr instr ')'           { $$ = NEW til::loop_node(LINE, $3, $4); }
+      | '(' tIF expr instr ')'             { $$ = NEW til::if_node(LINE, $3, $4); }
+      | '(' tIF expr instr instr ')'       { $$ = NEW til::if_else_node(LINE, $3, $4, $5); }
       | '(' tBLOCK block ')'               { $$ = $3; }
       ;
 
-expr : '(' '-' expr ')'              { $$ = new cdk::unary_minus_node(LINE, $3); }
-     | '(' '+' expr ')'              { $$ = new cdk::unary_plus_node(LINE, $3); }
-     | '(' '~' expr ')'              { $$ = new cdk::not_node(LINE, $3); }
-     | '(' '+' expr expr ')'         { $$ = new cdk::add_node(LINE, $3, $4); }
-     | '(' '-' expr expr ')'         { $$ = new cdk::sub_node(LINE, $3, $4); }
-     | '(' '*' expr expr ')'         { $$ = new cdk::mul_node(LINE, $3, $4); }
-     | '(' '/' expr expr ')'         { $$ = new cdk::div_node(LINE, $3, $4); }
-     | '(' '%' expr expr ')'         { $$ = new cdk::mod_node(LINE, $3, $4); }
-     | '(' '<' expr expr ')'         { $$ = new cdk::lt_node(LINE, $3, $4); }
-     | '(' '>' expr expr ')'         { $$ = new cdk::gt_node(LINE, $3, $4); }
-     | '(' '?' lval ')'              { $$ = new til::address_of_node(LINE, $3); }
-     | '(' tGE  expr expr ')'        { $$ = new cdk::ge_node(LINE, $3, $4); }
-     | '(' tLE  expr expr ')'        { $$ = new cdk::le_node(LINE, $3, $4); }
-     | '(' tNE  expr expr ')'        { $$ = new cdk::ne_node(LINE, $3, $4); }
-     | '(' tEQ  expr expr ')'        { $$ = new cdk::eq_node(LINE, $3, $4); }
-     | '(' tAND expr expr ')'        { $$ = new cdk::and_node(LINE, $3, $4); }
-     | '(' tOR  expr expr ')'        { $$ = new cdk::or_node(LINE, $3, $4); }
-     | '(' tSET lval expr ')'        { $$ = new cdk::assignment_node(LINE, $3, $4); }
-     | '(' tOBJECTS expr ')'         { $$ = new til::stack_alloc_node(LINE, $3); } 
-     | '(' tSIZEOF expr ')'          { $$ = new til::sizeof_node(LINE, $3); }
-     | '(' expr exprs ')'            { $$ = new til::function_call_node(LINE, $2, $3); }
-     | '(' expr ')'                  { $$ = new til::function_call_node(LINE, $2, new cdk::sequence_node(LINE)); }
-     | '(' '@' exprs ')'             { $$ = new til::function_call_node(LINE, nullptr, $3); }
-     | '(' '@' ')'                   { $$ = new til::function_call_node(LINE, nullptr, new cdk::sequence_node(LINE)); }
-     | '(' tREAD ')'                 { $$ = new til::read_node(LINE); }
+expr : '(' '-' expr ')'              { $$ = NEW cdk::unary_minus_node(LINE, $3); }
+     | '(' '+' expr ')'              { $$ = NEW cdk::unary_plus_node(LINE, $3); }
+     | '(' '~' expr ')'              { $$ = NEW cdk::not_node(LINE, $3); }
+     | '(' '+' expr expr ')'         { $$ = NEW cdk::add_node(LINE, $3, $4); }
+     | '(' '-' expr expr ')'         { $$ = NEW cdk::sub_node(LINE, $3, $4); }
+     | '(' '*' expr expr ')'         { $$ = NEW cdk::mul_node(LINE, $3, $4); }
+     | '(' '/' expr expr ')'         { $$ = NEW cdk::div_node(LINE, $3, $4); }
+     | '(' '%' expr expr ')'         { $$ = NEW cdk::mod_node(LINE, $3, $4); }
+     | '(' '<' expr expr ')'         { $$ = NEW cdk::lt_node(LINE, $3, $4); }
+     | '(' '>' expr expr ')'         { $$ = NEW cdk::gt_node(LINE, $3, $4); }
+     | '(' '?' lval ')'              { $$ = NEW til::address_of_node(LINE, $3); }
+     | '(' tGE  expr expr ')'        { $$ = NEW cdk::ge_node(LINE, $3, $4); }
+     | '(' tLE  expr expr ')'        { $$ = NEW cdk::le_node(LINE, $3, $4); }
+     | '(' tNE  expr expr ')'        { $$ = NEW cdk::ne_node(LINE, $3, $4); }
+     | '(' tEQ  expr expr ')'        { $$ = NEW cdk::eq_node(LINE, $3, $4); }
+     | '(' tAND expr expr ')'        { $$ = NEW cdk::and_node(LINE, $3, $4); }
+     | '(' tOR  expr expr ')'        { $$ = NEW cdk::or_node(LINE, $3, $4); }
+     | '(' tSET lval expr ')'        { $$ = NEW cdk::assignment_node(LINE, $3, $4); }
+     | '(' tOBJECTS expr ')'         { $$ = NEW til::stack_alloc_node(LINE, $3); } 
+     | '(' tSIZEOF expr ')'          { $$ = NEW til::sizeof_node(LINE, $3); }
+     | '(' expr exprs ')'            { $$ = NEW til::function_call_node(LINE, $2, $3); }
+     | '(' expr ')'                  { $$ = NEW til::function_call_node(LINE, $2, NEW cdk::sequence_node(LINE)); }
+     | '(' '@' exprs ')'             { $$ = NEW til::function_call_node(LINE, nullptr, $3); }
+     | '(' '@' ')'                   { $$ = NEW til::function_call_node(LINE, nullptr, NEW cdk::sequence_node(LINE)); }
+     | '(' tREAD ')'                 { $$ = NEW til::read_node(LINE); }
      | integer                       { $$ = $1; }
      | double                        { $$ = $1; }
-     | string                        { $$ = new cdk::string_node(LINE, $1); }
-     | tNULL                         { $$ = new til::nullptr_node(LINE); }
+     | string                        { $$ = NEW til::interned_string_node(LINE, $1); }
+     | tNULL                         { $$ = NEW til::nullptr_node(LINE); }
      | function                      { $$ = $1; }
-     | lval                          { $$ = new cdk::rvalue_node(LINE, $1); }
+     | lval                          { $$ = NEW cdk::rvalue_node(LINE, $1); }
      ;
 
-exprs : expr exprs { $$ = new cdk::sequence_node(LINE, $1, $2); }
-      | expr       { $$ = new cdk::sequence_node(LINE, $1); }
+exprs : exprs expr { $$ = $1; $$->nodes().push_back($2); }
+      | expr       { $$ = NEW cdk::sequence_node(LINE, $1); }
       ;
 
-lval : tIDENTIFIER              { $$ = new cdk::variable_node(LINE, $1); }
-     | '(' tINDEX expr expr ')' { $$ = new til::index_node(LINE, $3, $4); } 
+lval : tIDENTIFIER              { $$ = NEW til::interned_variable_node(LINE, $1); }
+     | '(' tINDEX expr expr ')' { $$ = NEW til::index_node(LINE, $3, $4); } 
      ;
 
-integer  : tINTEGER       { $$ = new cdk::integer_node(LINE, $1); }
+integer  : tINTEGER       { $$ = NEW cdk::integer_node(LINE, $1); }
 
-double   : tDOUBLE        { $$ = new cdk::double_node(LINE, $1); }
+double   : tDOUBLE        { $$ = NEW cdk::double_node(LINE, $1); }
 
-string   : tSTRING        { $$ = new std::string(*$1); delete $1; }
+string   : tSTRING        { $$ = $1; }
          ;
  
 %%
@@ -0,0 +1,59 @@
+#include "type_table.h"
+
+std::shared_ptr<cdk::primitive_type> til::type_table::primitive(size_t size, cdk::typename_type name) {
+  auto &type = _primitives[{size, name}];
+  if (!type) {
+    type = cdk::primitive_type::create(size, name);
+  }
+  return type;
+}
+
+std::shared_ptr<cdk::reference_type> til::type_table::reference(size_t size, type_ptr referenced) {
+  referenced = intern(referenced);
+  auto &type = _references[{size, referenced.get()}];
+  if (!type) {
+    type = cdk::reference_type::create(size, referenced);
+  }
+  return type;
+}
+
+std::shared_ptr<cdk::functional_type> til::type_table::functional(const std::vector<type_ptr> &inputs,
+                                                                  type_ptr output) {
+  std::vector<type_ptr> canonical_inputs;
+  std::vector<const cdk::basic_type *> key;
+  for (auto &input : inputs) {
+    canonical_inputs.push_back(intern(input));
+    key.push_back(canonical_inputs.back().get());
+  }
+  output = intern(output);
+
+  auto &type = _functionals[{key, output.get()}];
+  if (!type) {
+    type = cdk::functional_type::create(canonical_inputs, output);
+  }
+  return type;
+}
+
+std::shared_ptr<cdk::basic_type> til::type_table::intern(type_ptr type) {
+  if (type == nullptr) {
+    return type;
+  }
+
+  switch (type->name()) {
+  case cdk::TYPE_POINTER:
+    return reference(type->size(), cdk::reference_type::cast(type)->referenced());
+  case cdk::TYPE_FUNCTIONAL: {
+    auto func = cdk::functional_type::cast(type);
+    return functional(func->input()->components(), func->output(0));
+  }
+  case cdk::TYPE_STRUCT:
+    return type; // not produced by TIL
+  default:
+    return primitive(type->size(), type->name());
+  }
+}
+
+til::type_table &til::type_table::instance() {
+  static type_table table;
+  return table;
+}
@@ -0,0 +1,62 @@
+#ifndef __TIL_TYPE_TABLE_H__
+#define __TIL_TYPE_TABLE_H__
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <cdk/types/types.h>
+
+namespace til {
+
+  /**
+   * Hash-consing factory for cdk types.
+   *
+   * Structurally identical types are created once and shared, so that two
+   * types produced by this table are equal if, and only if, they are the same
+   * object. Types built elsewhere can be brought in with intern().
+   */
+  class type_table {
+    typedef std::shared_ptr<cdk::basic_type> type_ptr;
+
+    std::map<std::tuple<size_t, cdk::typename_type>, std::shared_ptr<cdk::primitive_type>> _primitives;
+    std::map<std::tuple<size_t, const cdk::basic_type *>, std::shared_ptr<cdk::reference_type>> _references;
+    std::map<std::tuple<std::vector<const cdk::basic_type *>, const cdk::basic_type *>,
+             std::shared_ptr<cdk::functional_type>> _functionals;
+
+  public:
+    std::shared_ptr<cdk::primitive_type> primitive(size_t size, cdk::typename_type name);
+    std::shared_ptr<cdk::reference_type> reference(size_t size, type_ptr referenced);
+    std::shared_ptr<cdk::functional_type> functional(const std::vector<type_ptr> &inputs, type_ptr output);
+
+    /** Canonical (shared) instance of an arbitrary type. */
+    type_ptr intern(type_ptr type);
+
+    size_t size() const {
+      return _primitives.size() + _references.size() + _functionals.size();
+    }
+
+  public:
+    static type_table &instance();
+  };
+
+  inline auto make_primitive_type(size_t size, cdk::typename_type name) {
+    return type_table::instance().primitive(size, name);
+  }
+
+  inline auto make_reference_type(size_t size, std::shared_ptr<cdk::basic_type> referenced) {
+    return type_table::instance().reference(size, referenced);
+  }
+
+  inline auto make_functional_type(const std::vector<std::shared_ptr<cdk::basic_type>> &inputs,
+                                   std::shared_ptr<cdk::basic_type> output) {
+    return type_table::instance().functional(inputs, output);
+  }
+
+  inline auto make_functional_type(std::shared_ptr<cdk::basic_type> output) {
+    return type_table::instance().functional({}, output);
+  }
+
+} // til
+
+#endif